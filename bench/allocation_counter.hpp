@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global allocation functions to count the heap allocations.
+// Every form is replaced, so that array allocations are counted too and each
+// delete matches its new. The replacements are definitions, so only one
+// source file of a program may include this.
+
+namespace TASLogger
+{
+	namespace Bench
+	{
+		static size_t heapAllocations = 0;
+	}
+}
+
+static void *CountedAllocate(size_t size)
+{
+	++TASLogger::Bench::heapAllocations;
+	return std::malloc(size ? size : 1);
+}
+
+void *operator new(size_t size)
+{
+	if (void *p = CountedAllocate(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+	if (void *p = CountedAllocate(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	return CountedAllocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return CountedAllocate(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+	std::free(p);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "taslogger/reader.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace TASLogger
+{
+	namespace Bench
+	{
+		inline size_t PeakResidentBytes()
+		{
+#ifdef _WIN32
+			PROCESS_MEMORY_COUNTERS counters;
+			GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+			return counters.PeakWorkingSetSize;
+#else
+			struct rusage usage;
+			getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+			return static_cast<size_t>(usage.ru_maxrss);
+#else
+			return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+		}
+
+		inline size_t StringHeapBytes(const std::string &str)
+		{
+			// Assume short strings live in the small string buffer.
+			return str.capacity() > 15 ? str.capacity() + 1 : 0;
+		}
+
+		// Heap bytes owned by a parsed log, counting vector capacity rather
+		// than size since that is what the allocator actually handed out.
+		inline size_t HeapBytes(const TASLog &tasLog)
+		{
+			size_t bytes = StringHeapBytes(tasLog.toolVersion) + StringHeapBytes(tasLog.gameMod);
+			bytes += tasLog.physicsFrameList.capacity() * sizeof(ReaderPhysicsFrame);
+			for (const ReaderPhysicsFrame &physicsFrame : tasLog.physicsFrameList) {
+				bytes += StringHeapBytes(physicsFrame.commandBuffer);
+				bytes += physicsFrame.consolePrintList.capacity() * sizeof(std::string);
+				for (const std::string &message : physicsFrame.consolePrintList)
+					bytes += StringHeapBytes(message);
+				bytes += physicsFrame.damageList.capacity() * sizeof(ReaderDamage);
+				bytes += physicsFrame.objectMoveList.capacity() * sizeof(ReaderObjectMove);
+				bytes += physicsFrame.commandFrameList.capacity() * sizeof(ReaderCommandFrame);
+				for (const ReaderCommandFrame &commandFrame : physicsFrame.commandFrameList)
+					bytes += commandFrame.collisionList.capacity() * sizeof(ReaderCollision);
+			}
+			return bytes;
+		}
+	}
+}
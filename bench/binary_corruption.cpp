@@ -0,0 +1,110 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "taslogger/binary_writer.hpp"
+#include "taslogger/reader.hpp"
+#include "synthetic_log.hpp"
+
+using namespace TASLogger;
+
+static const char MARKER[] = "corrupt me";
+
+static std::string ReadAll(FILE *file)
+{
+	std::string data;
+	std::rewind(file);
+	char buf[65536];
+	size_t n;
+	while ((n = std::fread(buf, 1, sizeof(buf), file)) != 0)
+		data.append(buf, n);
+	return data;
+}
+
+static std::string WriteLog(size_t physicsFrames)
+{
+	FILE *file = std::tmpfile();
+	BinaryLogWriter writer;
+	Bench::SyntheticLog log;
+	log.Write(writer, file, physicsFrames);
+	const std::string data = ReadAll(file);
+	std::fclose(file);
+	return data;
+}
+
+// Parses data with ParseFile and with ParseFileTolerant, and sets truncated
+// from the latter.
+static bool Parse(const std::string &data, bool &truncated)
+{
+	FILE *file = std::tmpfile();
+	std::fwrite(data.data(), 1, data.size(), file);
+
+	std::rewind(file);
+	TASLog tasLog;
+	const bool ok = !ParseFile(file, tasLog).IsError();
+
+	std::rewind(file);
+	RecoveryInfo recovery;
+	const bool tolerantOk = !ParseFileTolerant(file, tasLog, recovery).IsError();
+	std::fclose(file);
+
+	truncated = !tolerantOk || recovery.truncated;
+	return ok;
+}
+
+static bool Check(const char *name, const std::string &data, bool expectOk)
+{
+	bool truncated;
+	const bool ok = Parse(data, truncated);
+	const bool pass = ok == expectOk && truncated == !expectOk;
+	std::printf("%-18s %s, %s%s\n", name, ok ? "parsed" : "parse error", truncated ? "truncated" : "complete", pass ? "" : " (unexpected)");
+	return pass;
+}
+
+int main()
+{
+	bool pass = true;
+
+	const std::string log = WriteLog(2000);
+	pass &= Check("intact", log, true);
+	pass &= Check("truncated", log.substr(0, log.size() / 3), false);
+	pass &= Check("zero-filled tail", log.substr(0, log.size() / 3) + std::string(log.size() - log.size() / 3, '\0'), false);
+
+	// A string whose length is far larger than the file.
+	{
+		FILE *file = std::tmpfile();
+		BinaryLogWriter writer;
+		writer.StartLog(file, "1.0.0", 8684, "valve");
+		writer.StartPhysicsFrame(0.001, 5, false, MARKER);
+		writer.EndPhysicsFrame();
+		writer.EndLog();
+		std::string data = ReadAll(file);
+		std::fclose(file);
+
+		const size_t marker = data.find(MARKER);
+		const unsigned char hugeLength[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0x0f};
+		if (marker == std::string::npos || marker == 0) {
+			std::printf("marker not found\n");
+			return 1;
+		}
+		data.replace(marker - 1, sizeof(hugeLength), reinterpret_cast<const char *>(hugeLength), sizeof(hugeLength));
+		pass &= Check("huge length", data, false);
+	}
+
+	// Random byte flips must never crash or exhaust memory. Whether they
+	// are detected depends on where they land.
+	uint32_t state = 1;
+	for (int run = 0; run < 200; ++run) {
+		std::string data = log;
+		for (int i = 0; i < 4; ++i) {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			data[state % data.size()] ^= static_cast<char>(1 + (state >> 24) % 255);
+		}
+		bool truncated;
+		Parse(data, truncated);
+	}
+	std::printf("random flips       200 runs survived\n");
+
+	return pass ? 0 : 1;
+}
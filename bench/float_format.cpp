@@ -0,0 +1,77 @@
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "taslogger/writer.hpp"
+#include "float_format.hpp"
+#include "synthetic_log.hpp"
+
+using namespace TASLogger;
+
+typedef std::chrono::steady_clock Clock;
+
+static double BytesPerFrame(NumberFormat format, size_t physicsFrames)
+{
+	FILE *file = std::tmpfile();
+	if (!file)
+		return 0;
+
+	Bench::SyntheticLog log;
+	LogWriter writer;
+	writer.SetNumberFormat(format);
+	log.Write(writer, file, physicsFrames);
+	std::fflush(file);
+
+	const double bytes = static_cast<double>(std::ftell(file));
+	std::fclose(file);
+	return bytes / physicsFrames;
+}
+
+template<typename WriteFunction>
+static double NanosecondsPerValue(const std::vector<float> &values, WriteFunction write, size_t &bytes)
+{
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	writer.StartArray();
+
+	const Clock::time_point start = Clock::now();
+	for (float value : values)
+		write(writer, value);
+	const Clock::time_point end = Clock::now();
+
+	writer.EndArray();
+	bytes = buffer.GetSize();
+	return std::chrono::duration<double, std::nano>(end - start).count() / values.size();
+}
+
+int main()
+{
+	const size_t physicsFrames = 20000;
+	std::printf("bytes per physics frame: double %.1f, float %.1f\n",
+		BytesPerFrame(NUMBER_FORMAT_DOUBLE, physicsFrames), BytesPerFrame(NUMBER_FORMAT_FLOAT, physicsFrames));
+
+	// Positions, velocities and angles in the ranges a game produces.
+	std::vector<float> values;
+	uint32_t state = 1;
+	for (size_t i = 0; i < 1000000; ++i) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		values.push_back((static_cast<float>(state >> 8) / (1 << 24) - 0.5f) * 8192.0f);
+	}
+
+	size_t doubleBytes, floatBytes;
+	const double doubleNs = NanosecondsPerValue(values, [](rapidjson::Writer<rapidjson::StringBuffer> &writer, float value) {
+		writer.Double(value);
+	}, doubleBytes);
+	const double floatNs = NanosecondsPerValue(values, [](rapidjson::Writer<rapidjson::StringBuffer> &writer, float value) {
+		char buffer[MAX_FLOAT_LENGTH];
+		writer.RawValue(buffer, FormatShortestFloat(value, buffer), rapidjson::kNumberType);
+	}, floatBytes);
+
+	std::printf("ns per value:            double %.1f, float %.1f\n", doubleNs, floatNs);
+	std::printf("bytes per value:         double %.1f, float %.1f\n",
+		static_cast<double>(doubleBytes) / values.size(), static_cast<double>(floatBytes) / values.size());
+	return 0;
+}
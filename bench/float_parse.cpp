@@ -0,0 +1,112 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "rapidjson/memorystream.h"
+#include "rapidjson/reader.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "float_format.hpp"
+#include "float_parse.hpp"
+
+using namespace TASLogger;
+
+typedef std::chrono::steady_clock Clock;
+
+// Collects the numbers of an array of floats, converted like the reader did
+// before RawNumber, or with ParseFloat.
+class FloatArrayHandler
+{
+public:
+	explicit FloatArrayHandler(std::vector<float> &values) : values(values) {}
+
+	bool Null() { return false; }
+	bool Bool(bool) { return false; }
+	bool Int(int) { return false; }
+	bool Uint(unsigned) { return false; }
+	bool Int64(int64_t) { return false; }
+	bool Uint64(uint64_t) { return false; }
+	bool Double(double d) { values.push_back(static_cast<float>(d)); return true; }
+	bool String(const char *, rapidjson::SizeType, bool) { return false; }
+	bool StartObject() { return false; }
+	bool Key(const char *, rapidjson::SizeType, bool) { return false; }
+	bool EndObject(rapidjson::SizeType) { return false; }
+	bool StartArray() { return true; }
+	bool EndArray(rapidjson::SizeType) { return true; }
+
+	bool RawNumber(const char *str, rapidjson::SizeType length, bool)
+	{
+		float value;
+		if (!ParseFloat(str, length, value))
+			return false;
+		values.push_back(value);
+		return true;
+	}
+
+private:
+	std::vector<float> &values;
+};
+
+template<unsigned parseFlags>
+static double NanosecondsPerValue(const rapidjson::StringBuffer &json, std::vector<float> &values)
+{
+	values.clear();
+	FloatArrayHandler handler(values);
+	rapidjson::MemoryStream ms(json.GetString(), json.GetSize());
+	rapidjson::Reader reader;
+
+	const Clock::time_point start = Clock::now();
+	const bool ok = !reader.Parse<parseFlags>(ms, handler).IsError();
+	const Clock::time_point end = Clock::now();
+
+	if (!ok)
+		return 0;
+	return std::chrono::duration<double, std::nano>(end - start).count() / values.size();
+}
+
+static size_t CountDifferent(const std::vector<float> &a, const std::vector<float> &b)
+{
+	if (a.size() != b.size())
+		return a.size() > b.size() ? a.size() : b.size();
+	size_t count = 0;
+	for (size_t i = 0; i < a.size(); ++i)
+		count += std::memcmp(&a[i], &b[i], sizeof(float)) != 0;
+	return count;
+}
+
+int main()
+{
+	// Positions, velocities and angles in the ranges a game produces.
+	std::vector<float> values;
+	uint32_t state = 1;
+	for (size_t i = 0; i < 1000000; ++i) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		values.push_back((static_cast<float>(state >> 8) / (1 << 24) - 0.5f) * 8192.0f);
+	}
+
+	rapidjson::StringBuffer doubleJSON, floatJSON;
+	{
+		rapidjson::Writer<rapidjson::StringBuffer> doubleWriter(doubleJSON), floatWriter(floatJSON);
+		doubleWriter.StartArray();
+		floatWriter.StartArray();
+		for (float value : values) {
+			doubleWriter.Double(value);
+			char buffer[MAX_FLOAT_LENGTH];
+			floatWriter.RawValue(buffer, FormatShortestFloat(value, buffer), rapidjson::kNumberType);
+		}
+		doubleWriter.EndArray();
+		floatWriter.EndArray();
+	}
+
+	std::vector<float> throughDouble, direct;
+	for (int format = 0; format < 2; ++format) {
+		const rapidjson::StringBuffer &json = format == 0 ? doubleJSON : floatJSON;
+		const double doubleNs = NanosecondsPerValue<rapidjson::kParseDefaultFlags>(json, throughDouble);
+		const double directNs = NanosecondsPerValue<rapidjson::kParseNumbersAsStringsFlag>(json, direct);
+		std::printf("%s numbers: ns per value through double %.1f, ParseFloat %.1f, %zu values differ, %zu do not read back\n",
+			format == 0 ? "double" : "float ", doubleNs, directNs, CountDifferent(throughDouble, direct), CountDifferent(values, direct));
+	}
+	return 0;
+}
@@ -0,0 +1,142 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "internal_handler.hpp"
+
+using namespace TASLogger;
+
+// The hash table lookup that InternalHandler::Key used before, kept here as
+// the baseline.
+struct CharStringEqualTo
+{
+	bool operator()(const char *const &lhs, const char *const &rhs) const
+	{
+		return std::strcmp(lhs, rhs) == 0;
+	}
+};
+
+struct CharStringHash
+{
+	size_t operator()(const char *str) const
+	{
+		const unsigned char *s = reinterpret_cast<const unsigned char *>(str);
+		size_t hash = 5381;
+		while (size_t c = *s++)
+			hash = ((hash << 5) + hash) + c;
+		return hash;
+	}
+};
+
+typedef std::unordered_map<const char *, ParseState, CharStringHash, CharStringEqualTo> StateTableType;
+
+struct Table
+{
+	const KeyEntry *entries;
+	size_t count;
+	std::vector<std::string> keys;
+	StateTableType map;
+};
+
+template<size_t N>
+static void InitTable(Table &table, const KeyEntry (&entries)[N])
+{
+	table.entries = entries;
+	table.count = N;
+	table.keys.reserve(N);
+	for (const KeyEntry &entry : entries) {
+		std::string key;
+		for (uint64_t packedKey = entry.packedKey; packedKey != 0; packedKey >>= 8)
+			key += static_cast<char>(packedKey & 0xff);
+		table.keys.push_back(key);
+		table.map[table.keys.back().c_str()] = entry.state;
+	}
+}
+
+struct Lookup
+{
+	const Table *table;
+	std::string key;
+};
+
+static bool LookupHashed(const Lookup &lookup, ParseState &state)
+{
+	try {
+		state = lookup.table->map.at(lookup.key.c_str());
+	} catch (const std::out_of_range &) {
+		return false;
+	}
+	return true;
+}
+
+static bool LookupScanned(const Lookup &lookup, ParseState &state)
+{
+	return LookupKey(lookup.table->entries, lookup.table->count, lookup.key.c_str(),
+		static_cast<rapidjson::SizeType>(lookup.key.size()), state);
+}
+
+template<typename LookupFunction>
+static double KeysPerSecond(const std::vector<Lookup> &lookups, size_t rounds, LookupFunction lookupFunction, size_t &hits)
+{
+	hits = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t round = 0; round < rounds; ++round) {
+		for (const Lookup &lookup : lookups) {
+			ParseState state;
+			if (lookupFunction(lookup, state))
+				hits += state;
+		}
+	}
+	const auto end = std::chrono::steady_clock::now();
+	return lookups.size() * rounds / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+	const size_t rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+
+	Table physicsFrame, commandFrame, player, collision;
+	InitTable(physicsFrame, KEY_TABLE_PHYSICS_FRAME);
+	InitTable(commandFrame, KEY_TABLE_COMMAND_FRAME);
+	InitTable(player, KEY_TABLE_PLAYER);
+	InitTable(collision, KEY_TABLE_COLLISION);
+
+	// The keys of a physics frame with one command frame and one collision.
+	std::vector<Lookup> lookups;
+	for (const std::string &key : physicsFrame.keys)
+		lookups.push_back(Lookup{&physicsFrame, key});
+	for (const std::string &key : commandFrame.keys)
+		lookups.push_back(Lookup{&commandFrame, key});
+	for (int i = 0; i < 2; ++i) {
+		for (const std::string &key : player.keys)
+			lookups.push_back(Lookup{&player, key});
+	}
+	for (const std::string &key : collision.keys)
+		lookups.push_back(Lookup{&collision, key});
+
+	std::vector<Lookup> missLookups(lookups);
+	for (size_t i = 0; i < missLookups.size(); i += 8)
+		missLookups[i].key = "unknown";
+
+	size_t hashedHits, scannedHits;
+	const double hashed = KeysPerSecond(lookups, rounds, LookupHashed, hashedHits);
+	const double scanned = KeysPerSecond(lookups, rounds, LookupScanned, scannedHits);
+	if (hashedHits != scannedHits) {
+		std::fprintf(stderr, "Lookup results differ\n");
+		return 1;
+	}
+
+	const size_t missRounds = rounds / 20 + 1;
+	const double hashedMiss = KeysPerSecond(missLookups, missRounds, LookupHashed, hashedHits);
+	const double scannedMiss = KeysPerSecond(missLookups, missRounds, LookupScanned, scannedHits);
+
+	const double mega = 1e6;
+	std::printf("%zu keys per round\n", lookups.size());
+	std::printf("all hits:        hash table %8.1f Mkeys/s, key table %8.1f Mkeys/s\n", hashed / mega, scanned / mega);
+	std::printf("1 in 8 misses:   hash table %8.1f Mkeys/s, key table %8.1f Mkeys/s\n", hashedMiss / mega, scannedMiss / mega);
+	return 0;
+}
@@ -0,0 +1,70 @@
+#include <chrono>
+#include <cstdio>
+#include "taslogger/reader.hpp"
+#include "allocation_counter.hpp"
+
+using namespace TASLogger;
+
+typedef std::chrono::steady_clock Clock;
+
+static double Seconds(Clock::time_point start, Clock::time_point end)
+{
+	return std::chrono::duration<double>(end - start).count();
+}
+
+template<typename Log, typename ParseFunction>
+static bool Run(const char *name, const char *filename, ParseFunction parse)
+{
+	FILE *file = std::fopen(filename, "rb");
+	if (!file) {
+		std::perror(filename);
+		return false;
+	}
+
+	const size_t startAllocations = Bench::heapAllocations;
+	const Clock::time_point start = Clock::now();
+
+	Log *tasLog = new Log;
+	const rapidjson::ParseResult res = parse(file, *tasLog);
+	std::fclose(file);
+
+	const Clock::time_point parsed = Clock::now();
+	const size_t allocations = Bench::heapAllocations - startAllocations;
+	const size_t physicsFrames = tasLog->physicsFrameList.size();
+	delete tasLog;
+	const Clock::time_point destroyed = Clock::now();
+
+	if (res.IsError()) {
+		std::fprintf(stderr, "Parse error %d at offset %zu\n", static_cast<int>(res.Code()), res.Offset());
+		return false;
+	}
+
+	std::printf("%-12s %zu physics frames, %10zu heap allocations, parse %.3f s, destroy %.3f s\n",
+		name, physicsFrames, allocations, Seconds(start, parsed), Seconds(parsed, destroyed));
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		std::fprintf(stderr, "Usage: %s <log file>\n", argv[0]);
+		return 1;
+	}
+
+	if (!Run<TASLog>("TASLog", argv[1], [](FILE *file, TASLog &tasLog) { return ParseFile(file, tasLog); }))
+		return 1;
+	if (!Run<ArenaTASLog>("ArenaTASLog", argv[1], [](FILE *file, ArenaTASLog &tasLog) { return ParseArenaFile(file, tasLog); }))
+		return 1;
+
+	ArenaTASLog tasLog;
+	FILE *file = std::fopen(argv[1], "rb");
+	ParseArenaFile(file, tasLog);
+	std::fclose(file);
+
+	const ArenaStats stats = tasLog.GetArenaStats();
+	std::printf("arena: %llu allocations in %zu blocks (%.1f of %.1f MiB used), %llu large allocations\n",
+		static_cast<unsigned long long>(stats.allocationCount), stats.blockCount,
+		stats.bytesUsed / (1024.0 * 1024.0), stats.bytesReserved / (1024.0 * 1024.0),
+		static_cast<unsigned long long>(stats.largeAllocationCount));
+	return 0;
+}
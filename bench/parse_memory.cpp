@@ -0,0 +1,43 @@
+#include <chrono>
+#include <cstdio>
+#include "bench_util.hpp"
+
+using namespace TASLogger;
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		std::fprintf(stderr, "Usage: %s <log file>\n", argv[0]);
+		return 1;
+	}
+
+	FILE *file = std::fopen(argv[1], "rb");
+	if (!file) {
+		std::perror(argv[1]);
+		return 1;
+	}
+
+	const size_t startRSS = Bench::PeakResidentBytes();
+	const auto start = std::chrono::steady_clock::now();
+
+	TASLog tasLog;
+	const rapidjson::ParseResult res = ParseFile(file, tasLog);
+	std::fclose(file);
+
+	const auto end = std::chrono::steady_clock::now();
+	const size_t peakRSS = Bench::PeakResidentBytes();
+	const size_t logBytes = Bench::HeapBytes(tasLog);
+
+	if (res.IsError()) {
+		std::fprintf(stderr, "Parse error %d at offset %zu\n", static_cast<int>(res.Code()), res.Offset());
+		return 1;
+	}
+
+	const double mib = 1024.0 * 1024.0;
+	std::printf("physics frames:   %zu\n", tasLog.physicsFrameList.size());
+	std::printf("parse time:       %.3f s\n", std::chrono::duration<double>(end - start).count());
+	std::printf("TASLog heap size: %.1f MiB\n", logBytes / mib);
+	std::printf("peak RSS growth:  %.1f MiB\n", (peakRSS - startRSS) / mib);
+	std::printf("peak / TASLog:    %.2f\n", static_cast<double>(peakRSS - startRSS) / logBytes);
+	return 0;
+}
@@ -0,0 +1,128 @@
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "taslogger/query.hpp"
+
+using namespace TASLogger;
+
+typedef std::chrono::steady_clock Clock;
+
+static double Seconds(Clock::time_point start, Clock::time_point end)
+{
+	return std::chrono::duration<double>(end - start).count();
+}
+
+// The loops that the queries replace.
+static std::vector<size_t> FilterLandings(const TASLog &tasLog)
+{
+	std::vector<size_t> indexes;
+	bool previousOnGround = true;
+	for (size_t i = 0; i < tasLog.physicsFrameList.size(); ++i) {
+		bool landed = false;
+		for (const ReaderCommandFrame &commandFrame : tasLog.physicsFrameList[i].commandFrameList) {
+			landed |= !previousOnGround && commandFrame.postPMState.onGround;
+			previousOnGround = commandFrame.postPMState.onGround;
+		}
+		if (landed)
+			indexes.push_back(i);
+	}
+	return indexes;
+}
+
+static std::vector<size_t> FilterDamageBits(const TASLog &tasLog, int32_t damageBits)
+{
+	std::vector<size_t> indexes;
+	for (size_t i = 0; i < tasLog.physicsFrameList.size(); ++i) {
+		for (const ReaderDamage &damage : tasLog.physicsFrameList[i].damageList) {
+			if (damage.damageBits & damageBits) {
+				indexes.push_back(i);
+				break;
+			}
+		}
+	}
+	return indexes;
+}
+
+static std::vector<size_t> FilterFramebulks(const TASLog &tasLog, uint32_t first, uint32_t last)
+{
+	std::vector<size_t> indexes;
+	for (size_t i = 0; i < tasLog.physicsFrameList.size(); ++i) {
+		for (const ReaderCommandFrame &commandFrame : tasLog.physicsFrameList[i].commandFrameList) {
+			if (commandFrame.framebulkId >= first && commandFrame.framebulkId <= last) {
+				indexes.push_back(i);
+				break;
+			}
+		}
+	}
+	return indexes;
+}
+
+template<typename Filter>
+static bool Run(const char *name, const char *filename, const FrameQuery &query, Filter filter)
+{
+	const Clock::time_point start = Clock::now();
+	std::vector<size_t> expected;
+	{
+		FILE *file = std::fopen(filename, "rb");
+		if (!file) {
+			std::perror(filename);
+			return false;
+		}
+		TASLog tasLog;
+		const rapidjson::ParseResult res = ParseFile(file, tasLog);
+		std::fclose(file);
+		if (res.IsError()) {
+			std::fprintf(stderr, "Parse error %d at offset %zu\n", static_cast<int>(res.Code()), res.Offset());
+			return false;
+		}
+		expected = filter(tasLog);
+	}
+	const Clock::time_point filtered = Clock::now();
+
+	TASLog tasLog;
+	std::vector<size_t> indexes;
+	const rapidjson::ParseResult res = QueryFile(filename, query, tasLog, indexes);
+	const Clock::time_point queried = Clock::now();
+	if (res.IsError()) {
+		std::fprintf(stderr, "Query error %d at offset %zu\n", static_cast<int>(res.Code()), res.Offset());
+		return false;
+	}
+
+	std::printf("%-10s %8zu matches, parse and filter %.3f s, query %.3f s\n",
+		name, indexes.size(), Seconds(start, filtered), Seconds(filtered, queried));
+	if (indexes != expected) {
+		std::fprintf(stderr, "%s: the query found different frames\n", name);
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		std::fprintf(stderr, "Usage: %s <log file>\n", argv[0]);
+		return 1;
+	}
+
+	FrameQuery landing;
+	landing.fields = 0;
+	landing.landing = true;
+	if (!Run("landing", argv[1], landing, FilterLandings))
+		return 1;
+
+	FrameQuery damage;
+	damage.fields = QUERY_DAMAGES;
+	damage.damageBits = 1 << 5;
+	if (!Run("damage", argv[1], damage, [](const TASLog &tasLog) { return FilterDamageBits(tasLog, 1 << 5); }))
+		return 1;
+
+	FrameQuery framebulks;
+	framebulks.fields = QUERY_COMMAND_FRAMES;
+	framebulks.filterFramebulks = true;
+	framebulks.firstFramebulk = 10;
+	framebulks.lastFramebulk = 20;
+	if (!Run("framebulks", argv[1], framebulks, [](const TASLog &tasLog) { return FilterFramebulks(tasLog, 10, 20); }))
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include "taslogger/common.hpp"
+#include "command_frame.hpp"
+
+namespace TASLogger
+{
+	namespace Bench
+	{
+		// Drives a writer with a deterministic stream of physics frames that
+		// resembles a real run: mostly one command frame per physics frame at
+		// 1000 fps, occasional collisions, damages with punchangles, object
+		// moves and console prints. The same seed always produces the same
+		// calls, independent of the platform.
+		class SyntheticLog
+		{
+		public:
+			explicit SyntheticLog(uint32_t seed = 1) : state(seed ? seed : 1) {}
+
+			template<typename Writer>
+			void Write(Writer &writer, FILE *file, size_t physicsFrames)
+			{
+				float position[3] = {0, 0, 36};
+				float velocity[3] = {0, 0, 0};
+				const float baseVelocity[3] = {0, 0, 0};
+				uint32_t framebulkId = 0;
+
+				writer.StartLog(file, "1.0.0", 8684, "valve");
+				for (size_t i = 0; i < physicsFrames; ++i) {
+					const bool paused = Chance(1, 500);
+					writer.StartPhysicsFrame(0.001, 5, paused, Chance(1, 20) ? "+attack;wait;-attack" : "");
+
+					if (Chance(1, 50))
+						writer.PushConsolePrint("Player health: 100\n");
+					if (Chance(1, 100)) {
+						const Damage damage = {Uniform(1, 50), {Uniform(-1, 1), Uniform(-1, 1), 0}, 1 << 5};
+						writer.PushDamage(damage);
+					}
+					if (Chance(1, 200)) {
+						const ObjectMove objectMove = {{Uniform(-100, 100), Uniform(-100, 100), 0}, {position[0], position[1], position[2]}, Chance(1, 2)};
+						writer.PushObjectMove(objectMove);
+					}
+
+					const uint32_t commandFrames = paused ? 0 : Chance(1, 10) ? 2 : 1;
+					for (uint32_t j = 0; j < commandFrames; ++j) {
+						if (Chance(1, 300))
+							++framebulkId;
+
+						const bool onGround = position[2] <= 36;
+						CommandFrameRecord frame = CommandFrameRecord();
+						frame.framebulkId = framebulkId;
+						frame.msec = 1;
+						frame.frameTimeRemainder = Uniform(0, 0.001);
+						frame.sharedSeed = Next();
+						frame.viewangles[0] = Uniform(-180, 180);
+						frame.viewangles[1] = Uniform(-89, 89);
+						if (Chance(1, 100)) {
+							frame.punchangles[0] = Uniform(-5, 5);
+							frame.punchangles[1] = Uniform(-5, 5);
+						}
+						frame.buttons = Next() & 0xff;
+						frame.FSU[0] = 400;
+						frame.FSU[1] = Uniform(-400, 400);
+						frame.entFriction = 1;
+						frame.entGravity = 1;
+						frame.health = 100;
+						SetPlayerState(frame.prePMState, position, velocity, baseVelocity, onGround);
+
+						velocity[0] += Uniform(-10, 10);
+						velocity[1] += Uniform(-10, 10);
+						velocity[2] = onGround ? (Chance(1, 50) ? 268 : 0) : velocity[2] - 0.8f;
+						for (int k = 0; k < 3; ++k)
+							position[k] += velocity[k] * 0.001f;
+						if (position[2] < 36)
+							position[2] = 36;
+
+						SetPlayerState(frame.postPMState, position, velocity, baseVelocity, position[2] <= 36);
+
+						frame.collisionCount = 0;
+						if (Chance(1, 10)) {
+							frame.collisionCount = 1 + Next() % 2;
+							for (size_t k = 0; k < frame.collisionCount; ++k) {
+								const Collision collision = {{0, 0, 1}, Uniform(0, 1), {velocity[0], velocity[1], velocity[2]}, 0};
+								collisions[k] = collision;
+							}
+						}
+						frame.collisions = collisions;
+
+						if (batchCommandFrames)
+							writer.WriteCommandFrame(frame);
+						else
+							WriteCommandFrameCalls(writer, frame);
+					}
+
+					writer.EndPhysicsFrame();
+				}
+				writer.EndLog();
+			}
+
+			// Write the command frames with WriteCommandFrame instead of the
+			// individual calls.
+			void SetBatchCommandFrames(bool enabled) { batchCommandFrames = enabled; }
+
+		private:
+			static void SetPlayerState(PlayerStateRecord &playerState, const float position[3], const float velocity[3], const float baseVelocity[3], bool onGround)
+			{
+				playerState = PlayerStateRecord();
+				for (int k = 0; k < 3; ++k) {
+					playerState.position[k] = position[k];
+					playerState.velocity[k] = velocity[k];
+					playerState.baseVelocity[k] = baseVelocity[k];
+				}
+				playerState.onGround = onGround;
+				playerState.duckState = UNDUCKED;
+			}
+
+			// xorshift32, so the stream does not depend on the standard
+			// library's distributions.
+			uint32_t Next()
+			{
+				state ^= state << 13;
+				state ^= state >> 17;
+				state ^= state << 5;
+				return state;
+			}
+
+			bool Chance(uint32_t numerator, uint32_t denominator)
+			{
+				return Next() % denominator < numerator;
+			}
+
+			float Uniform(float low, float high)
+			{
+				return low + (high - low) * static_cast<float>(Next() >> 8) / static_cast<float>(1 << 24);
+			}
+
+			uint32_t state;
+			bool batchCommandFrames = false;
+			Collision collisions[2];
+		};
+	}
+}
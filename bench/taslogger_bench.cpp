@@ -0,0 +1,105 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "taslogger/binary_writer.hpp"
+#include "taslogger/writer.hpp"
+#include "bench_util.hpp"
+#include "synthetic_log.hpp"
+
+using namespace TASLogger;
+
+typedef std::chrono::steady_clock Clock;
+
+static double Seconds(Clock::time_point start, Clock::time_point end)
+{
+	return std::chrono::duration<double>(end - start).count();
+}
+
+static void PrintResult(const char *name, size_t physicsFrames, size_t bytes, double seconds)
+{
+	std::printf("%-14s %9zu frames %9.1f MiB %8.3f s %12.0f frames/s %9.1f MiB/s\n",
+		name, physicsFrames, bytes / (1024.0 * 1024.0), seconds, physicsFrames / seconds, bytes / (1024.0 * 1024.0) / seconds);
+}
+
+template<typename Writer>
+static bool BenchWrite(const char *name, FILE *file, size_t physicsFrames, bool batchCommandFrames)
+{
+	Bench::SyntheticLog log;
+	log.SetBatchCommandFrames(batchCommandFrames);
+	Writer writer;
+
+	const Clock::time_point start = Clock::now();
+	log.Write(writer, file, physicsFrames);
+	std::fflush(file);
+	const Clock::time_point end = Clock::now();
+
+	const long bytes = std::ftell(file);
+	if (bytes <= 0) {
+		std::fprintf(stderr, "%s: nothing was written\n", name);
+		return false;
+	}
+
+	PrintResult(name, physicsFrames, static_cast<size_t>(bytes), Seconds(start, end));
+	return true;
+}
+
+static bool BenchParse(const char *name, FILE *file, size_t physicsFrames)
+{
+	const size_t bytes = static_cast<size_t>(std::ftell(file));
+	std::rewind(file);
+
+	TASLog tasLog;
+	const Clock::time_point start = Clock::now();
+	const rapidjson::ParseResult res = ParseFile(file, tasLog);
+	const Clock::time_point end = Clock::now();
+
+	if (res.IsError()) {
+		std::fprintf(stderr, "%s: parse error %d at offset %zu\n", name, static_cast<int>(res.Code()), res.Offset());
+		return false;
+	}
+	if (tasLog.physicsFrameList.size() != physicsFrames) {
+		std::fprintf(stderr, "%s: parsed %zu of %zu physics frames\n", name, tasLog.physicsFrameList.size(), physicsFrames);
+		return false;
+	}
+
+	PrintResult(name, physicsFrames, bytes, Seconds(start, end));
+	std::printf("%-14s TASLog heap %.1f MiB, peak RSS %.1f MiB\n", "",
+		Bench::HeapBytes(tasLog) / (1024.0 * 1024.0), Bench::PeakResidentBytes() / (1024.0 * 1024.0));
+	return true;
+}
+
+template<typename Writer>
+static bool BenchFormat(const char *writeName, const char *parseName, size_t physicsFrames, bool batchCommandFrames = false)
+{
+	FILE *file = std::tmpfile();
+	if (!file) {
+		std::perror("tmpfile");
+		return false;
+	}
+
+	const bool ok = BenchWrite<Writer>(writeName, file, physicsFrames, batchCommandFrames)
+		&& BenchParse(parseName, file, physicsFrames);
+	std::fclose(file);
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<size_t> sizes;
+	for (int i = 1; i < argc; ++i)
+		sizes.push_back(std::strtoul(argv[i], nullptr, 10));
+	if (sizes.empty())
+		sizes = {1000, 10000, 100000, 1000000};
+
+	// Peak RSS only grows, so run the sizes from smallest to largest.
+	for (size_t physicsFrames : sizes) {
+		if (!BenchFormat<LogWriter>("write json", "parse json", physicsFrames))
+			return 1;
+		if (!BenchFormat<LogWriter>("write batch", "parse batch", physicsFrames, true))
+			return 1;
+		if (!BenchFormat<BinaryLogWriter>("write binary", "parse binary", physicsFrames))
+			return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,70 @@
+#include <cstdio>
+#include "taslogger/writer.hpp"
+#include "allocation_counter.hpp"
+#include "synthetic_log.hpp"
+
+using namespace TASLogger;
+
+static const size_t WARMUP_FRAMES = 10000;
+static const size_t MEASURED_FRAMES = 100000;
+
+class NullSink : public OutputSink
+{
+public:
+	bool Write(const char *, size_t) override { return true; }
+};
+
+// Writes to a NullSink and counts the heap allocations of the physics frames
+// after the warm-up.
+class CountingWriter : public LogWriter
+{
+public:
+	void StartLog(FILE *, const char *toolVer, int32_t buildNumber, const char *mod)
+	{
+		LogWriter::StartLog(sink, toolVer, buildNumber, mod);
+		physicsFrames = 0;
+	}
+
+	void StartPhysicsFrame(double frameTime, int32_t clstate, bool paused, const char *cbuf)
+	{
+		if (physicsFrames == WARMUP_FRAMES)
+			startAllocations = Bench::heapAllocations;
+		LogWriter::StartPhysicsFrame(frameTime, clstate, paused, cbuf);
+	}
+
+	void EndPhysicsFrame()
+	{
+		LogWriter::EndPhysicsFrame();
+		if (++physicsFrames == WARMUP_FRAMES + MEASURED_FRAMES)
+			measuredAllocations = Bench::heapAllocations - startAllocations;
+	}
+
+	size_t measuredAllocations = 0;
+
+private:
+	NullSink sink;
+	size_t physicsFrames = 0;
+	size_t startAllocations = 0;
+};
+
+static bool Run(const char *name, bool deltaEncoding, NumberFormat numberFormat)
+{
+	CountingWriter writer;
+	writer.SetDeltaEncoding(deltaEncoding);
+	writer.SetNumberFormat(numberFormat);
+
+	Bench::SyntheticLog log;
+	log.Write(writer, nullptr, WARMUP_FRAMES + MEASURED_FRAMES);
+
+	std::printf("%-8s %zu physics frames after %zu warm-up frames, %zu heap allocations\n",
+		name, MEASURED_FRAMES, WARMUP_FRAMES, writer.measuredAllocations);
+	return writer.measuredAllocations == 0;
+}
+
+int main()
+{
+	bool ok = Run("default", false, NUMBER_FORMAT_DOUBLE);
+	ok &= Run("float", false, NUMBER_FORMAT_FLOAT);
+	ok &= Run("delta", true, NUMBER_FORMAT_DOUBLE);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+#include <cstdlib>
+#include "taslogger/arena.hpp"
+
+using namespace TASLogger;
+
+static thread_local Arena *currentArena = nullptr;
+
+Arena::Arena()
+	: cursor(nullptr), blockEnd(nullptr), nextBlockSize(FIRST_BLOCK_SIZE), stats()
+{
+}
+
+Arena::~Arena()
+{
+	for (char *block : blocks)
+		std::free(block);
+}
+
+void *Arena::Allocate(size_t size, size_t alignment)
+{
+	if (size >= LARGE_ALLOCATION_SIZE) {
+		++stats.largeAllocationCount;
+		return ::operator new(size);
+	}
+
+	++stats.allocationCount;
+	stats.bytesUsed += size;
+
+	uintptr_t p = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1);
+	if (!cursor || p + size > reinterpret_cast<uintptr_t>(blockEnd)) {
+		char *block = static_cast<char *>(std::malloc(nextBlockSize));
+		if (!block)
+			throw std::bad_alloc();
+		blocks.push_back(block);
+		cursor = block;
+		blockEnd = block + nextBlockSize;
+		++stats.blockCount;
+		stats.bytesReserved += nextBlockSize;
+		if (nextBlockSize < MAX_BLOCK_SIZE)
+			nextBlockSize *= 2;
+
+		// Blocks come from malloc and are aligned for any type.
+		p = reinterpret_cast<uintptr_t>(cursor);
+	}
+
+	cursor = reinterpret_cast<char *>(p + size);
+	return reinterpret_cast<void *>(p);
+}
+
+void Arena::Deallocate(void *p, size_t size)
+{
+	if (size >= LARGE_ALLOCATION_SIZE) {
+		++stats.largeDeallocationCount;
+		::operator delete(p);
+	}
+}
+
+ArenaStats Arena::GetStats() const
+{
+	return stats;
+}
+
+Arena *Arena::Current()
+{
+	return currentArena;
+}
+
+ArenaScope::ArenaScope(Arena *arena)
+	: previous(currentArena)
+{
+	currentArena = arena;
+}
+
+ArenaScope::~ArenaScope()
+{
+	currentArena = previous;
+}
@@ -0,0 +1,782 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include "taslogger/async_writer.hpp"
+
+using namespace TASLogger;
+
+enum AsyncOp : uint32_t
+{
+	OpWrap,
+	OpJump,
+	OpStop,
+	OpClear,
+
+	OpStartLog,
+	OpEndLog,
+	OpStartPhysicsFrame,
+	OpEndPhysicsFrame,
+	OpPushConsolePrint,
+	OpPushDamage,
+	OpPushObjectMove,
+	OpSetRng,
+	OpStartCmdFrame,
+	OpEndCmdFrame,
+	OpSetSharedSeed,
+	OpSetViewangles,
+	OpSetPunchangles,
+	OpSetButtons,
+	OpSetImpulse,
+	OpSetFSU,
+	OpSetEntFriction,
+	OpSetEntGravity,
+	OpSetHealth,
+	OpSetArmor,
+	OpPushCollision,
+	OpSetCollisions,
+	OpStartPrePlayer,
+	OpEndPrePlayer,
+	OpStartPostPlayer,
+	OpEndPostPlayer,
+	OpSetPosition,
+	OpSetVelocity,
+	OpSetBaseVelocity,
+	OpSetOnGround,
+	OpSetOnLadder,
+	OpSetWaterLevel,
+	OpSetDuckState,
+	OpWriteCommandFrame
+};
+
+struct RecordHeader
+{
+	uint32_t size;
+	uint32_t op;
+};
+
+struct StartLogEvent
+{
+	FILE *file;
+	OutputSink *sink;
+	int32_t buildNumber;
+	uint32_t toolVerLength;
+	uint32_t modLength;
+};
+
+struct StartPhysicsFrameEvent
+{
+	double frameTime;
+	int32_t clstate;
+	uint32_t cbufLength;
+	bool paused;
+};
+
+struct StartCmdFrameEvent
+{
+	double remainder;
+	uint32_t framebulkId;
+	uint32_t msec;
+};
+
+struct Vec3dEvent
+{
+	double v[3];
+};
+
+struct Vec3fEvent
+{
+	float v[3];
+};
+
+static const size_t RECORD_ALIGNMENT = 8;
+
+static inline size_t AlignRecord(size_t size)
+{
+	return (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+}
+
+template<typename T>
+static inline T ReadPayload(const char *payload)
+{
+	T value;
+	std::memcpy(&value, payload, sizeof(T));
+	return value;
+}
+
+static void Backoff(unsigned &spins)
+{
+	if (spins < 64)
+		++spins;
+	else if (spins < 128) {
+		++spins;
+		std::this_thread::yield();
+	} else
+		std::this_thread::sleep_for(std::chrono::microseconds(500));
+}
+
+// Byte ring with monotonically increasing head and tail offsets. The producer
+// only writes tail and next, the consumer only writes head.
+struct AsyncLogWriter::Ring
+{
+	explicit Ring(size_t capacity)
+		: data(new char[capacity]), capacity(capacity), head(0), tail(0), next(nullptr)
+	{
+	}
+
+	~Ring()
+	{
+		delete[] data;
+	}
+
+	char *const data;
+	const size_t capacity;
+	std::atomic<size_t> head;
+	char padding[64];
+	std::atomic<size_t> tail;
+	std::atomic<Ring *> next;
+};
+
+AsyncLogWriter::AsyncLogWriter()
+	: AsyncLogWriter(AsyncWriterOptions())
+{
+}
+
+AsyncLogWriter::AsyncLogWriter(const AsyncWriterOptions &options)
+	: options(options)
+{
+	this->options.capacity = AlignRecord(std::max<size_t>(options.capacity, 4096));
+	this->options.maxCapacity = std::max(this->options.capacity, options.maxCapacity);
+	producerRing = consumerRing = new Ring(this->options.capacity);
+	writer.SetNumberFormat(options.numberFormat);
+	writer.SetDeltaEncoding(options.deltaEncoding);
+	writer.SetCompression(options.compression, options.compressionLevel);
+	writer.SetIndexFile(options.indexFile);
+	writer.SetBufferSize(options.outputBufferSize);
+	writer.SetDurability(options.durability);
+}
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+	Stop();
+
+	while (consumerRing) {
+		Ring *next = consumerRing->next.load(std::memory_order_acquire);
+		delete consumerRing;
+		consumerRing = next;
+	}
+}
+
+char *AsyncLogWriter::Reserve(uint32_t op, size_t payloadSize)
+{
+	if (droppingFrame)
+		return nullptr;
+
+	const size_t size = AlignRecord(sizeof(RecordHeader) + payloadSize);
+	unsigned spins = 0;
+	bool wasFull = false;
+
+	for (;;) {
+		Ring *ring = producerRing;
+		const size_t pos = pendingTail % ring->capacity;
+		const size_t contiguous = ring->capacity - pos;
+		const size_t waste = contiguous < size ? contiguous : 0;
+		const size_t used = pendingTail - ring->head.load(std::memory_order_acquire);
+
+		// Always keep room for one more header so that Grow can place a jump.
+		if (waste + size + sizeof(RecordHeader) <= ring->capacity - used)
+			break;
+
+		if (!wasFull) {
+			wasFull = true;
+			++fullCount;
+		}
+
+		// A record that can never fit is let through by growing past maxCapacity.
+		const bool oversized = size + 2 * sizeof(RecordHeader) > ring->capacity;
+
+		if (options.policy == DROP_WHEN_FULL && inPhysicsFrame) {
+			pendingTail = ring->tail.load(std::memory_order_relaxed);
+			droppingFrame = true;
+			return nullptr;
+		}
+
+		if (oversized || (options.policy == GROW_WHEN_FULL && ring->capacity < options.maxCapacity)) {
+			Grow(size);
+			continue;
+		}
+
+		Commit();
+		Backoff(spins);
+	}
+
+	Ring *ring = producerRing;
+	size_t pos = pendingTail % ring->capacity;
+	if (ring->capacity - pos < size) {
+		RecordHeader wrap = { static_cast<uint32_t>(ring->capacity - pos), OpWrap };
+		std::memcpy(ring->data + pos, &wrap, sizeof(wrap));
+		pendingTail += wrap.size;
+		pos = 0;
+	}
+
+	RecordHeader header = { static_cast<uint32_t>(size), op };
+	std::memcpy(ring->data + pos, &header, sizeof(header));
+	pendingTail += size;
+	++eventCount;
+
+	const size_t used = pendingTail - ring->head.load(std::memory_order_relaxed);
+	if (used > highWaterMark)
+		highWaterMark = used;
+
+	return ring->data + pos + sizeof(RecordHeader);
+}
+
+void AsyncLogWriter::Record(uint32_t op)
+{
+	Reserve(op, 0);
+}
+
+template<typename T>
+void AsyncLogWriter::Record(uint32_t op, const T &payload)
+{
+	char *p = Reserve(op, sizeof(T));
+	if (p)
+		std::memcpy(p, &payload, sizeof(T));
+}
+
+void AsyncLogWriter::RecordString(uint32_t op, const char *str)
+{
+	const size_t length = std::strlen(str);
+	char *p = Reserve(op, length + 1);
+	if (p)
+		std::memcpy(p, str, length + 1);
+}
+
+void AsyncLogWriter::Commit()
+{
+	producerRing->tail.store(pendingTail, std::memory_order_release);
+}
+
+void AsyncLogWriter::Grow(size_t recordSize)
+{
+	Ring *ring = producerRing;
+	size_t capacity = std::min(ring->capacity * 2, options.maxCapacity);
+	while (capacity < recordSize + 2 * sizeof(RecordHeader))
+		capacity *= 2;
+
+	Ring *newRing = new Ring(capacity);
+	ring->next.store(newRing, std::memory_order_relaxed);
+
+	RecordHeader jump = { static_cast<uint32_t>(sizeof(RecordHeader)), OpJump };
+	std::memcpy(ring->data + pendingTail % ring->capacity, &jump, sizeof(jump));
+	pendingTail += sizeof(jump);
+	Commit();
+
+	producerRing = newRing;
+	pendingTail = 0;
+	++growCount;
+}
+
+void AsyncLogWriter::Stop()
+{
+	if (!thread.joinable())
+		return;
+
+	droppingFrame = false;
+	inPhysicsFrame = false;
+	Record(OpStop);
+	Commit();
+	thread.join();
+}
+
+void AsyncLogWriter::Run()
+{
+	unsigned spins = 0;
+
+	for (;;) {
+		Ring *ring = consumerRing;
+		size_t head = ring->head.load(std::memory_order_relaxed);
+		const size_t tail = ring->tail.load(std::memory_order_acquire);
+
+		if (head == tail) {
+			Backoff(spins);
+			continue;
+		}
+		spins = 0;
+
+		while (head != tail) {
+			const char *record = ring->data + head % ring->capacity;
+			RecordHeader header;
+			std::memcpy(&header, record, sizeof(header));
+
+			if (header.op == OpJump) {
+				consumerRing = ring->next.load(std::memory_order_acquire);
+				delete ring;
+				break;
+			}
+
+			if (header.op != OpWrap && !Dispatch(header.op, record + sizeof(RecordHeader))) {
+				ring->head.store(head + header.size, std::memory_order_release);
+				return;
+			}
+
+			head += header.size;
+			ring->head.store(head, std::memory_order_release);
+		}
+	}
+}
+
+bool AsyncLogWriter::Dispatch(uint32_t op, const char *payload)
+{
+	switch (op) {
+	case OpStop:
+		return false;
+	case OpClear:
+		writer.Clear();
+		break;
+	case OpStartLog: {
+		const StartLogEvent e = ReadPayload<StartLogEvent>(payload);
+		const char *toolVer = payload + sizeof(e);
+		const char *mod = toolVer + e.toolVerLength + 1;
+		if (!segmentBasePath.empty())
+			writer.StartSegmentedLog(segmentBasePath.c_str(), segmentOptions, toolVer, e.buildNumber, mod);
+		else if (e.sink)
+			writer.StartLog(*e.sink, toolVer, e.buildNumber, mod);
+		else
+			writer.StartLog(e.file, toolVer, e.buildNumber, mod);
+		break;
+	}
+	case OpEndLog:
+		writer.EndLog();
+		break;
+	case OpStartPhysicsFrame: {
+		const StartPhysicsFrameEvent e = ReadPayload<StartPhysicsFrameEvent>(payload);
+		writer.StartPhysicsFrame(e.frameTime, e.clstate, e.paused, payload + sizeof(e));
+		break;
+	}
+	case OpEndPhysicsFrame:
+		writer.EndPhysicsFrame();
+		break;
+	case OpPushConsolePrint:
+		writer.PushConsolePrint(payload);
+		break;
+	case OpPushDamage:
+		writer.PushDamage(ReadPayload<Damage>(payload));
+		break;
+	case OpPushObjectMove:
+		writer.PushObjectMove(ReadPayload<ObjectMove>(payload));
+		break;
+	case OpSetRng:
+		writer.SetRng(ReadPayload<RngState>(payload));
+		break;
+	case OpStartCmdFrame: {
+		const StartCmdFrameEvent e = ReadPayload<StartCmdFrameEvent>(payload);
+		writer.StartCmdFrame(e.framebulkId, e.msec, e.remainder);
+		break;
+	}
+	case OpEndCmdFrame:
+		writer.EndCmdFrame();
+		break;
+	case OpSetSharedSeed:
+		writer.SetSharedSeed(ReadPayload<uint32_t>(payload));
+		break;
+	case OpSetViewangles: {
+		const Vec3dEvent e = ReadPayload<Vec3dEvent>(payload);
+		writer.SetViewangles(e.v[0], e.v[1], e.v[2]);
+		break;
+	}
+	case OpSetPunchangles: {
+		const Vec3dEvent e = ReadPayload<Vec3dEvent>(payload);
+		writer.SetPunchangles(e.v[0], e.v[1], e.v[2]);
+		break;
+	}
+	case OpSetButtons:
+		writer.SetButtons(ReadPayload<uint32_t>(payload));
+		break;
+	case OpSetImpulse:
+		writer.SetImpulse(ReadPayload<uint32_t>(payload));
+		break;
+	case OpSetFSU: {
+		const Vec3dEvent e = ReadPayload<Vec3dEvent>(payload);
+		writer.SetFSU(e.v[0], e.v[1], e.v[2]);
+		break;
+	}
+	case OpSetEntFriction:
+		writer.SetEntFriction(ReadPayload<double>(payload));
+		break;
+	case OpSetEntGravity:
+		writer.SetEntGravity(ReadPayload<double>(payload));
+		break;
+	case OpSetHealth:
+		writer.SetHealth(ReadPayload<double>(payload));
+		break;
+	case OpSetArmor:
+		writer.SetArmor(ReadPayload<double>(payload));
+		break;
+	case OpPushCollision:
+		writer.PushCollision(ReadPayload<Collision>(payload));
+		break;
+	case OpSetCollisions: {
+		const uint32_t count = ReadPayload<uint32_t>(payload);
+		writer.SetCollisions(nullptr, 0);
+		for (uint32_t i = 0; i < count; ++i)
+			writer.PushCollision(ReadPayload<Collision>(payload + RECORD_ALIGNMENT + i * sizeof(Collision)));
+		break;
+	}
+	case OpStartPrePlayer:
+		writer.StartPrePlayer();
+		break;
+	case OpEndPrePlayer:
+		writer.EndPrePlayer();
+		break;
+	case OpStartPostPlayer:
+		writer.StartPostPlayer();
+		break;
+	case OpEndPostPlayer:
+		writer.EndPostPlayer();
+		break;
+	case OpSetPosition:
+		writer.SetPosition(ReadPayload<Vec3fEvent>(payload).v);
+		break;
+	case OpSetVelocity:
+		writer.SetVelocity(ReadPayload<Vec3fEvent>(payload).v);
+		break;
+	case OpSetBaseVelocity:
+		writer.SetBaseVelocity(ReadPayload<Vec3fEvent>(payload).v);
+		break;
+	case OpSetOnGround:
+		writer.SetOnGround(ReadPayload<bool>(payload));
+		break;
+	case OpSetOnLadder:
+		writer.SetOnLadder(ReadPayload<bool>(payload));
+		break;
+	case OpSetWaterLevel:
+		writer.SetWaterLevel(ReadPayload<uint32_t>(payload));
+		break;
+	case OpSetDuckState:
+		writer.SetDuckState(static_cast<DuckState>(ReadPayload<uint32_t>(payload)));
+		break;
+	case OpWriteCommandFrame: {
+		CommandFrameRecord frame = ReadPayload<CommandFrameRecord>(payload);
+		payload += AlignRecord(sizeof(frame));
+		commandFrameCollisions.resize(frame.collisionCount);
+		for (size_t i = 0; i < frame.collisionCount; ++i)
+			commandFrameCollisions[i] = ReadPayload<Collision>(payload + i * sizeof(Collision));
+		frame.collisions = commandFrameCollisions.data();
+		writer.WriteCommandFrame(frame);
+		break;
+	}
+	}
+
+	return true;
+}
+
+void AsyncLogWriter::Clear()
+{
+	if (thread.joinable())
+		Record(OpClear);
+	else
+		writer.Clear();
+}
+
+AsyncWriterStats AsyncLogWriter::GetStats() const
+{
+	AsyncWriterStats stats;
+	stats.capacity = producerRing->capacity;
+	stats.highWaterMark = highWaterMark;
+	stats.eventCount = eventCount;
+	stats.fullCount = fullCount;
+	stats.droppedFrames = droppedFrames;
+	stats.growCount = growCount;
+	return stats;
+}
+
+void AsyncLogWriter::StartLog(FILE *file, const char *toolVer, int32_t buildNumber, const char *mod)
+{
+	Start(file, nullptr, nullptr, toolVer, buildNumber, mod);
+}
+
+void AsyncLogWriter::StartLog(OutputSink &sink, const char *toolVer, int32_t buildNumber, const char *mod)
+{
+	Start(nullptr, &sink, nullptr, toolVer, buildNumber, mod);
+}
+
+void AsyncLogWriter::StartSegmentedLog(const char *basePath, const SegmentOptions &options, const char *toolVer, int32_t buildNumber, const char *mod)
+{
+	Stop();
+	segmentOptions = options;
+	Start(nullptr, nullptr, basePath, toolVer, buildNumber, mod);
+}
+
+void AsyncLogWriter::Start(FILE *file, OutputSink *sink, const char *segmentBasePath, const char *toolVer, int32_t buildNumber, const char *mod)
+{
+	Stop();
+	this->segmentBasePath = segmentBasePath ? segmentBasePath : "";
+
+	StartLogEvent e;
+	e.file = file;
+	e.sink = sink;
+	e.buildNumber = buildNumber;
+	e.toolVerLength = static_cast<uint32_t>(std::strlen(toolVer));
+	e.modLength = static_cast<uint32_t>(std::strlen(mod));
+
+	char *p = Reserve(OpStartLog, sizeof(e) + e.toolVerLength + 1 + e.modLength + 1);
+	std::memcpy(p, &e, sizeof(e));
+	std::memcpy(p + sizeof(e), toolVer, e.toolVerLength + 1);
+	std::memcpy(p + sizeof(e) + e.toolVerLength + 1, mod, e.modLength + 1);
+	Commit();
+
+	thread = std::thread(&AsyncLogWriter::Run, this);
+}
+
+void AsyncLogWriter::EndLog()
+{
+	if (!thread.joinable())
+		return;
+
+	Record(OpEndLog);
+	Stop();
+}
+
+void AsyncLogWriter::StartPhysicsFrame(double frameTime, int32_t clstate, bool paused, const char *cbuf)
+{
+	inPhysicsFrame = true;
+
+	StartPhysicsFrameEvent e;
+	e.frameTime = frameTime;
+	e.clstate = clstate;
+	e.paused = paused;
+	e.cbufLength = static_cast<uint32_t>(std::strlen(cbuf));
+
+	char *p = Reserve(OpStartPhysicsFrame, sizeof(e) + e.cbufLength + 1);
+	if (p) {
+		std::memcpy(p, &e, sizeof(e));
+		std::memcpy(p + sizeof(e), cbuf, e.cbufLength + 1);
+	}
+}
+
+void AsyncLogWriter::EndPhysicsFrame()
+{
+	Record(OpEndPhysicsFrame);
+	inPhysicsFrame = false;
+
+	if (droppingFrame) {
+		droppingFrame = false;
+		++droppedFrames;
+		return;
+	}
+
+	Commit();
+}
+
+void AsyncLogWriter::PushConsolePrint(const char *message)
+{
+	RecordString(OpPushConsolePrint, message);
+}
+
+void AsyncLogWriter::PushDamage(const Damage &damage)
+{
+	Record(OpPushDamage, damage);
+}
+
+void AsyncLogWriter::PushObjectMove(const ObjectMove &objectMove)
+{
+	Record(OpPushObjectMove, objectMove);
+}
+
+void AsyncLogWriter::SetRng(const RngState &rng)
+{
+	Record(OpSetRng, rng);
+}
+
+void AsyncLogWriter::StartCmdFrame(uint32_t framebulkId, uint32_t msec, double remainder)
+{
+	StartCmdFrameEvent e;
+	e.remainder = remainder;
+	e.framebulkId = framebulkId;
+	e.msec = msec;
+	Record(OpStartCmdFrame, e);
+}
+
+void AsyncLogWriter::EndCmdFrame()
+{
+	Record(OpEndCmdFrame);
+}
+
+void AsyncLogWriter::SetSharedSeed(uint32_t seed)
+{
+	Record(OpSetSharedSeed, seed);
+}
+
+void AsyncLogWriter::SetViewangles(double yaw, double pitch, double roll)
+{
+	const Vec3dEvent e = { { yaw, pitch, roll } };
+	Record(OpSetViewangles, e);
+}
+
+void AsyncLogWriter::SetPunchangles(double yaw, double pitch, double roll)
+{
+	if (yaw == 0.0 && pitch == 0.0 && roll == 0.0)
+		return;
+	const Vec3dEvent e = { { yaw, pitch, roll } };
+	Record(OpSetPunchangles, e);
+}
+
+void AsyncLogWriter::SetButtons(uint32_t buttons)
+{
+	Record(OpSetButtons, buttons);
+}
+
+void AsyncLogWriter::SetImpulse(uint32_t impulse)
+{
+	if (impulse == 0)
+		return;
+	Record(OpSetImpulse, impulse);
+}
+
+void AsyncLogWriter::SetFSU(double F, double S, double U)
+{
+	const Vec3dEvent e = { { F, S, U } };
+	Record(OpSetFSU, e);
+}
+
+void AsyncLogWriter::SetEntFriction(double friction)
+{
+	if (friction == 1.0)
+		return;
+	Record(OpSetEntFriction, friction);
+}
+
+void AsyncLogWriter::SetEntGravity(double gravity)
+{
+	if (gravity == 1.0)
+		return;
+	Record(OpSetEntGravity, gravity);
+}
+
+void AsyncLogWriter::SetHealth(double health)
+{
+	Record(OpSetHealth, health);
+}
+
+void AsyncLogWriter::SetArmor(double armor)
+{
+	Record(OpSetArmor, armor);
+}
+
+void AsyncLogWriter::PushCollision(const Collision &collision)
+{
+	Record(OpPushCollision, collision);
+}
+
+void AsyncLogWriter::SetCollisions(const Collision *collisions, size_t count)
+{
+	const uint32_t count32 = static_cast<uint32_t>(count);
+	char *p = Reserve(OpSetCollisions, RECORD_ALIGNMENT + count * sizeof(Collision));
+	if (!p)
+		return;
+
+	std::memcpy(p, &count32, sizeof(count32));
+	if (count != 0)
+		std::memcpy(p + RECORD_ALIGNMENT, collisions, count * sizeof(Collision));
+}
+
+void AsyncLogWriter::SetCollisions(const std::deque<Collision> &collisions)
+{
+	const uint32_t count = static_cast<uint32_t>(collisions.size());
+	char *p = Reserve(OpSetCollisions, RECORD_ALIGNMENT + count * sizeof(Collision));
+	if (!p)
+		return;
+
+	std::memcpy(p, &count, sizeof(count));
+	p += RECORD_ALIGNMENT;
+	for (const Collision &collision : collisions) {
+		std::memcpy(p, &collision, sizeof(collision));
+		p += sizeof(collision);
+	}
+}
+
+// The collisions are copied into the record after the frame.
+void AsyncLogWriter::WriteCommandFrame(const CommandFrameRecord &frame)
+{
+	const size_t collisionsOffset = AlignRecord(sizeof(frame));
+	char *p = Reserve(OpWriteCommandFrame, collisionsOffset + frame.collisionCount * sizeof(Collision));
+	if (!p)
+		return;
+
+	std::memcpy(p, &frame, sizeof(frame));
+	if (frame.collisionCount != 0)
+		std::memcpy(p + collisionsOffset, frame.collisions, frame.collisionCount * sizeof(Collision));
+}
+
+void AsyncLogWriter::WriteCommandFrames(const CommandFrameRecord *frames, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		WriteCommandFrame(frames[i]);
+}
+
+void AsyncLogWriter::StartPrePlayer()
+{
+	Record(OpStartPrePlayer);
+}
+
+void AsyncLogWriter::EndPrePlayer()
+{
+	Record(OpEndPrePlayer);
+}
+
+void AsyncLogWriter::StartPostPlayer()
+{
+	Record(OpStartPostPlayer);
+}
+
+void AsyncLogWriter::EndPostPlayer()
+{
+	Record(OpEndPostPlayer);
+}
+
+void AsyncLogWriter::SetPosition(const float position[3])
+{
+	const Vec3fEvent e = { { position[0], position[1], position[2] } };
+	Record(OpSetPosition, e);
+}
+
+void AsyncLogWriter::SetVelocity(const float velocity[3])
+{
+	const Vec3fEvent e = { { velocity[0], velocity[1], velocity[2] } };
+	Record(OpSetVelocity, e);
+}
+
+void AsyncLogWriter::SetBaseVelocity(const float baseVelocity[3])
+{
+	if (baseVelocity[0] == 0.0 && baseVelocity[1] == 0.0 && baseVelocity[2] == 0.0)
+		return;
+	const Vec3fEvent e = { { baseVelocity[0], baseVelocity[1], baseVelocity[2] } };
+	Record(OpSetBaseVelocity, e);
+}
+
+void AsyncLogWriter::SetOnGround(bool onGround)
+{
+	Record(OpSetOnGround, onGround);
+}
+
+void AsyncLogWriter::SetOnLadder(bool onLadder)
+{
+	if (!onLadder)
+		return;
+	Record(OpSetOnLadder, onLadder);
+}
+
+void AsyncLogWriter::SetWaterLevel(uint32_t waterLevel)
+{
+	if (waterLevel == 0)
+		return;
+	Record(OpSetWaterLevel, waterLevel);
+}
+
+void AsyncLogWriter::SetDuckState(DuckState duckState)
+{
+	if (duckState == UNDUCKED)
+		return;
+	Record(OpSetDuckState, static_cast<uint32_t>(duckState));
+}
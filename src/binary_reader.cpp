@@ -0,0 +1,446 @@
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+#include "taslogger/reader.hpp"
+#include "binary_reader.hpp"
+#include "frame_recycler.hpp"
+#include "rng.hpp"
+
+using namespace TASLogger;
+
+// When the size of the file is unknown, no string or list may take more
+// than this many bytes.
+const uint64_t UNSIZED_LIMIT = 16 << 20;
+
+// The smallest encoded sizes of the list items.
+const size_t MIN_CONSOLE_MESSAGE_SIZE = 1;
+const size_t MIN_DAMAGE_SIZE = 1 + 4 + 1;
+const size_t MIN_OBJECT_MOVE_SIZE = 1 + 2 * 12;
+const size_t MIN_COLLISION_SIZE = 1 + 12 + 4 + 12;
+
+// The number of bytes from the current position to the end of the file, or
+// UINT64_MAX if it is not a regular file.
+static uint64_t BytesLeft(FILE *file)
+{
+#ifdef _WIN32
+	struct _stat64 st;
+	const __int64 position = _ftelli64(file);
+	if (position < 0 || _fstat64(_fileno(file), &st) != 0 || !(st.st_mode & _S_IFREG) || st.st_size < position)
+		return UINT64_MAX;
+#else
+	struct stat st;
+	const off_t position = ftello(file);
+	if (position < 0 || fstat(fileno(file), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < position)
+		return UINT64_MAX;
+#endif
+	return static_cast<uint64_t>(st.st_size - position);
+}
+
+class BinaryReader
+{
+public:
+	explicit BinaryReader(FILE *file);
+
+	bool ReadByte(uint8_t &value);
+	bool ReadVarint(uint64_t &value);
+	bool ReadSignedVarint(int64_t &value);
+	bool ReadFloat(float &value);
+	bool ReadFloats(float values[3]);
+	bool ReadString(std::string &str);
+	bool ReadBytes(char *dest, size_t length);
+
+	// Whether count items of at least itemSize bytes each fit in what is left
+	// of the file, so that corrupted counts fail before anything is
+	// allocated for them.
+	bool CanRead(uint64_t count, size_t itemSize) const;
+
+	template<typename T>
+	bool ReadVarint(T &value)
+	{
+		uint64_t v;
+		if (!ReadVarint(v))
+			return false;
+		value = static_cast<T>(v);
+		return true;
+	}
+
+	template<typename T>
+	bool ReadSignedVarint(T &value)
+	{
+		int64_t v;
+		if (!ReadSignedVarint(v))
+			return false;
+		value = static_cast<T>(v);
+		return true;
+	}
+
+	inline size_t Tell() const { return offset + pos; }
+
+private:
+	bool Fill();
+
+	FILE *file;
+	uint64_t size;
+	size_t pos;
+	size_t end;
+	size_t offset;
+	char buf[65536];
+};
+
+BinaryReader::BinaryReader(FILE *file)
+	: file(file), size(BytesLeft(file)), pos(0), end(0), offset(0)
+{
+}
+
+bool BinaryReader::CanRead(uint64_t count, size_t itemSize) const
+{
+	const uint64_t left = size == UINT64_MAX ? UNSIZED_LIMIT : size - std::min<uint64_t>(size, Tell());
+	return count <= left / itemSize;
+}
+
+bool BinaryReader::Fill()
+{
+	offset += end;
+	pos = 0;
+	end = std::fread(buf, 1, sizeof(buf), file);
+	return end != 0;
+}
+
+bool BinaryReader::ReadByte(uint8_t &value)
+{
+	if (pos == end && !Fill())
+		return false;
+	value = static_cast<uint8_t>(buf[pos++]);
+	return true;
+}
+
+bool BinaryReader::ReadVarint(uint64_t &value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		uint8_t byte;
+		if (!ReadByte(byte))
+			return false;
+		value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+bool BinaryReader::ReadSignedVarint(int64_t &value)
+{
+	uint64_t v;
+	if (!ReadVarint(v))
+		return false;
+	value = static_cast<int64_t>((v >> 1) ^ (~(v & 1) + 1));
+	return true;
+}
+
+bool BinaryReader::ReadFloat(float &value)
+{
+	uint8_t bytes[4];
+	if (!ReadBytes(reinterpret_cast<char *>(bytes), sizeof(bytes)))
+		return false;
+	const uint32_t bits = static_cast<uint32_t>(bytes[0])
+		| static_cast<uint32_t>(bytes[1]) << 8
+		| static_cast<uint32_t>(bytes[2]) << 16
+		| static_cast<uint32_t>(bytes[3]) << 24;
+	std::memcpy(&value, &bits, sizeof(value));
+	return true;
+}
+
+bool BinaryReader::ReadFloats(float values[3])
+{
+	return ReadFloat(values[0]) && ReadFloat(values[1]) && ReadFloat(values[2]);
+}
+
+bool BinaryReader::ReadBytes(char *dest, size_t length)
+{
+	while (length) {
+		if (pos == end && !Fill())
+			return false;
+		const size_t n = std::min(length, end - pos);
+		std::memcpy(dest, buf + pos, n);
+		pos += n;
+		dest += n;
+		length -= n;
+	}
+	return true;
+}
+
+bool BinaryReader::ReadString(std::string &str)
+{
+	uint64_t length;
+	if (!ReadVarint(length) || !CanRead(length, 1))
+		return false;
+	str.resize(length);
+	return length == 0 || ReadBytes(&str[0], length);
+}
+
+static bool ReadPlayerState(BinaryReader &reader, ReaderPlayerState &playerState)
+{
+	uint32_t bits;
+	if (!reader.ReadVarint(bits))
+		return false;
+
+	playerState.baseVelocity[0] = 0;
+	playerState.baseVelocity[1] = 0;
+	playerState.baseVelocity[2] = 0;
+	playerState.onGround = (bits & PS_ONGROUND) != 0;
+	playerState.onLadder = (bits & PS_ONLADDER) != 0;
+	playerState.waterLevel = 0;
+	playerState.duckState = static_cast<uint8_t>(UNDUCKED);
+
+	if ((bits & PS_POSITION) && !reader.ReadFloats(playerState.position))
+		return false;
+	if ((bits & PS_VELOCITY) && !reader.ReadFloats(playerState.velocity))
+		return false;
+	if ((bits & PS_BASEVELOCITY) && !reader.ReadFloats(playerState.baseVelocity))
+		return false;
+	if ((bits & PS_WATERLEVEL) && !reader.ReadVarint(playerState.waterLevel))
+		return false;
+	if ((bits & PS_DUCK_STATE) && !reader.ReadVarint(playerState.duckState))
+		return false;
+	return true;
+}
+
+static bool ReadCommandFrame(BinaryReader &reader, ReaderCommandFrame &frame)
+{
+	uint32_t bits;
+	if (!reader.ReadVarint(bits)
+		|| !reader.ReadVarint(frame.msec)
+		|| !reader.ReadFloat(frame.frameTimeRemainder)
+		|| !reader.ReadVarint(frame.framebulkId))
+		return false;
+
+	frame.punchangles[0] = 0;
+	frame.punchangles[1] = 0;
+	frame.punchangles[2] = 0;
+	frame.impulse = 0;
+	frame.entFriction = 1;
+	frame.entGravity = 1;
+
+	if ((bits & CF_SHARED_SEED) && !reader.ReadVarint(frame.sharedSeed))
+		return false;
+	if ((bits & CF_VIEWANGLES) && !reader.ReadFloats(frame.viewangles))
+		return false;
+	if ((bits & CF_PUNCHANGLES) && !reader.ReadFloats(frame.punchangles))
+		return false;
+	if ((bits & CF_BUTTONS) && !reader.ReadVarint(frame.buttons))
+		return false;
+	if ((bits & CF_IMPULSE) && !reader.ReadVarint(frame.impulse))
+		return false;
+	if ((bits & CF_FSU) && !reader.ReadFloats(frame.FSU))
+		return false;
+	if ((bits & CF_ENT_FRICTION) && !reader.ReadFloat(frame.entFriction))
+		return false;
+	if ((bits & CF_ENT_GRAVITY) && !reader.ReadFloat(frame.entGravity))
+		return false;
+	if ((bits & CF_HEALTH) && !reader.ReadFloat(frame.health))
+		return false;
+	if ((bits & CF_ARMOR) && !reader.ReadFloat(frame.armor))
+		return false;
+	if ((bits & CF_PRE_PLAYERMOVE) && !ReadPlayerState(reader, frame.prePMState))
+		return false;
+	if ((bits & CF_POST_PLAYERMOVE) && !ReadPlayerState(reader, frame.postPMState))
+		return false;
+
+	if (bits & CF_COLLISIONS) {
+		size_t count;
+		if (!reader.ReadVarint(count) || !reader.CanRead(count, MIN_COLLISION_SIZE))
+			return false;
+		frame.collisionList.resize(count);
+		for (ReaderCollision &collision : frame.collisionList) {
+			if (!reader.ReadSignedVarint(collision.entity)
+				|| !reader.ReadFloats(collision.normal)
+				|| !reader.ReadFloat(collision.distance)
+				|| !reader.ReadFloats(collision.impactVelocity))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+// rngBase is the previous state, which a step count refers to.
+static bool ReadPhysicsFrameEnd(BinaryReader &reader, FrameRecycler<ReaderPhysicsFrame> &recycler, ReaderPhysicsFrame &frame, RngState &rngBase, bool &rngBaseSet)
+{
+	uint32_t bits;
+	if (!reader.ReadVarint(bits))
+		return false;
+
+	if (bits & PF_CONSOLE_MESSAGES) {
+		size_t count;
+		if (!reader.ReadVarint(count) || !reader.CanRead(count, MIN_CONSOLE_MESSAGE_SIZE))
+			return false;
+		for (size_t i = 0; i < count; ++i)
+			if (!reader.ReadString(recycler.AddConsolePrint(frame)))
+				return false;
+	}
+
+	if (bits & PF_DAMAGES) {
+		size_t count;
+		if (!reader.ReadVarint(count) || !reader.CanRead(count, MIN_DAMAGE_SIZE))
+			return false;
+		frame.damageList.resize(count);
+		for (ReaderDamage &damage : frame.damageList) {
+			uint8_t itemBits;
+			if (!reader.ReadByte(itemBits)
+				|| !reader.ReadFloat(damage.damage)
+				|| !reader.ReadSignedVarint(damage.damageBits))
+				return false;
+			damage.direction[0] = 0;
+			damage.direction[1] = 0;
+			damage.direction[2] = 0;
+			if ((itemBits & ITEM_DAMAGE_DIRECTION) && !reader.ReadFloats(damage.direction))
+				return false;
+		}
+	}
+
+	if (bits & PF_OBJECT_MOVES) {
+		size_t count;
+		if (!reader.ReadVarint(count) || !reader.CanRead(count, MIN_OBJECT_MOVE_SIZE))
+			return false;
+		frame.objectMoveList.resize(count);
+		for (ReaderObjectMove &objectMove : frame.objectMoveList) {
+			uint8_t itemBits;
+			if (!reader.ReadByte(itemBits)
+				|| !reader.ReadFloats(objectMove.velocity)
+				|| !reader.ReadFloats(objectMove.position))
+				return false;
+			objectMove.pull = (itemBits & ITEM_OBJECT_PULL) != 0;
+		}
+	}
+
+	if (bits & PF_RNG) {
+		if (!reader.ReadSignedVarint(frame.rng.idum) || !reader.ReadSignedVarint(frame.rng.iy))
+			return false;
+		for (int32_t &iv : frame.rng.iv)
+			if (!reader.ReadSignedVarint(iv))
+				return false;
+		rngBase = frame.rng;
+		rngBaseSet = true;
+	} else if (bits & PF_RNG_STEPS) {
+		uint32_t steps;
+		if (!reader.ReadVarint(steps) || !rngBaseSet || steps > RNG_MAX_STEPS)
+			return false;
+		for (uint32_t i = 0; i < steps; ++i)
+			AdvanceRng(rngBase);
+		frame.rng = rngBase;
+	}
+
+	return true;
+}
+
+// With recovery, a parse that fails after the header keeps the complete
+// physics frames and succeeds.
+static rapidjson::ParseResult ParseBinary(FILE *file, TASLog &tasLog, const PhysicsFrameCallback &callback, RecoveryInfo *recovery)
+{
+	BinaryReader reader(file);
+	ReaderPhysicsFrame *physicsFrame = nullptr;
+	ReaderPhysicsFrame streamedFrame;
+	FrameRecycler<ReaderPhysicsFrame> recycler;
+	RngState rngBase;
+	bool rngBaseSet = false;
+	tasLog = TASLog();
+
+	char magic[BINARY_MAGIC_LENGTH];
+	if (!reader.ReadBytes(magic, sizeof(magic)))
+		return rapidjson::ParseResult(rapidjson::kParseErrorDocumentEmpty, reader.Tell());
+	if (std::memcmp(magic, BINARY_MAGIC, sizeof(magic)) != 0)
+		return rapidjson::ParseResult(rapidjson::kParseErrorValueInvalid, 0);
+
+	uint8_t version;
+	if (!reader.ReadByte(version) || version != BINARY_VERSION)
+		return rapidjson::ParseResult(rapidjson::kParseErrorValueInvalid, BINARY_MAGIC_LENGTH);
+
+	if (!reader.ReadString(tasLog.toolVersion)
+		|| !reader.ReadSignedVarint(tasLog.buildNumber)
+		|| !reader.ReadString(tasLog.gameMod))
+		return rapidjson::ParseResult(rapidjson::kParseErrorUnspecificSyntaxError, reader.Tell());
+
+	size_t physicsFrames = 0;
+	uint64_t validLength = reader.Tell();
+	const auto stop = [&](const rapidjson::ParseResult &result) -> rapidjson::ParseResult {
+		if (!recovery)
+			return result;
+		recovery->truncated = result.IsError();
+		recovery->stopReason = result;
+		recovery->physicsFrames = physicsFrames;
+		recovery->validLength = validLength;
+		tasLog.physicsFrameList.resize(physicsFrames);
+		return rapidjson::ParseResult();
+	};
+
+	for (;;) {
+		uint8_t tag;
+		if (!reader.ReadByte(tag))
+			return stop(rapidjson::ParseResult(rapidjson::kParseErrorUnspecificSyntaxError, reader.Tell()));
+
+		bool ok = true;
+		switch (tag) {
+		case TAG_END_LOG: {
+			// A log that was cut off by a crash can end in zeros, so the end
+			// tag only counts at the end of the file.
+			uint8_t trailing;
+			if (reader.ReadByte(trailing))
+				return stop(rapidjson::ParseResult(rapidjson::kParseErrorDocumentRootNotSingular, reader.Tell() - 1));
+			return stop(rapidjson::ParseResult());
+		}
+		case TAG_PHYSICS_FRAME: {
+			if (callback) {
+				recycler.Reset(streamedFrame);
+				physicsFrame = &streamedFrame;
+			} else {
+				tasLog.physicsFrameList.push_back(ReaderPhysicsFrame());
+				physicsFrame = &tasLog.physicsFrameList.back();
+			}
+			uint32_t bits = 0;
+			physicsFrame->clientState = 5;
+			ok = reader.ReadVarint(bits)
+				&& reader.ReadFloat(physicsFrame->frameTime)
+				&& (!(bits & PF_CLIENT_STATE) || reader.ReadSignedVarint(physicsFrame->clientState))
+				&& reader.ReadString(physicsFrame->commandBuffer);
+			physicsFrame->paused = (bits & PF_PAUSED) != 0;
+			break;
+		}
+		case TAG_COMMAND_FRAME:
+			ok = physicsFrame != nullptr
+				&& ReadCommandFrame(reader, recycler.AddCommandFrame(*physicsFrame));
+			break;
+		case TAG_PHYSICS_FRAME_END:
+			ok = physicsFrame != nullptr
+				&& ReadPhysicsFrameEnd(reader, recycler, *physicsFrame, rngBase, rngBaseSet);
+			if (ok && callback && !callback(*physicsFrame))
+				return rapidjson::ParseResult(rapidjson::kParseErrorTermination, reader.Tell());
+			if (ok) {
+				++physicsFrames;
+				validLength = reader.Tell();
+			}
+			physicsFrame = nullptr;
+			break;
+		default:
+			ok = false;
+			break;
+		}
+
+		if (!ok)
+			return stop(rapidjson::ParseResult(rapidjson::kParseErrorUnspecificSyntaxError, reader.Tell()));
+	}
+}
+
+rapidjson::ParseResult TASLogger::ParseBinaryFile(FILE *file, TASLog &tasLog)
+{
+	return ParseBinary(file, tasLog, PhysicsFrameCallback(), nullptr);
+}
+
+rapidjson::ParseResult TASLogger::ParseBinaryFile(FILE *file, TASLog &header, const PhysicsFrameCallback &callback)
+{
+	return ParseBinary(file, header, callback, nullptr);
+}
+
+rapidjson::ParseResult TASLogger::ParseBinaryFileTolerant(FILE *file, TASLog &tasLog, RecoveryInfo &recovery)
+{
+	return ParseBinary(file, tasLog, PhysicsFrameCallback(), &recovery);
+}
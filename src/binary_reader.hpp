@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdio>
+#include "taslogger/reader.hpp"
+
+namespace TASLogger
+{
+	// The binary log part of ParseFileTolerant.
+	rapidjson::ParseResult ParseBinaryFileTolerant(FILE *file, TASLog &tasLog, RecoveryInfo &recovery);
+}
@@ -0,0 +1,454 @@
+#include <cstring>
+#include "taslogger/binary_writer.hpp"
+#include "command_frame.hpp"
+#include "rng.hpp"
+
+using namespace TASLogger;
+
+static const size_t BUFFER_SIZE = 65536;
+
+BinaryLogWriter::BinaryLogWriter()
+{
+	buffer.reserve(BUFFER_SIZE);
+}
+
+BinaryLogWriter::~BinaryLogWriter()
+{
+	Flush();
+}
+
+void BinaryLogWriter::Clear()
+{
+	Flush();
+	file = nullptr;
+	consolePrintQueue.clear();
+	damageQueue.clear();
+	objectMoveQueue.clear();
+	collisionQueue.clear();
+	rngSet = false;
+	previousRngSet = false;
+}
+
+void BinaryLogWriter::Flush()
+{
+	if (file && !buffer.empty())
+		std::fwrite(buffer.data(), 1, buffer.size(), file);
+	buffer.clear();
+}
+
+void BinaryLogWriter::WriteByte(uint8_t value)
+{
+	buffer.push_back(static_cast<char>(value));
+}
+
+void BinaryLogWriter::WriteVarint(uint64_t value)
+{
+	while (value >= 0x80) {
+		WriteByte(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	WriteByte(static_cast<uint8_t>(value));
+}
+
+void BinaryLogWriter::WriteSignedVarint(int64_t value)
+{
+	WriteVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void BinaryLogWriter::WriteFloat(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	WriteByte(static_cast<uint8_t>(bits));
+	WriteByte(static_cast<uint8_t>(bits >> 8));
+	WriteByte(static_cast<uint8_t>(bits >> 16));
+	WriteByte(static_cast<uint8_t>(bits >> 24));
+}
+
+void BinaryLogWriter::WriteFloats(const float values[3])
+{
+	WriteFloat(values[0]);
+	WriteFloat(values[1]);
+	WriteFloat(values[2]);
+}
+
+void BinaryLogWriter::WriteString(const char *str, size_t length)
+{
+	WriteVarint(length);
+	buffer.insert(buffer.end(), str, str + length);
+}
+
+void BinaryLogWriter::StartLog(FILE *file, const char *toolVer, int32_t buildNumber, const char *mod)
+{
+	Clear();
+	this->file = file;
+
+	buffer.insert(buffer.end(), BINARY_MAGIC, BINARY_MAGIC + BINARY_MAGIC_LENGTH);
+	WriteByte(BINARY_VERSION);
+	WriteString(toolVer, std::strlen(toolVer));
+	WriteSignedVarint(buildNumber);
+	WriteString(mod, std::strlen(mod));
+}
+
+void BinaryLogWriter::EndLog()
+{
+	WriteByte(TAG_END_LOG);
+	Flush();
+}
+
+void BinaryLogWriter::StartPhysicsFrame(double frameTime, int32_t clstate, bool paused, const char *cbuf)
+{
+	uint32_t bits = 0;
+	if (clstate != 5)
+		bits |= PF_CLIENT_STATE;
+	if (paused)
+		bits |= PF_PAUSED;
+
+	WriteByte(TAG_PHYSICS_FRAME);
+	WriteVarint(bits);
+	WriteFloat(static_cast<float>(frameTime));
+	if (bits & PF_CLIENT_STATE)
+		WriteSignedVarint(clstate);
+	WriteString(cbuf, std::strlen(cbuf));
+}
+
+void BinaryLogWriter::EndPhysicsFrame()
+{
+	uint32_t bits = 0;
+	if (!consolePrintQueue.empty())
+		bits |= PF_CONSOLE_MESSAGES;
+	if (!damageQueue.empty())
+		bits |= PF_DAMAGES;
+	if (!objectMoveQueue.empty())
+		bits |= PF_OBJECT_MOVES;
+	uint32_t rngSteps = 0;
+	if (rngSet)
+		bits |= previousRngSet && FindRngSteps(previousRng, rng, rngSteps) ? PF_RNG_STEPS : PF_RNG;
+
+	WriteByte(TAG_PHYSICS_FRAME_END);
+	WriteVarint(bits);
+
+	if (bits & PF_CONSOLE_MESSAGES) {
+		WriteVarint(consolePrintQueue.size());
+		for (const std::string &message : consolePrintQueue)
+			WriteString(message.data(), message.size());
+		consolePrintQueue.clear();
+	}
+
+	if (bits & PF_DAMAGES) {
+		WriteVarint(damageQueue.size());
+		for (const Damage &damage : damageQueue) {
+			const bool hasDirection = damage.direction[0] != 0.0
+				|| damage.direction[1] != 0.0
+				|| damage.direction[2] != 0.0;
+			WriteByte(hasDirection ? ITEM_DAMAGE_DIRECTION : 0);
+			WriteFloat(static_cast<float>(damage.damage));
+			WriteSignedVarint(damage.damageBits);
+			if (hasDirection) {
+				WriteFloat(static_cast<float>(damage.direction[0]));
+				WriteFloat(static_cast<float>(damage.direction[1]));
+				WriteFloat(static_cast<float>(damage.direction[2]));
+			}
+		}
+		damageQueue.clear();
+	}
+
+	if (bits & PF_OBJECT_MOVES) {
+		WriteVarint(objectMoveQueue.size());
+		for (const ObjectMove &objectMove : objectMoveQueue) {
+			WriteByte(objectMove.pull ? ITEM_OBJECT_PULL : 0);
+			for (int i = 0; i < 3; ++i)
+				WriteFloat(static_cast<float>(objectMove.velocity[i]));
+			for (int i = 0; i < 3; ++i)
+				WriteFloat(static_cast<float>(objectMove.position[i]));
+		}
+		objectMoveQueue.clear();
+	}
+
+	if (bits & PF_RNG) {
+		WriteSignedVarint(rng.idum);
+		WriteSignedVarint(rng.iy);
+		for (int32_t iv : rng.iv)
+			WriteSignedVarint(iv);
+	} else if (bits & PF_RNG_STEPS) {
+		WriteVarint(rngSteps);
+	}
+	if (rngSet) {
+		previousRng = rng;
+		previousRngSet = true;
+		rngSet = false;
+	}
+
+	if (buffer.size() >= BUFFER_SIZE)
+		Flush();
+}
+
+void BinaryLogWriter::PushConsolePrint(const char *message)
+{
+	consolePrintQueue.push_back(message);
+}
+
+void BinaryLogWriter::SetRng(const RngState &rng)
+{
+	this->rng = rng;
+	rngSet = true;
+}
+
+void BinaryLogWriter::PushDamage(const Damage &damage)
+{
+	damageQueue.push_back(damage);
+}
+
+void BinaryLogWriter::PushObjectMove(const ObjectMove &objectMove)
+{
+	objectMoveQueue.push_back(objectMove);
+}
+
+void BinaryLogWriter::StartCmdFrame(uint32_t framebulkId, uint32_t msec, double remainder)
+{
+	commandFrameBits = 0;
+	this->framebulkId = framebulkId;
+	this->msec = msec;
+	this->remainder = static_cast<float>(remainder);
+}
+
+void BinaryLogWriter::EndCmdFrame()
+{
+	if (!collisionQueue.empty())
+		commandFrameBits |= CF_COLLISIONS;
+
+	WriteByte(TAG_COMMAND_FRAME);
+	WriteVarint(commandFrameBits);
+	WriteVarint(msec);
+	WriteFloat(remainder);
+	WriteVarint(framebulkId);
+
+	if (commandFrameBits & CF_SHARED_SEED)
+		WriteVarint(sharedSeed);
+	if (commandFrameBits & CF_VIEWANGLES)
+		WriteFloats(viewangles);
+	if (commandFrameBits & CF_PUNCHANGLES)
+		WriteFloats(punchangles);
+	if (commandFrameBits & CF_BUTTONS)
+		WriteVarint(buttons);
+	if (commandFrameBits & CF_IMPULSE)
+		WriteVarint(impulse);
+	if (commandFrameBits & CF_FSU)
+		WriteFloats(FSU);
+	if (commandFrameBits & CF_ENT_FRICTION)
+		WriteFloat(entFriction);
+	if (commandFrameBits & CF_ENT_GRAVITY)
+		WriteFloat(entGravity);
+	if (commandFrameBits & CF_HEALTH)
+		WriteFloat(health);
+	if (commandFrameBits & CF_ARMOR)
+		WriteFloat(armor);
+	if (commandFrameBits & CF_PRE_PLAYERMOVE)
+		WritePlayerState(prePlayer);
+	if (commandFrameBits & CF_POST_PLAYERMOVE)
+		WritePlayerState(postPlayer);
+
+	if (commandFrameBits & CF_COLLISIONS) {
+		WriteVarint(collisionQueue.size());
+		for (const Collision &collision : collisionQueue) {
+			WriteSignedVarint(collision.entity);
+			for (int i = 0; i < 3; ++i)
+				WriteFloat(static_cast<float>(collision.normal[i]));
+			WriteFloat(static_cast<float>(collision.distance));
+			for (int i = 0; i < 3; ++i)
+				WriteFloat(static_cast<float>(collision.impactVelocity[i]));
+		}
+		collisionQueue.clear();
+	}
+}
+
+void BinaryLogWriter::WritePlayerState(const PlayerState &playerState)
+{
+	WriteVarint(playerState.bits);
+	if (playerState.bits & PS_POSITION)
+		WriteFloats(playerState.position);
+	if (playerState.bits & PS_VELOCITY)
+		WriteFloats(playerState.velocity);
+	if (playerState.bits & PS_BASEVELOCITY)
+		WriteFloats(playerState.baseVelocity);
+	if (playerState.bits & PS_WATERLEVEL)
+		WriteVarint(playerState.waterLevel);
+	if (playerState.bits & PS_DUCK_STATE)
+		WriteVarint(playerState.duckState);
+}
+
+void BinaryLogWriter::SetSharedSeed(uint32_t seed)
+{
+	commandFrameBits |= CF_SHARED_SEED;
+	sharedSeed = seed;
+}
+
+void BinaryLogWriter::SetViewangles(double yaw, double pitch, double roll)
+{
+	commandFrameBits |= CF_VIEWANGLES;
+	viewangles[0] = static_cast<float>(yaw);
+	viewangles[1] = static_cast<float>(pitch);
+	viewangles[2] = static_cast<float>(roll);
+}
+
+void BinaryLogWriter::SetPunchangles(double yaw, double pitch, double roll)
+{
+	if (yaw == 0.0 && pitch == 0.0 && roll == 0.0)
+		return;
+	commandFrameBits |= CF_PUNCHANGLES;
+	punchangles[0] = static_cast<float>(yaw);
+	punchangles[1] = static_cast<float>(pitch);
+	punchangles[2] = static_cast<float>(roll);
+}
+
+void BinaryLogWriter::SetButtons(uint32_t buttons)
+{
+	commandFrameBits |= CF_BUTTONS;
+	this->buttons = buttons;
+}
+
+void BinaryLogWriter::SetImpulse(uint32_t impulse)
+{
+	if (impulse == 0)
+		return;
+	commandFrameBits |= CF_IMPULSE;
+	this->impulse = impulse;
+}
+
+void BinaryLogWriter::SetFSU(double F, double S, double U)
+{
+	commandFrameBits |= CF_FSU;
+	FSU[0] = static_cast<float>(F);
+	FSU[1] = static_cast<float>(S);
+	FSU[2] = static_cast<float>(U);
+}
+
+void BinaryLogWriter::SetEntFriction(double friction)
+{
+	if (friction == 1.0)
+		return;
+	commandFrameBits |= CF_ENT_FRICTION;
+	entFriction = static_cast<float>(friction);
+}
+
+void BinaryLogWriter::SetEntGravity(double gravity)
+{
+	if (gravity == 1.0)
+		return;
+	commandFrameBits |= CF_ENT_GRAVITY;
+	entGravity = static_cast<float>(gravity);
+}
+
+void BinaryLogWriter::SetHealth(double health)
+{
+	commandFrameBits |= CF_HEALTH;
+	this->health = static_cast<float>(health);
+}
+
+void BinaryLogWriter::SetArmor(double armor)
+{
+	commandFrameBits |= CF_ARMOR;
+	this->armor = static_cast<float>(armor);
+}
+
+void BinaryLogWriter::PushCollision(const Collision &collision)
+{
+	collisionQueue.push_back(collision);
+}
+
+void BinaryLogWriter::SetCollisions(const Collision *collisions, size_t count)
+{
+	collisionQueue.assign(collisions, collisions + count);
+}
+
+void BinaryLogWriter::SetCollisions(const std::deque<Collision> &collisions)
+{
+	collisionQueue = collisions;
+}
+
+void BinaryLogWriter::StartPrePlayer()
+{
+	commandFrameBits |= CF_PRE_PLAYERMOVE;
+	currentPlayer = &prePlayer;
+	currentPlayer->bits = 0;
+}
+
+void BinaryLogWriter::EndPrePlayer()
+{
+	currentPlayer = nullptr;
+}
+
+void BinaryLogWriter::StartPostPlayer()
+{
+	commandFrameBits |= CF_POST_PLAYERMOVE;
+	currentPlayer = &postPlayer;
+	currentPlayer->bits = 0;
+}
+
+void BinaryLogWriter::EndPostPlayer()
+{
+	currentPlayer = nullptr;
+}
+
+void BinaryLogWriter::SetPosition(const float position[3])
+{
+	currentPlayer->bits |= PS_POSITION;
+	std::memcpy(currentPlayer->position, position, sizeof(currentPlayer->position));
+}
+
+void BinaryLogWriter::SetVelocity(const float velocity[3])
+{
+	currentPlayer->bits |= PS_VELOCITY;
+	std::memcpy(currentPlayer->velocity, velocity, sizeof(currentPlayer->velocity));
+}
+
+void BinaryLogWriter::SetBaseVelocity(const float baseVelocity[3])
+{
+	if (baseVelocity[0] == 0.0 && baseVelocity[1] == 0.0 && baseVelocity[2] == 0.0)
+		return;
+	currentPlayer->bits |= PS_BASEVELOCITY;
+	std::memcpy(currentPlayer->baseVelocity, baseVelocity, sizeof(currentPlayer->baseVelocity));
+}
+
+void BinaryLogWriter::SetOnGround(bool onGround)
+{
+	if (onGround)
+		currentPlayer->bits |= PS_ONGROUND;
+	else
+		currentPlayer->bits &= ~PS_ONGROUND;
+}
+
+void BinaryLogWriter::SetOnLadder(bool onLadder)
+{
+	if (onLadder)
+		currentPlayer->bits |= PS_ONLADDER;
+	else
+		currentPlayer->bits &= ~PS_ONLADDER;
+}
+
+void BinaryLogWriter::SetWaterLevel(uint32_t waterLevel)
+{
+	if (waterLevel == 0)
+		return;
+	currentPlayer->bits |= PS_WATERLEVEL;
+	currentPlayer->waterLevel = waterLevel;
+}
+
+void BinaryLogWriter::SetDuckState(DuckState duckState)
+{
+	if (duckState == UNDUCKED)
+		return;
+	currentPlayer->bits |= PS_DUCK_STATE;
+	currentPlayer->duckState = duckState;
+}
+
+void BinaryLogWriter::WriteCommandFrame(const CommandFrameRecord &frame)
+{
+	WriteCommandFrameCalls(*this, frame);
+}
+
+void BinaryLogWriter::WriteCommandFrames(const CommandFrameRecord *frames, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		WriteCommandFrame(frames[i]);
+}
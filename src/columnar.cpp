@@ -0,0 +1,105 @@
+#include "taslogger/columnar.hpp"
+
+using namespace TASLogger;
+
+static inline void PushVec3(Vec3Column &column, const float vec[3])
+{
+	column.x.push_back(vec[0]);
+	column.y.push_back(vec[1]);
+	column.z.push_back(vec[2]);
+}
+
+static void PushPlayerState(PlayerStateColumns &columns, const ReaderPlayerState &playerState)
+{
+	PushVec3(columns.position, playerState.position);
+	PushVec3(columns.velocity, playerState.velocity);
+	PushVec3(columns.baseVelocity, playerState.baseVelocity);
+	columns.onGround.push_back(playerState.onGround);
+	columns.onLadder.push_back(playerState.onLadder);
+	columns.waterLevel.push_back(playerState.waterLevel);
+	columns.duckState.push_back(playerState.duckState);
+}
+
+ColumnarTASLog::ColumnarTASLog()
+	: buildNumber(0)
+{
+	consolePrintOffsets.push_back(0);
+	damageOffsets.push_back(0);
+	objectMoveOffsets.push_back(0);
+	commandFrameOffsets.push_back(0);
+	collisionOffsets.push_back(0);
+}
+
+void ColumnarTASLog::Clear()
+{
+	*this = ColumnarTASLog();
+}
+
+void ColumnarTASLog::Append(const ReaderPhysicsFrame &physicsFrame)
+{
+	frameTime.push_back(physicsFrame.frameTime);
+	paused.push_back(physicsFrame.paused);
+	clientState.push_back(physicsFrame.clientState);
+	commandBuffer.push_back(physicsFrame.commandBuffer);
+	rng.push_back(physicsFrame.rng);
+
+	consolePrints.insert(consolePrints.end(), physicsFrame.consolePrintList.begin(), physicsFrame.consolePrintList.end());
+	consolePrintOffsets.push_back(static_cast<uint32_t>(consolePrints.size()));
+
+	for (const ReaderDamage &damage : physicsFrame.damageList) {
+		damageAmount.push_back(damage.damage);
+		PushVec3(damageDirection, damage.direction);
+		damageBits.push_back(damage.damageBits);
+	}
+	damageOffsets.push_back(static_cast<uint32_t>(damageAmount.size()));
+
+	for (const ReaderObjectMove &objectMove : physicsFrame.objectMoveList) {
+		PushVec3(objectVelocity, objectMove.velocity);
+		PushVec3(objectPosition, objectMove.position);
+		objectPull.push_back(objectMove.pull);
+	}
+	objectMoveOffsets.push_back(static_cast<uint32_t>(objectPull.size()));
+
+	for (const ReaderCommandFrame &commandFrame : physicsFrame.commandFrameList) {
+		msec.push_back(commandFrame.msec);
+		buttons.push_back(commandFrame.buttons);
+		impulse.push_back(commandFrame.impulse);
+		framebulkId.push_back(commandFrame.framebulkId);
+		sharedSeed.push_back(commandFrame.sharedSeed);
+		frameTimeRemainder.push_back(commandFrame.frameTimeRemainder);
+		PushVec3(viewangles, commandFrame.viewangles);
+		PushVec3(punchangles, commandFrame.punchangles);
+		PushVec3(FSU, commandFrame.FSU);
+		entFriction.push_back(commandFrame.entFriction);
+		entGravity.push_back(commandFrame.entGravity);
+		health.push_back(commandFrame.health);
+		armor.push_back(commandFrame.armor);
+		PushPlayerState(prePMState, commandFrame.prePMState);
+		PushPlayerState(postPMState, commandFrame.postPMState);
+
+		for (const ReaderCollision &collision : commandFrame.collisionList) {
+			PushVec3(collisionNormal, collision.normal);
+			collisionDistance.push_back(collision.distance);
+			PushVec3(collisionImpactVelocity, collision.impactVelocity);
+			collisionEntity.push_back(collision.entity);
+		}
+		collisionOffsets.push_back(static_cast<uint32_t>(collisionEntity.size()));
+	}
+	commandFrameOffsets.push_back(static_cast<uint32_t>(msec.size()));
+}
+
+rapidjson::ParseResult TASLogger::ParseFileColumnar(FILE *file, ColumnarTASLog &tasLog)
+{
+	tasLog.Clear();
+
+	TASLog header;
+	const rapidjson::ParseResult res = ParseFile(file, header, [&tasLog](const ReaderPhysicsFrame &physicsFrame) {
+		tasLog.Append(physicsFrame);
+		return true;
+	});
+
+	tasLog.toolVersion.swap(header.toolVersion);
+	tasLog.gameMod.swap(header.gameMod);
+	tasLog.buildNumber = header.buildNumber;
+	return res;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "taslogger/common.hpp"
+
+namespace TASLogger
+{
+	template<typename Writer>
+	void WritePlayerStateCalls(Writer &writer, const PlayerStateRecord &playerState)
+	{
+		writer.SetPosition(playerState.position);
+		writer.SetVelocity(playerState.velocity);
+		writer.SetBaseVelocity(playerState.baseVelocity);
+		writer.SetOnGround(playerState.onGround);
+		writer.SetOnLadder(playerState.onLadder);
+		writer.SetWaterLevel(playerState.waterLevel);
+		writer.SetDuckState(playerState.duckState);
+	}
+
+	// Writes the command frame with the individual calls that
+	// WriteCommandFrame stands for.
+	template<typename Writer>
+	void WriteCommandFrameCalls(Writer &writer, const CommandFrameRecord &frame)
+	{
+		writer.StartCmdFrame(frame.framebulkId, frame.msec, frame.frameTimeRemainder);
+		writer.SetSharedSeed(frame.sharedSeed);
+		writer.SetViewangles(frame.viewangles[0], frame.viewangles[1], frame.viewangles[2]);
+		writer.SetPunchangles(frame.punchangles[0], frame.punchangles[1], frame.punchangles[2]);
+		writer.SetButtons(frame.buttons);
+		writer.SetImpulse(frame.impulse);
+		writer.SetFSU(frame.FSU[0], frame.FSU[1], frame.FSU[2]);
+		writer.SetEntFriction(frame.entFriction);
+		writer.SetEntGravity(frame.entGravity);
+		writer.SetHealth(frame.health);
+		writer.SetArmor(frame.armor);
+
+		writer.StartPrePlayer();
+		WritePlayerStateCalls(writer, frame.prePMState);
+		writer.EndPrePlayer();
+
+		writer.StartPostPlayer();
+		WritePlayerStateCalls(writer, frame.postPMState);
+		writer.EndPostPlayer();
+
+		writer.SetCollisions(frame.collisions, frame.collisionCount);
+		writer.EndCmdFrame();
+	}
+}
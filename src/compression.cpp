@@ -0,0 +1,138 @@
+#include <vector>
+#include "compression.hpp"
+
+#ifdef TASLOGGER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace TASLogger;
+
+#ifdef TASLOGGER_HAVE_ZSTD
+class ZstdCompressor : public Compressor
+{
+public:
+	ZstdCompressor(OutputSink &sink, int level)
+		: sink(sink), context(ZSTD_createCCtx()), out(ZSTD_CStreamOutSize())
+	{
+		ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, level);
+		ZSTD_CCtx_setParameter(context, ZSTD_c_checksumFlag, 1);
+	}
+
+	~ZstdCompressor()
+	{
+		ZSTD_freeCCtx(context);
+	}
+
+	bool Write(const char *data, size_t size) override
+	{
+		return Compress(data, size, ZSTD_e_continue);
+	}
+
+	bool Flush() override
+	{
+		return Compress(nullptr, 0, ZSTD_e_flush) && sink.Flush();
+	}
+
+	bool Finish() override
+	{
+		return Compress(nullptr, 0, ZSTD_e_end);
+	}
+
+private:
+	bool Compress(const char *data, size_t size, ZSTD_EndDirective mode)
+	{
+		ZSTD_inBuffer input = {data, size, 0};
+		for (;;) {
+			ZSTD_outBuffer output = {out.data(), out.size(), 0};
+			const size_t remaining = ZSTD_compressStream2(context, &output, &input, mode);
+			if (ZSTD_isError(remaining))
+				return false;
+			if (output.pos != 0 && !sink.Write(out.data(), output.pos))
+				return false;
+			if (mode == ZSTD_e_continue ? input.pos == input.size : remaining == 0)
+				return true;
+		}
+	}
+
+	OutputSink &sink;
+	ZSTD_CCtx *context;
+	std::vector<char> out;
+};
+
+class ZstdDecompressor : public Decompressor
+{
+public:
+	explicit ZstdDecompressor(FILE *file)
+		: file(file), context(ZSTD_createDCtx()), in(ZSTD_DStreamInSize())
+	{
+		input.src = in.data();
+		input.size = 0;
+		input.pos = 0;
+	}
+
+	~ZstdDecompressor()
+	{
+		ZSTD_freeDCtx(context);
+	}
+
+	size_t Read(char *dest, size_t size) override
+	{
+		ZSTD_outBuffer output = {dest, size, 0};
+		for (;;) {
+			// Output may still be pending after all of the input was consumed.
+			if (ZSTD_isError(ZSTD_decompressStream(context, &output, &input)))
+				return 0;
+			if (output.pos != 0)
+				return output.pos;
+			if (input.pos == input.size) {
+				input.size = std::fread(in.data(), 1, in.size(), file);
+				input.pos = 0;
+				if (input.size == 0)
+					return 0;
+			}
+		}
+	}
+
+private:
+	FILE *file;
+	ZSTD_DCtx *context;
+	std::vector<char> in;
+	ZSTD_inBuffer input;
+};
+#endif
+
+Compressor *Compressor::Create(OutputSink &sink, Compression compression, int level)
+{
+#ifdef TASLOGGER_HAVE_ZSTD
+	if (compression == COMPRESSION_ZSTD)
+		return new ZstdCompressor(sink, level);
+#else
+	(void)sink;
+	(void)compression;
+	(void)level;
+#endif
+	return nullptr;
+}
+
+Decompressor *Decompressor::Create(FILE *file, Compression compression)
+{
+#ifdef TASLOGGER_HAVE_ZSTD
+	if (compression == COMPRESSION_ZSTD)
+		return new ZstdDecompressor(file);
+#else
+	(void)file;
+	(void)compression;
+#endif
+	return nullptr;
+}
+
+bool TASLogger::IsCompressionSupported(Compression compression)
+{
+	if (compression == COMPRESSION_NONE)
+		return true;
+#ifdef TASLOGGER_HAVE_ZSTD
+	if (compression == COMPRESSION_ZSTD)
+		return true;
+#endif
+	return false;
+}
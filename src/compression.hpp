@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include "taslogger/output_stream.hpp"
+
+namespace TASLogger
+{
+	// Compressed logs are detected by the first byte of the zstd frame magic,
+	// which can start neither a JSON nor a binary log.
+	const unsigned char ZSTD_MAGIC_BYTE = 0x28;
+
+	class Compressor
+	{
+	public:
+		virtual ~Compressor() {}
+
+		// Compress data and pass the result to the sink.
+		virtual bool Write(const char *data, size_t size) = 0;
+		// Pass everything written so far to the sink in a form that can be
+		// decompressed without what follows, then flush the sink.
+		virtual bool Flush() = 0;
+		// End the compressed data.
+		virtual bool Finish() = 0;
+
+		// Returns nullptr if the compression is not supported.
+		static Compressor *Create(OutputSink &sink, Compression compression, int level);
+	};
+
+	class Decompressor
+	{
+	public:
+		virtual ~Decompressor() {}
+
+		// Returns 0 at the end of the data or on an error.
+		virtual size_t Read(char *dest, size_t size) = 0;
+
+		// Returns nullptr if the compression is not supported.
+		static Decompressor *Create(FILE *file, Compression compression);
+	};
+
+	// A RapidJSON input stream over a Decompressor, modeled on FileReadStream.
+	class DecompressingReadStream
+	{
+	public:
+		typedef char Ch;
+
+		explicit DecompressingReadStream(Decompressor &decompressor)
+			: decompressor(decompressor), current(buffer), last(buffer), readCount(0), count(0), eof(false)
+		{
+			Fill();
+		}
+
+		Ch Peek() const { return *current; }
+		Ch Take() { const Ch c = *current; Read(); return c; }
+		size_t Tell() const { return count + static_cast<size_t>(current - buffer); }
+
+		// Not an output stream.
+		void Put(Ch) { RAPIDJSON_ASSERT(false); }
+		void Flush() { RAPIDJSON_ASSERT(false); }
+		Ch *PutBegin() { RAPIDJSON_ASSERT(false); return 0; }
+		size_t PutEnd(Ch *) { RAPIDJSON_ASSERT(false); return 0; }
+
+	private:
+		void Read()
+		{
+			if (current < last)
+				++current;
+			else if (!eof)
+				Fill();
+		}
+
+		void Fill()
+		{
+			count += readCount;
+			readCount = decompressor.Read(buffer, sizeof(buffer));
+			current = buffer;
+			if (readCount != 0) {
+				last = buffer + readCount - 1;
+			} else {
+				buffer[0] = '\0';
+				last = buffer;
+				eof = true;
+			}
+		}
+
+		Decompressor &decompressor;
+		Ch buffer[65536];
+		Ch *current;
+		Ch *last;
+		size_t readCount;
+		size_t count;
+		bool eof;
+	};
+}
@@ -0,0 +1,293 @@
+#include <cstdint>
+#include <cstring>
+#include "fast_scan.hpp"
+#include "float_parse.hpp"
+
+#if !defined(TASLOGGER_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define TASLOGGER_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(_MSC_VER)
+#define TASLOGGER_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TASLOGGER_TARGET_AVX2
+#else
+#define TASLOGGER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+#endif
+
+using namespace TASLogger;
+
+// The structural characters of an array are looked for in this many bytes.
+const size_t SCAN_WINDOW = 64;
+// The colon and the bracket before the window, and a character after it.
+const size_t TRIPLE_WINDOW = 2 + SCAN_WINDOW + 1;
+
+const size_t BUFFER_SIZE = 65536;
+
+// What the stream presents in place of an array that it read.
+static const char REPLACEMENT[] = ":0";
+
+static inline bool IsNumberChar(char c)
+{
+	return (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '+' || c == 'e' || c == 'E';
+}
+
+// Returns a mask of the bytes of p[0, SCAN_WINDOW) that cannot be part of a
+// number.
+#ifndef TASLOGGER_SSE2
+static uint64_t StopMaskScalar(const char *p)
+{
+	uint64_t mask = 0;
+	for (size_t i = 0; i < SCAN_WINDOW; ++i) {
+		if (!IsNumberChar(p[i]))
+			mask |= uint64_t(1) << i;
+	}
+	return mask;
+}
+#else
+static uint64_t StopMaskSSE2(const char *p)
+{
+	const __m128i belowDigits = _mm_set1_epi8('0' - 1);
+	const __m128i aboveDigits = _mm_set1_epi8('9' + 1);
+	const __m128i dot = _mm_set1_epi8('.');
+	const __m128i minus = _mm_set1_epi8('-');
+	const __m128i plus = _mm_set1_epi8('+');
+	const __m128i lowerCase = _mm_set1_epi8(0x20);
+	const __m128i e = _mm_set1_epi8('e');
+
+	uint64_t mask = 0;
+	for (size_t i = 0; i < SCAN_WINDOW; i += 16) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+		const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, belowDigits), _mm_cmplt_epi8(v, aboveDigits));
+		const __m128i sign = _mm_or_si128(_mm_cmpeq_epi8(v, minus), _mm_cmpeq_epi8(v, plus));
+		const __m128i exponent = _mm_cmpeq_epi8(_mm_or_si128(v, lowerCase), e);
+		const __m128i number = _mm_or_si128(_mm_or_si128(digit, _mm_cmpeq_epi8(v, dot)), _mm_or_si128(sign, exponent));
+		mask |= static_cast<uint64_t>(~_mm_movemask_epi8(number) & 0xFFFF) << i;
+	}
+	return mask;
+}
+#endif
+
+#ifdef TASLOGGER_AVX2
+TASLOGGER_TARGET_AVX2 static uint64_t StopMaskAVX2(const char *p)
+{
+	const __m256i belowDigits = _mm256_set1_epi8('0' - 1);
+	const __m256i aboveDigits = _mm256_set1_epi8('9' + 1);
+	const __m256i dot = _mm256_set1_epi8('.');
+	const __m256i minus = _mm256_set1_epi8('-');
+	const __m256i plus = _mm256_set1_epi8('+');
+	const __m256i lowerCase = _mm256_set1_epi8(0x20);
+	const __m256i e = _mm256_set1_epi8('e');
+
+	uint64_t mask = 0;
+	for (size_t i = 0; i < SCAN_WINDOW; i += 32) {
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+		const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, belowDigits), _mm256_cmpgt_epi8(aboveDigits, v));
+		const __m256i sign = _mm256_or_si256(_mm256_cmpeq_epi8(v, minus), _mm256_cmpeq_epi8(v, plus));
+		const __m256i exponent = _mm256_cmpeq_epi8(_mm256_or_si256(v, lowerCase), e);
+		const __m256i number = _mm256_or_si256(_mm256_or_si256(digit, _mm256_cmpeq_epi8(v, dot)), _mm256_or_si256(sign, exponent));
+		mask |= static_cast<uint64_t>(~static_cast<uint32_t>(_mm256_movemask_epi8(number))) << i;
+	}
+	return mask;
+}
+
+static bool HasAVX2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	// The OS has to save the AVX registers.
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (!osxsave || (_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+typedef uint64_t (*StopMaskFunction)(const char *p);
+
+static StopMaskFunction SelectStopMask()
+{
+#ifdef TASLOGGER_AVX2
+	if (HasAVX2())
+		return StopMaskAVX2;
+#endif
+#ifdef TASLOGGER_SSE2
+	return StopMaskSSE2;
+#else
+	return StopMaskScalar;
+#endif
+}
+
+static inline unsigned LowestBit(uint64_t mask)
+{
+#if defined(__GNUC__)
+	return static_cast<unsigned>(__builtin_ctzll(mask));
+#else
+	unsigned i = 0;
+	while (!(mask & 1)) {
+		mask >>= 1;
+		++i;
+	}
+	return i;
+#endif
+}
+
+const char *TASLogger::ScanTriple(const char *p, const char *end, float *values)
+{
+	static const StopMaskFunction stopMask = SelectStopMask();
+
+	if (end - p < 2 || p[0] != ':' || p[1] != '[')
+		return nullptr;
+	p += 2;
+
+	// Near the end of the input, the window is padded with stop characters.
+	char padded[SCAN_WINDOW];
+	const char *window = p;
+	const size_t available = static_cast<size_t>(end - p);
+	if (available < SCAN_WINDOW) {
+		std::memcpy(padded, p, available);
+		std::memset(padded + available, '\0', SCAN_WINDOW - available);
+		window = padded;
+	}
+
+	// The first three stops have to be the two commas and the bracket.
+	uint64_t stops = stopMask(window);
+	unsigned positions[3];
+	for (unsigned &position : positions) {
+		if (stops == 0)
+			return nullptr;
+		position = LowestBit(stops);
+		stops &= stops - 1;
+	}
+	if (positions[2] >= available || window[positions[0]] != ',' || window[positions[1]] != ',' || window[positions[2]] != ']')
+		return nullptr;
+
+	// Integers and invalid JSON are left to the generic parser, so that they
+	// fail the same way.
+	float parsed[3];
+	const char *number = p;
+	for (unsigned i = 0; i < 3; ++i) {
+		const size_t length = static_cast<size_t>(p + positions[i] - number);
+		if (IsIntegerNumber(number, length) || !ParseFloat(number, length, parsed[i]))
+			return nullptr;
+		number = p + positions[i] + 1;
+	}
+	const char *next = number;
+	if (next != end && IsNumberChar(*next))
+		return nullptr;
+
+	std::memcpy(values, parsed, sizeof(parsed));
+	return next;
+}
+
+ScanningReadStream::ScanningReadStream(const char *data, size_t size)
+	: file(nullptr),
+	decompressor(nullptr),
+	eof(true),
+	base(0),
+	data(data),
+	current(data),
+	end(data + size),
+	replacing(false),
+	resume(nullptr),
+	resumeEnd(nullptr)
+{
+}
+
+ScanningReadStream::ScanningReadStream(FILE *file)
+	: file(file),
+	decompressor(nullptr),
+	buffer(BUFFER_SIZE),
+	eof(false),
+	base(0),
+	data(buffer.data()),
+	current(data),
+	end(data),
+	replacing(false),
+	resume(nullptr),
+	resumeEnd(nullptr)
+{
+	Fill();
+}
+
+ScanningReadStream::ScanningReadStream(Decompressor &decompressor)
+	: file(nullptr),
+	decompressor(&decompressor),
+	buffer(BUFFER_SIZE),
+	eof(false),
+	base(0),
+	data(buffer.data()),
+	current(data),
+	end(data),
+	replacing(false),
+	resume(nullptr),
+	resumeEnd(nullptr)
+{
+	Fill();
+}
+
+size_t ScanningReadStream::Tell() const
+{
+	return base + static_cast<size_t>((replacing ? resume : current) - data);
+}
+
+bool ScanningReadStream::ReadTriple(float *values)
+{
+	if (replacing)
+		return false;
+	if (static_cast<size_t>(end - current) < TRIPLE_WINDOW)
+		Fill();
+
+	const char *next = ScanTriple(current, end, values);
+	if (!next)
+		return false;
+	replacing = true;
+	resume = next;
+	resumeEnd = end;
+	current = REPLACEMENT;
+	end = REPLACEMENT + 2;
+	return true;
+}
+
+void ScanningReadStream::Next()
+{
+	if (replacing) {
+		replacing = false;
+		current = resume;
+		end = resumeEnd;
+		if (current != end)
+			return;
+	}
+	Fill();
+}
+
+void ScanningReadStream::Fill()
+{
+	if (eof)
+		return;
+
+	char *dest = buffer.data();
+	const size_t kept = static_cast<size_t>(end - current);
+	std::memmove(dest, current, kept);
+	base += static_cast<size_t>(current - data);
+
+	const size_t size = buffer.size() - kept;
+	const size_t read = file ? std::fread(dest + kept, 1, size, file) : decompressor->Read(dest + kept, size);
+	eof = read == 0;
+
+	data = dest;
+	current = dest;
+	end = dest + kept + read;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+#include "rapidjson/reader.h"
+#include "compression.hpp"
+
+namespace TASLogger
+{
+	// Parses `:[a,b,c]` at p, the way the writer writes the arrays of three
+	// floats, into values and returns the position after the closing
+	// bracket. The structural characters are found with SSE2 or AVX2 if the
+	// CPU has them. Returns nullptr for anything that the generic parser has
+	// to handle, such as whitespace or integers.
+	const char *ScanTriple(const char *p, const char *end, float *values);
+
+	// A RapidJSON input stream over memory, a file or a Decompressor that can
+	// read the arrays of three floats with ScanTriple. An array that was read
+	// is replaced by a 0 for the RapidJSON reader.
+	class ScanningReadStream
+	{
+	public:
+		typedef char Ch;
+
+		ScanningReadStream(const char *data, size_t size);
+		explicit ScanningReadStream(FILE *file);
+		explicit ScanningReadStream(Decompressor &decompressor);
+
+		inline Ch Peek() const { return current == end ? '\0' : *current; }
+
+		inline Ch Take()
+		{
+			if (current == end)
+				return '\0';
+			const Ch c = *current++;
+			if (current == end)
+				Next();
+			return c;
+		}
+
+		size_t Tell() const;
+
+		// Reads the value after the key that was just parsed into values if
+		// it is an array of three floats.
+		bool ReadTriple(float *values);
+
+		Ch *PutBegin() { return nullptr; }
+		void Put(Ch) {}
+		void Flush() {}
+		size_t PutEnd(Ch *) { return 0; }
+
+	private:
+		ScanningReadStream(const ScanningReadStream &) = delete;
+		ScanningReadStream &operator=(const ScanningReadStream &) = delete;
+
+		void Next();
+		// Reads more data after what is left from current.
+		void Fill();
+
+		FILE *file;
+		Decompressor *decompressor;
+		std::vector<char> buffer;
+		bool eof;
+
+		// Offset of data in the input.
+		size_t base;
+		const char *data;
+		const char *current;
+		const char *end;
+
+		// While the replacement of an array is read, where to continue.
+		bool replacing;
+		const char *resume;
+		const char *resumeEnd;
+	};
+
+	// Forwards to the handler, but lets the stream read the arrays of three
+	// floats, and swallows the 0 that replaces them.
+	template<typename Handler>
+	class ScanningHandler
+	{
+	public:
+		ScanningHandler(Handler &handler, ScanningReadStream &stream)
+			: handler(handler), stream(stream), replaced(false)
+		{
+		}
+
+		bool Null() { return handler.Null(); }
+		bool Bool(bool b) { return handler.Bool(b); }
+		bool Int(int i) { return handler.Int(i); }
+		bool Int64(int64_t i) { return handler.Int64(i); }
+		bool Uint64(uint64_t i) { return handler.Uint64(i); }
+		bool Double(double d) { return handler.Double(d); }
+		bool String(const char *str, rapidjson::SizeType length, bool copy) { return handler.String(str, length, copy); }
+		bool StartObject() { return handler.StartObject(); }
+		bool EndObject(rapidjson::SizeType memberCount) { return handler.EndObject(memberCount); }
+		bool StartArray() { return handler.StartArray(); }
+		bool EndArray(rapidjson::SizeType elementCount) { return handler.EndArray(elementCount); }
+
+		bool Uint(unsigned i) { return Replaced() || handler.Uint(i); }
+		bool RawNumber(const char *str, rapidjson::SizeType length, bool copy) { return Replaced() || handler.RawNumber(str, length, copy); }
+
+		bool Key(const char *str, rapidjson::SizeType length, bool copy)
+		{
+			if (!handler.Key(str, length, copy))
+				return false;
+			float *values = handler.TripleDestination();
+			if (!values || !stream.ReadTriple(values))
+				return true;
+			replaced = true;
+			return handler.EndArray(3);
+		}
+
+	private:
+		inline bool Replaced()
+		{
+			if (!replaced)
+				return false;
+			replaced = false;
+			return true;
+		}
+
+		Handler &handler;
+		ScanningReadStream &stream;
+		bool replaced;
+	};
+}
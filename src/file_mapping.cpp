@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <cstdio>
+#include "file_mapping.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace TASLogger;
+
+FileMapping::FileMapping()
+	: data(nullptr), size(0), mappedSize(0), heapAllocated(false)
+{
+}
+
+FileMapping::~FileMapping()
+{
+	Close();
+}
+
+void FileMapping::Close()
+{
+	if (!data)
+		return;
+
+	if (heapAllocated)
+		delete[] data;
+	else {
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+#else
+		munmap(data, mappedSize);
+#endif
+	}
+
+	data = nullptr;
+	size = 0;
+	mappedSize = 0;
+	heapAllocated = false;
+}
+
+#ifdef _WIN32
+bool FileMapping::Open(const char *filename)
+{
+	Close();
+
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		return false;
+	}
+	size = static_cast<size_t>(fileSize.QuadPart);
+
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+
+	// The zero padding of the last page provides the terminator, unless the
+	// file ends exactly on a page boundary.
+	if (size % systemInfo.dwPageSize != 0) {
+		HANDLE fileMapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+		if (fileMapping) {
+			data = static_cast<char *>(MapViewOfFile(fileMapping, FILE_MAP_COPY, 0, 0, 0));
+			CloseHandle(fileMapping);
+			mappedSize = size;
+		}
+	}
+
+	if (!data) {
+		data = new char[size + 1];
+		heapAllocated = true;
+		DWORD bytesRead = 0;
+		size_t offset = 0;
+		while (offset < size && ReadFile(file, data + offset, static_cast<DWORD>(
+			std::min<size_t>(size - offset, 1 << 30)), &bytesRead, NULL) && bytesRead != 0)
+			offset += bytesRead;
+		data[offset] = '\0';
+		size = offset;
+	}
+
+	CloseHandle(file);
+	return true;
+}
+#else
+bool FileMapping::Open(const char *filename)
+{
+	Close();
+
+	const int fd = open(filename, O_RDONLY);
+	if (fd == -1)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		close(fd);
+		return false;
+	}
+	size = static_cast<size_t>(st.st_size);
+
+	// Reserve one more byte than the file, rounded up to whole pages, and map
+	// the file over the start of the reservation. Whatever follows the file
+	// contents is then zero-filled, even at an exact page boundary.
+	const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	mappedSize = (size + pageSize) / pageSize * pageSize;
+
+	void *reservation = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (reservation == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	if (size != 0 && mmap(reservation, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(reservation, mappedSize);
+		close(fd);
+		return false;
+	}
+	close(fd);
+
+	data = static_cast<char *>(reservation);
+	madvise(data, mappedSize, MADV_SEQUENTIAL);
+	return true;
+}
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+namespace TASLogger
+{
+	// A private, writable mapping of a whole file. Writes are never carried
+	// back to the file. The mapped contents are always followed by a zero
+	// byte, as required by RapidJSON's in situ parsing.
+	class FileMapping
+	{
+	public:
+		FileMapping();
+		~FileMapping();
+
+		bool Open(const char *filename);
+		void Close();
+
+		inline char *Data() const { return data; }
+		inline size_t Size() const { return size; }
+
+	private:
+		FileMapping(const FileMapping &) = delete;
+		FileMapping &operator=(const FileMapping &) = delete;
+
+		char *data;
+		size_t size;
+		size_t mappedSize;
+		bool heapAllocated;
+	};
+}
@@ -0,0 +1,310 @@
+#include <cstdint>
+#include <cstring>
+#include "float_format.hpp"
+
+using namespace TASLogger;
+
+// Shortest round-trip conversion from Ulf Adams, "Ryu: fast float-to-string
+// conversion" (PLDI 2018), specialized for 32-bit floats.
+namespace
+{
+	const int MANTISSA_BITS = 23;
+	const int EXPONENT_BITS = 8;
+	const int BIAS = 127;
+	const int POW5_INV_BITCOUNT = 59;
+	const int POW5_BITCOUNT = 61;
+
+	// POW5_INV_SPLIT[q] = floor(2^(pow5bits(q) - 1 + 59) / 5^q) + 1
+	// POW5_SPLIT[i] = floor(5^i / 2^(pow5bits(i) - 61))
+	static const uint64_t POW5_INV_SPLIT[31] = {
+		576460752303423489u, 461168601842738791u, 368934881474191033u,
+		295147905179352826u, 472236648286964522u, 377789318629571618u,
+		302231454903657294u, 483570327845851670u, 386856262276681336u,
+		309485009821345069u, 495176015714152110u, 396140812571321688u,
+		316912650057057351u, 507060240091291761u, 405648192073033409u,
+		324518553658426727u, 519229685853482763u, 415383748682786211u,
+		332306998946228969u, 531691198313966350u, 425352958651173080u,
+		340282366920938464u, 544451787073501542u, 435561429658801234u,
+		348449143727040987u, 557518629963265579u, 446014903970612463u,
+		356811923176489971u, 570899077082383953u, 456719261665907162u,
+		365375409332725730u
+	};
+
+	static const uint64_t POW5_SPLIT[48] = {
+		1152921504606846976u, 1441151880758558720u, 1801439850948198400u,
+		2251799813685248000u, 1407374883553280000u, 1759218604441600000u,
+		2199023255552000000u, 1374389534720000000u, 1717986918400000000u,
+		2147483648000000000u, 1342177280000000000u, 1677721600000000000u,
+		2097152000000000000u, 1310720000000000000u, 1638400000000000000u,
+		2048000000000000000u, 1280000000000000000u, 1600000000000000000u,
+		2000000000000000000u, 1250000000000000000u, 1562500000000000000u,
+		1953125000000000000u, 1220703125000000000u, 1525878906250000000u,
+		1907348632812500000u, 1192092895507812500u, 1490116119384765625u,
+		1862645149230957031u, 1164153218269348144u, 1455191522836685180u,
+		1818989403545856475u, 2273736754432320594u, 1421085471520200371u,
+		1776356839400250464u, 2220446049250313080u, 1387778780781445675u,
+		1734723475976807094u, 2168404344971008868u, 1355252715606880542u,
+		1694065894508600678u, 2117582368135750847u, 1323488980084844279u,
+		1654361225106055349u, 2067951531382569187u, 1292469707114105741u,
+		1615587133892632177u, 2019483917365790221u, 1262177448353618888u
+	};
+
+	// ceil(log2(5^e)) for e > 0, 1 for e = 0.
+	inline int32_t Pow5Bits(int32_t e)
+	{
+		return static_cast<int32_t>((static_cast<uint32_t>(e) * 1217359) >> 19) + 1;
+	}
+
+	// floor(log10(2^e))
+	inline uint32_t Log10Pow2(int32_t e)
+	{
+		return (static_cast<uint32_t>(e) * 78913) >> 18;
+	}
+
+	// floor(log10(5^e))
+	inline uint32_t Log10Pow5(int32_t e)
+	{
+		return (static_cast<uint32_t>(e) * 732923) >> 20;
+	}
+
+	inline uint32_t Pow5Factor(uint32_t value)
+	{
+		uint32_t count = 0;
+		while (value % 5 == 0) {
+			value /= 5;
+			++count;
+		}
+		return count;
+	}
+
+	inline bool MultipleOfPowerOf5(uint32_t value, uint32_t p)
+	{
+		return Pow5Factor(value) >= p;
+	}
+
+	inline bool MultipleOfPowerOf2(uint32_t value, uint32_t p)
+	{
+		return (value & ((1u << p) - 1)) == 0;
+	}
+
+	inline uint32_t MulShift(uint32_t m, uint64_t factor, int32_t shift)
+	{
+		const uint64_t low = static_cast<uint64_t>(m) * static_cast<uint32_t>(factor);
+		const uint64_t high = static_cast<uint64_t>(m) * static_cast<uint32_t>(factor >> 32);
+		return static_cast<uint32_t>(((low >> 32) + high) >> (shift - 32));
+	}
+
+	struct DecimalFloat
+	{
+		uint32_t mantissa;
+		int32_t exponent;
+	};
+
+	DecimalFloat ToDecimal(uint32_t ieeeMantissa, uint32_t ieeeExponent)
+	{
+		int32_t e2;
+		uint32_t m2;
+		if (ieeeExponent == 0) {
+			e2 = 1 - BIAS - MANTISSA_BITS - 2;
+			m2 = ieeeMantissa;
+		} else {
+			e2 = static_cast<int32_t>(ieeeExponent) - BIAS - MANTISSA_BITS - 2;
+			m2 = (1u << MANTISSA_BITS) | ieeeMantissa;
+		}
+		const bool acceptBounds = (m2 & 1) == 0;
+
+		// The value and the halfway points to its neighbours, times four.
+		const uint32_t mv = 4 * m2;
+		const uint32_t mp = 4 * m2 + 2;
+		const uint32_t mmShift = ieeeMantissa != 0 || ieeeExponent <= 1;
+		const uint32_t mm = 4 * m2 - 1 - mmShift;
+
+		uint32_t vr, vp, vm;
+		int32_t e10;
+		bool vmIsTrailingZeros = false;
+		bool vrIsTrailingZeros = false;
+		uint8_t lastRemovedDigit = 0;
+
+		if (e2 >= 0) {
+			const uint32_t q = Log10Pow2(e2);
+			e10 = static_cast<int32_t>(q);
+			const int32_t k = POW5_INV_BITCOUNT + Pow5Bits(q) - 1;
+			const int32_t i = -e2 + static_cast<int32_t>(q) + k;
+			vr = MulShift(mv, POW5_INV_SPLIT[q], i);
+			vp = MulShift(mp, POW5_INV_SPLIT[q], i);
+			vm = MulShift(mm, POW5_INV_SPLIT[q], i);
+			if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+				const int32_t l = POW5_INV_BITCOUNT + Pow5Bits(q - 1) - 1;
+				lastRemovedDigit = static_cast<uint8_t>(MulShift(mv, POW5_INV_SPLIT[q - 1], -e2 + static_cast<int32_t>(q) - 1 + l) % 10);
+			}
+			if (q <= 9) {
+				if (mv % 5 == 0)
+					vrIsTrailingZeros = MultipleOfPowerOf5(mv, q);
+				else if (acceptBounds)
+					vmIsTrailingZeros = MultipleOfPowerOf5(mm, q);
+				else
+					vp -= MultipleOfPowerOf5(mp, q);
+			}
+		} else {
+			const uint32_t q = Log10Pow5(-e2);
+			e10 = static_cast<int32_t>(q) + e2;
+			const int32_t i = -e2 - static_cast<int32_t>(q);
+			const int32_t k = Pow5Bits(i) - POW5_BITCOUNT;
+			int32_t j = static_cast<int32_t>(q) - k;
+			vr = MulShift(mv, POW5_SPLIT[i], j);
+			vp = MulShift(mp, POW5_SPLIT[i], j);
+			vm = MulShift(mm, POW5_SPLIT[i], j);
+			if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+				j = static_cast<int32_t>(q) - 1 - (Pow5Bits(i + 1) - POW5_BITCOUNT);
+				lastRemovedDigit = static_cast<uint8_t>(MulShift(mv, POW5_SPLIT[i + 1], j) % 10);
+			}
+			if (q <= 1) {
+				vrIsTrailingZeros = true;
+				if (acceptBounds)
+					vmIsTrailingZeros = mmShift == 1;
+				else
+					--vp;
+			} else if (q < 31) {
+				vrIsTrailingZeros = MultipleOfPowerOf2(mv, q - 1);
+			}
+		}
+
+		// Remove digits while the interval still contains a shorter number.
+		int32_t removed = 0;
+		uint32_t output;
+		if (vmIsTrailingZeros || vrIsTrailingZeros) {
+			while (vp / 10 > vm / 10) {
+				vmIsTrailingZeros &= vm % 10 == 0;
+				vrIsTrailingZeros &= lastRemovedDigit == 0;
+				lastRemovedDigit = static_cast<uint8_t>(vr % 10);
+				vr /= 10;
+				vp /= 10;
+				vm /= 10;
+				++removed;
+			}
+			if (vmIsTrailingZeros) {
+				while (vm % 10 == 0) {
+					vrIsTrailingZeros &= lastRemovedDigit == 0;
+					lastRemovedDigit = static_cast<uint8_t>(vr % 10);
+					vr /= 10;
+					vp /= 10;
+					vm /= 10;
+					++removed;
+				}
+			}
+			// Round half to even.
+			if (vrIsTrailingZeros && lastRemovedDigit == 5 && vr % 2 == 0)
+				lastRemovedDigit = 4;
+			output = vr + ((vr == vm && (!acceptBounds || !vmIsTrailingZeros)) || lastRemovedDigit >= 5);
+		} else {
+			while (vp / 10 > vm / 10) {
+				lastRemovedDigit = static_cast<uint8_t>(vr % 10);
+				vr /= 10;
+				vp /= 10;
+				vm /= 10;
+				++removed;
+			}
+			output = vr + (vr == vm || lastRemovedDigit >= 5);
+		}
+
+		DecimalFloat result;
+		result.mantissa = output;
+		result.exponent = e10 + removed;
+		return result;
+	}
+
+	inline int DecimalLength(uint32_t v)
+	{
+		int length = 1;
+		while (v >= 10) {
+			v /= 10;
+			++length;
+		}
+		return length;
+	}
+
+	char *WriteExponent(char *p, int32_t exponent)
+	{
+		*p++ = 'e';
+		if (exponent < 0) {
+			*p++ = '-';
+			exponent = -exponent;
+		}
+		if (exponent >= 10)
+			*p++ = static_cast<char>('0' + exponent / 10);
+		*p++ = static_cast<char>('0' + exponent % 10);
+		return p;
+	}
+}
+
+size_t TASLogger::FormatShortestFloat(float value, char *buffer)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	const bool sign = (bits >> (MANTISSA_BITS + EXPONENT_BITS)) != 0;
+	const uint32_t ieeeMantissa = bits & ((1u << MANTISSA_BITS) - 1);
+	const uint32_t ieeeExponent = (bits >> MANTISSA_BITS) & ((1u << EXPONENT_BITS) - 1);
+
+	if (ieeeExponent == (1u << EXPONENT_BITS) - 1)
+		return 0;
+
+	char *p = buffer;
+	if (sign)
+		*p++ = '-';
+
+	if (ieeeExponent == 0 && ieeeMantissa == 0) {
+		std::memcpy(p, "0.0", 3);
+		return p + 3 - buffer;
+	}
+
+	const DecimalFloat decimal = ToDecimal(ieeeMantissa, ieeeExponent);
+
+	char digits[10];
+	const int length = DecimalLength(decimal.mantissa);
+	uint32_t mantissa = decimal.mantissa;
+	for (int i = length - 1; i >= 0; --i) {
+		digits[i] = static_cast<char>('0' + mantissa % 10);
+		mantissa /= 10;
+	}
+
+	// Same layout as the Prettify step of rapidjson::Writer::Double, where k
+	// is the position of the decimal point relative to the first digit.
+	const int32_t k = length + decimal.exponent;
+	if (decimal.exponent >= 0 && k <= 21) {
+		// 1234e7 -> 12340000000.0
+		std::memcpy(p, digits, length);
+		p += length;
+		for (int32_t i = length; i < k; ++i)
+			*p++ = '0';
+		*p++ = '.';
+		*p++ = '0';
+	} else if (0 < k && k <= 21) {
+		// 1234e-2 -> 12.34
+		std::memcpy(p, digits, k);
+		p += k;
+		*p++ = '.';
+		std::memcpy(p, digits + k, length - k);
+		p += length - k;
+	} else if (-6 < k && k <= 0) {
+		// 1234e-6 -> 0.001234
+		*p++ = '0';
+		*p++ = '.';
+		for (int32_t i = k; i < 0; ++i)
+			*p++ = '0';
+		std::memcpy(p, digits, length);
+		p += length;
+	} else if (length == 1) {
+		// 1e30
+		*p++ = digits[0];
+		p = WriteExponent(p, k - 1);
+	} else {
+		// 1234e30 -> 1.234e33
+		*p++ = digits[0];
+		*p++ = '.';
+		std::memcpy(p, digits + 1, length - 1);
+		p += length - 1;
+		p = WriteExponent(p, k - 1);
+	}
+
+	return p - buffer;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+namespace TASLogger
+{
+	// Longest output of FormatShortestFloat, without a terminator.
+	const size_t MAX_FLOAT_LENGTH = 24;
+
+	// Writes the shortest decimal string that reads back as exactly value,
+	// formatted the way rapidjson::Writer formats doubles, and returns its
+	// length. Returns 0 for NaN and infinity, which JSON cannot represent.
+	size_t FormatShortestFloat(float value, char *buffer);
+}
@@ -0,0 +1,487 @@
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include "float_parse.hpp"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+using namespace TASLogger;
+
+// Decimal to float conversion after Daniel Lemire, "Number Parsing at a
+// Gigabyte per Second" (Software: Practice and Experience, 2021), the
+// Eisel-Lemire algorithm, specialized for 32-bit floats.
+namespace
+{
+	const int MANTISSA_BITS = 23;
+	const int MINIMUM_EXPONENT = -127;
+	const int INFINITE_POWER = 0xFF;
+	// Below this power of ten, 19 digits round to zero, above the other one
+	// any number is infinite.
+	const int SMALLEST_POWER_OF_TEN = -64;
+	const int LARGEST_POWER_OF_TEN = 38;
+	// The range in which a product can be exactly halfway between two floats.
+	const int MIN_EXPONENT_ROUND_TO_EVEN = -17;
+	const int MAX_EXPONENT_ROUND_TO_EVEN = 10;
+	const int MAX_DIGITS = 19;
+
+	// The most significant 128 bits of 5^q for q in [-64, 38], normalized so
+	// that the top bit is set. Rounded up for negative q.
+	static const uint64_t POW5_128[] = {
+		UINT64_C(0xa87fea27a539e9a5), UINT64_C(0x3f2398d747b36224),
+		UINT64_C(0xd29fe4b18e88640e), UINT64_C(0x8eec7f0d19a03aad),
+		UINT64_C(0x83a3eeeef9153e89), UINT64_C(0x1953cf68300424ac),
+		UINT64_C(0xa48ceaaab75a8e2b), UINT64_C(0x5fa8c3423c052dd7),
+		UINT64_C(0xcdb02555653131b6), UINT64_C(0x3792f412cb06794d),
+		UINT64_C(0x808e17555f3ebf11), UINT64_C(0xe2bbd88bbee40bd0),
+		UINT64_C(0xa0b19d2ab70e6ed6), UINT64_C(0x5b6aceaeae9d0ec4),
+		UINT64_C(0xc8de047564d20a8b), UINT64_C(0xf245825a5a445275),
+		UINT64_C(0xfb158592be068d2e), UINT64_C(0xeed6e2f0f0d56712),
+		UINT64_C(0x9ced737bb6c4183d), UINT64_C(0x55464dd69685606b),
+		UINT64_C(0xc428d05aa4751e4c), UINT64_C(0xaa97e14c3c26b886),
+		UINT64_C(0xf53304714d9265df), UINT64_C(0xd53dd99f4b3066a8),
+		UINT64_C(0x993fe2c6d07b7fab), UINT64_C(0xe546a8038efe4029),
+		UINT64_C(0xbf8fdb78849a5f96), UINT64_C(0xde98520472bdd033),
+		UINT64_C(0xef73d256a5c0f77c), UINT64_C(0x963e66858f6d4440),
+		UINT64_C(0x95a8637627989aad), UINT64_C(0xdde7001379a44aa8),
+		UINT64_C(0xbb127c53b17ec159), UINT64_C(0x5560c018580d5d52),
+		UINT64_C(0xe9d71b689dde71af), UINT64_C(0xaab8f01e6e10b4a6),
+		UINT64_C(0x9226712162ab070d), UINT64_C(0xcab3961304ca70e8),
+		UINT64_C(0xb6b00d69bb55c8d1), UINT64_C(0x3d607b97c5fd0d22),
+		UINT64_C(0xe45c10c42a2b3b05), UINT64_C(0x8cb89a7db77c506a),
+		UINT64_C(0x8eb98a7a9a5b04e3), UINT64_C(0x77f3608e92adb242),
+		UINT64_C(0xb267ed1940f1c61c), UINT64_C(0x55f038b237591ed3),
+		UINT64_C(0xdf01e85f912e37a3), UINT64_C(0x6b6c46dec52f6688),
+		UINT64_C(0x8b61313bbabce2c6), UINT64_C(0x2323ac4b3b3da015),
+		UINT64_C(0xae397d8aa96c1b77), UINT64_C(0xabec975e0a0d081a),
+		UINT64_C(0xd9c7dced53c72255), UINT64_C(0x96e7bd358c904a21),
+		UINT64_C(0x881cea14545c7575), UINT64_C(0x7e50d64177da2e54),
+		UINT64_C(0xaa242499697392d2), UINT64_C(0xdde50bd1d5d0b9e9),
+		UINT64_C(0xd4ad2dbfc3d07787), UINT64_C(0x955e4ec64b44e864),
+		UINT64_C(0x84ec3c97da624ab4), UINT64_C(0xbd5af13bef0b113e),
+		UINT64_C(0xa6274bbdd0fadd61), UINT64_C(0xecb1ad8aeacdd58e),
+		UINT64_C(0xcfb11ead453994ba), UINT64_C(0x67de18eda5814af2),
+		UINT64_C(0x81ceb32c4b43fcf4), UINT64_C(0x80eacf948770ced7),
+		UINT64_C(0xa2425ff75e14fc31), UINT64_C(0xa1258379a94d028d),
+		UINT64_C(0xcad2f7f5359a3b3e), UINT64_C(0x096ee45813a04330),
+		UINT64_C(0xfd87b5f28300ca0d), UINT64_C(0x8bca9d6e188853fc),
+		UINT64_C(0x9e74d1b791e07e48), UINT64_C(0x775ea264cf55347e),
+		UINT64_C(0xc612062576589dda), UINT64_C(0x95364afe032a819e),
+		UINT64_C(0xf79687aed3eec551), UINT64_C(0x3a83ddbd83f52205),
+		UINT64_C(0x9abe14cd44753b52), UINT64_C(0xc4926a9672793543),
+		UINT64_C(0xc16d9a0095928a27), UINT64_C(0x75b7053c0f178294),
+		UINT64_C(0xf1c90080baf72cb1), UINT64_C(0x5324c68b12dd6339),
+		UINT64_C(0x971da05074da7bee), UINT64_C(0xd3f6fc16ebca5e04),
+		UINT64_C(0xbce5086492111aea), UINT64_C(0x88f4bb1ca6bcf585),
+		UINT64_C(0xec1e4a7db69561a5), UINT64_C(0x2b31e9e3d06c32e6),
+		UINT64_C(0x9392ee8e921d5d07), UINT64_C(0x3aff322e62439fd0),
+		UINT64_C(0xb877aa3236a4b449), UINT64_C(0x09befeb9fad487c3),
+		UINT64_C(0xe69594bec44de15b), UINT64_C(0x4c2ebe687989a9b4),
+		UINT64_C(0x901d7cf73ab0acd9), UINT64_C(0x0f9d37014bf60a11),
+		UINT64_C(0xb424dc35095cd80f), UINT64_C(0x538484c19ef38c95),
+		UINT64_C(0xe12e13424bb40e13), UINT64_C(0x2865a5f206b06fba),
+		UINT64_C(0x8cbccc096f5088cb), UINT64_C(0xf93f87b7442e45d4),
+		UINT64_C(0xafebff0bcb24aafe), UINT64_C(0xf78f69a51539d749),
+		UINT64_C(0xdbe6fecebdedd5be), UINT64_C(0xb573440e5a884d1c),
+		UINT64_C(0x89705f4136b4a597), UINT64_C(0x31680a88f8953031),
+		UINT64_C(0xabcc77118461cefc), UINT64_C(0xfdc20d2b36ba7c3e),
+		UINT64_C(0xd6bf94d5e57a42bc), UINT64_C(0x3d32907604691b4d),
+		UINT64_C(0x8637bd05af6c69b5), UINT64_C(0xa63f9a49c2c1b110),
+		UINT64_C(0xa7c5ac471b478423), UINT64_C(0x0fcf80dc33721d54),
+		UINT64_C(0xd1b71758e219652b), UINT64_C(0xd3c36113404ea4a9),
+		UINT64_C(0x83126e978d4fdf3b), UINT64_C(0x645a1cac083126ea),
+		UINT64_C(0xa3d70a3d70a3d70a), UINT64_C(0x3d70a3d70a3d70a4),
+		UINT64_C(0xcccccccccccccccc), UINT64_C(0xcccccccccccccccd),
+		UINT64_C(0x8000000000000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xa000000000000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xc800000000000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xfa00000000000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0x9c40000000000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xc350000000000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xf424000000000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0x9896800000000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xbebc200000000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xee6b280000000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0x9502f90000000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xba43b74000000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xe8d4a51000000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0x9184e72a00000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xb5e620f480000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xe35fa931a0000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0x8e1bc9bf04000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xb1a2bc2ec5000000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xde0b6b3a76400000), UINT64_C(0x0000000000000000),
+		UINT64_C(0x8ac7230489e80000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xad78ebc5ac620000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xd8d726b7177a8000), UINT64_C(0x0000000000000000),
+		UINT64_C(0x878678326eac9000), UINT64_C(0x0000000000000000),
+		UINT64_C(0xa968163f0a57b400), UINT64_C(0x0000000000000000),
+		UINT64_C(0xd3c21bcecceda100), UINT64_C(0x0000000000000000),
+		UINT64_C(0x84595161401484a0), UINT64_C(0x0000000000000000),
+		UINT64_C(0xa56fa5b99019a5c8), UINT64_C(0x0000000000000000),
+		UINT64_C(0xcecb8f27f4200f3a), UINT64_C(0x0000000000000000),
+		UINT64_C(0x813f3978f8940984), UINT64_C(0x4000000000000000),
+		UINT64_C(0xa18f07d736b90be5), UINT64_C(0x5000000000000000),
+		UINT64_C(0xc9f2c9cd04674ede), UINT64_C(0xa400000000000000),
+		UINT64_C(0xfc6f7c4045812296), UINT64_C(0x4d00000000000000),
+		UINT64_C(0x9dc5ada82b70b59d), UINT64_C(0xf020000000000000),
+		UINT64_C(0xc5371912364ce305), UINT64_C(0x6c28000000000000),
+		UINT64_C(0xf684df56c3e01bc6), UINT64_C(0xc732000000000000),
+		UINT64_C(0x9a130b963a6c115c), UINT64_C(0x3c7f400000000000),
+		UINT64_C(0xc097ce7bc90715b3), UINT64_C(0x4b9f100000000000),
+		UINT64_C(0xf0bdc21abb48db20), UINT64_C(0x1e86d40000000000),
+		UINT64_C(0x96769950b50d88f4), UINT64_C(0x1314448000000000)
+	};
+
+	// Exact float powers of ten and the largest exact significand, for
+	// Clinger's fast path.
+	static const float POW10_FLOAT[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+	const uint64_t MAX_FAST_PATH_SIGNIFICAND = uint64_t(1) << 24;
+
+	struct UInt128
+	{
+		uint64_t low;
+		uint64_t high;
+	};
+
+	inline UInt128 Multiply(uint64_t a, uint64_t b)
+	{
+		UInt128 result;
+#if defined(__SIZEOF_INT128__)
+		const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+		result.low = static_cast<uint64_t>(product);
+		result.high = static_cast<uint64_t>(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+		result.low = _umul128(a, b, &result.high);
+#else
+		const uint64_t aLow = a & 0xFFFFFFFF, aHigh = a >> 32;
+		const uint64_t bLow = b & 0xFFFFFFFF, bHigh = b >> 32;
+		const uint64_t lowLow = aLow * bLow;
+		const uint64_t highLow = aHigh * bLow + (lowLow >> 32);
+		const uint64_t lowHigh = aLow * bHigh + (highLow & 0xFFFFFFFF);
+		result.low = (lowHigh << 32) | (lowLow & 0xFFFFFFFF);
+		result.high = aHigh * bHigh + (highLow >> 32) + (lowHigh >> 32);
+#endif
+		return result;
+	}
+
+	inline int LeadingZeros(uint64_t x)
+	{
+#if defined(__GNUC__)
+		return __builtin_clzll(x);
+#else
+		int n = 0;
+		while (!(x & (uint64_t(1) << 63))) {
+			x <<= 1;
+			++n;
+		}
+		return n;
+#endif
+	}
+
+	// floor(log2(10^q)) + 63
+	inline int Power(int q)
+	{
+		return (((152170 + 65536) * q) >> 16) + 63;
+	}
+
+	// Returns the bits of the float nearest to w * 10^q, for a nonzero w.
+	uint32_t ComputeFloat(int q, uint64_t w)
+	{
+		if (q < SMALLEST_POWER_OF_TEN)
+			return 0;
+		if (q > LARGEST_POWER_OF_TEN)
+			return static_cast<uint32_t>(INFINITE_POWER) << MANTISSA_BITS;
+
+		const int lz = LeadingZeros(w);
+		w <<= lz;
+
+		// Only as many bits of the product as the rounding needs.
+		const size_t index = 2 * static_cast<size_t>(q - SMALLEST_POWER_OF_TEN);
+		UInt128 product = Multiply(w, POW5_128[index]);
+		const uint64_t precisionMask = UINT64_C(0xFFFFFFFFFFFFFFFF) >> (MANTISSA_BITS + 3);
+		if ((product.high & precisionMask) == precisionMask) {
+			const UInt128 second = Multiply(w, POW5_128[index + 1]);
+			product.low += second.high;
+			if (second.high > product.low)
+				++product.high;
+		}
+
+		const int upperBit = static_cast<int>(product.high >> 63);
+		const int shift = upperBit + 64 - MANTISSA_BITS - 3;
+		uint64_t mantissa = product.high >> shift;
+		int power2 = Power(q) + upperBit - lz - MINIMUM_EXPONENT;
+
+		if (power2 <= 0) {
+			// Subnormal.
+			if (-power2 + 1 >= 64)
+				return 0;
+			mantissa >>= -power2 + 1;
+			mantissa += mantissa & 1;
+			mantissa >>= 1;
+			power2 = mantissa < (uint64_t(1) << MANTISSA_BITS) ? 0 : 1;
+			return static_cast<uint32_t>(power2) << MANTISSA_BITS | static_cast<uint32_t>(mantissa & ((uint64_t(1) << MANTISSA_BITS) - 1));
+		}
+
+		// Exactly halfway between two floats: round to even.
+		if (product.low <= 1 && q >= MIN_EXPONENT_ROUND_TO_EVEN && q <= MAX_EXPONENT_ROUND_TO_EVEN
+			&& (mantissa & 3) == 1 && (mantissa << shift) == product.high)
+			mantissa &= ~uint64_t(1);
+
+		mantissa += mantissa & 1;
+		mantissa >>= 1;
+		if (mantissa >= (uint64_t(2) << MANTISSA_BITS)) {
+			mantissa = uint64_t(1) << MANTISSA_BITS;
+			++power2;
+		}
+		mantissa &= ~(uint64_t(1) << MANTISSA_BITS);
+		if (power2 >= INFINITE_POWER)
+			return static_cast<uint32_t>(INFINITE_POWER) << MANTISSA_BITS;
+		return static_cast<uint32_t>(power2) << MANTISSA_BITS | static_cast<uint32_t>(mantissa);
+	}
+
+	inline bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	// A float halfway between two others has at most 114 significant
+	// digits, so more digits only tell whether the number is above it.
+	const int MAX_EXACT_DIGITS = 120;
+
+	// Large enough for 120 digits, the powers of five and the shifts that
+	// comparing them with a float needs.
+	class BigInteger
+	{
+	public:
+		explicit BigInteger(uint64_t value) : size(0)
+		{
+			for (; value != 0; value >>= 32)
+				limbs[size++] = static_cast<uint32_t>(value);
+		}
+
+		void MultiplyAdd(uint32_t factor, uint32_t addend)
+		{
+			uint64_t carry = addend;
+			for (int i = 0; i < size; ++i) {
+				const uint64_t product = static_cast<uint64_t>(limbs[i]) * factor + carry;
+				limbs[i] = static_cast<uint32_t>(product);
+				carry = product >> 32;
+			}
+			if (carry != 0 && size < LIMBS)
+				limbs[size++] = static_cast<uint32_t>(carry);
+		}
+
+		void MultiplyPow5(int n)
+		{
+			static const uint32_t POW5[] = {1, 5, 25, 125, 625, 3125, 15625, 78125, 390625, 1953125, 9765625, 48828125, 244140625, 1220703125};
+			for (; n >= 13; n -= 13)
+				MultiplyAdd(POW5[13], 0);
+			if (n != 0)
+				MultiplyAdd(POW5[n], 0);
+		}
+
+		void ShiftLeft(int bits)
+		{
+			if (size == 0)
+				return;
+			const int limbShift = bits / 32;
+			const int bitShift = bits % 32;
+			if (bitShift != 0) {
+				uint32_t carry = 0;
+				for (int i = 0; i < size; ++i) {
+					const uint32_t limb = limbs[i];
+					limbs[i] = (limb << bitShift) | carry;
+					carry = limb >> (32 - bitShift);
+				}
+				if (carry != 0 && size < LIMBS)
+					limbs[size++] = carry;
+			}
+			if (limbShift != 0 && size + limbShift <= LIMBS) {
+				std::memmove(limbs + limbShift, limbs, size * sizeof(uint32_t));
+				std::memset(limbs, 0, limbShift * sizeof(uint32_t));
+				size += limbShift;
+			}
+		}
+
+		int Compare(const BigInteger &other) const
+		{
+			if (size != other.size)
+				return size < other.size ? -1 : 1;
+			for (int i = size; i-- > 0;) {
+				if (limbs[i] != other.limbs[i])
+					return limbs[i] < other.limbs[i] ? -1 : 1;
+			}
+			return 0;
+		}
+
+	private:
+		static const int LIMBS = 40;
+		uint32_t limbs[LIMBS];
+		int size;
+	};
+
+	// Decides between two adjacent floats for a number whose first 19 digits
+	// do not, by comparing all of its digits with the point halfway between
+	// them.
+	uint32_t RoundExactly(const char *integerBegin, const char *integerEnd, const char *fractionBegin, const char *fractionEnd,
+		int64_t explicitExponent, uint32_t lowBits, uint32_t highBits)
+	{
+		BigInteger digits(0);
+		int taken = 0;
+		int64_t lastExponent = 0;
+		bool moreDigits = false;
+		for (const char *p = integerBegin; p != fractionEnd; ++p) {
+			if (*p == '.' || (taken == 0 && *p == '0'))
+				continue;
+			if (taken == MAX_EXACT_DIGITS) {
+				moreDigits |= *p != '0';
+				continue;
+			}
+			digits.MultiplyAdd(10, static_cast<uint32_t>(*p - '0'));
+			++taken;
+			lastExponent = p < integerEnd ? integerEnd - p - 1 : -(p - fractionBegin + 1);
+		}
+		const int64_t decimalExponent = lastExponent + explicitExponent;
+
+		// halfway = (2 * significand + 1) * 2^(binaryExponent - 1)
+		const uint32_t exponentField = lowBits >> MANTISSA_BITS;
+		uint64_t significand = lowBits & ((uint32_t(1) << MANTISSA_BITS) - 1);
+		int binaryExponent = 1 + MINIMUM_EXPONENT - MANTISSA_BITS;
+		if (exponentField != 0) {
+			significand |= uint64_t(1) << MANTISSA_BITS;
+			binaryExponent = static_cast<int>(exponentField) + MINIMUM_EXPONENT - MANTISSA_BITS;
+		}
+		BigInteger halfway(2 * significand + 1);
+		int halfwayExponent = binaryExponent - 1;
+
+		// Compare digits * 2^e * 5^e with halfway * 2^halfwayExponent.
+		const int e = static_cast<int>(decimalExponent);
+		if (e >= 0)
+			digits.MultiplyPow5(e);
+		else
+			halfway.MultiplyPow5(-e);
+		if (e > halfwayExponent)
+			digits.ShiftLeft(e - halfwayExponent);
+		else
+			halfway.ShiftLeft(halfwayExponent - e);
+
+		int order = digits.Compare(halfway);
+		if (order == 0 && moreDigits)
+			order = 1;
+		if (order == 0)
+			return (lowBits & 1) == 0 ? lowBits : highBits;
+		return order < 0 ? lowBits : highBits;
+	}
+}
+
+bool TASLogger::ParseFloat(const char *str, size_t length, float &value)
+{
+	const char *p = str;
+	const char *const end = str + length;
+
+	const bool minus = p != end && *p == '-';
+	if (minus)
+		++p;
+	if (p == end || !IsDigit(*p))
+		return false;
+
+	uint64_t w = 0;
+	const char *const integerBegin = p;
+	if (*p == '0') {
+		++p;
+	} else {
+		for (; p != end && IsDigit(*p); ++p)
+			w = w * 10 + static_cast<unsigned>(*p - '0');
+	}
+	const char *const integerEnd = p;
+
+	int64_t exponent = 0;
+	const char *fractionBegin = p;
+	const char *fractionEnd = p;
+	if (p != end && *p == '.') {
+		fractionBegin = ++p;
+		for (; p != end && IsDigit(*p); ++p)
+			w = w * 10 + static_cast<unsigned>(*p - '0');
+		fractionEnd = p;
+		if (fractionBegin == fractionEnd)
+			return false;
+		exponent = -(fractionEnd - fractionBegin);
+	}
+
+	int64_t explicitExponent = 0;
+	if (p != end && (*p == 'e' || *p == 'E')) {
+		++p;
+		const bool exponentMinus = p != end && *p == '-';
+		if (p != end && (*p == '-' || *p == '+'))
+			++p;
+		if (p == end || !IsDigit(*p))
+			return false;
+		for (; p != end && IsDigit(*p); ++p) {
+			if (explicitExponent < 0x10000000)
+				explicitExponent = explicitExponent * 10 + (*p - '0');
+		}
+		if (exponentMinus)
+			explicitExponent = -explicitExponent;
+		exponent += explicitExponent;
+	}
+	if (p != end)
+		return false;
+
+	// With more than 19 significant digits, w overflowed. Start over with
+	// the first 19 of them.
+	bool truncated = false;
+	int digits = static_cast<int>((integerEnd - integerBegin) + (fractionEnd - fractionBegin));
+	if (digits > MAX_DIGITS) {
+		for (const char *q = integerBegin; q != fractionEnd && (*q == '0' || *q == '.'); ++q) {
+			if (*q == '0')
+				--digits;
+		}
+	}
+	if (digits > MAX_DIGITS) {
+		truncated = true;
+		const uint64_t minNineteenDigits = UINT64_C(1000000000000000000);
+		w = 0;
+		const char *q = integerBegin;
+		for (; w < minNineteenDigits && q != integerEnd; ++q)
+			w = w * 10 + static_cast<unsigned>(*q - '0');
+		if (w >= minNineteenDigits) {
+			exponent = (integerEnd - q) + explicitExponent;
+		} else {
+			for (q = fractionBegin; w < minNineteenDigits && q != fractionEnd; ++q)
+				w = w * 10 + static_cast<unsigned>(*q - '0');
+			exponent = (fractionBegin - q) + explicitExponent;
+		}
+	}
+
+	float result;
+	if (w == 0) {
+		result = 0;
+	}
+#if FLT_EVAL_METHOD == 0
+	else if (!truncated && exponent >= -10 && exponent <= 10 && w <= MAX_FAST_PATH_SIGNIFICAND) {
+		// Both operands are exact, so the one rounding is correct.
+		result = static_cast<float>(w);
+		if (exponent < 0)
+			result /= POW10_FLOAT[-exponent];
+		else
+			result *= POW10_FLOAT[exponent];
+	}
+#endif
+	else {
+		const int q = exponent < -1000 ? -1000 : exponent > 1000 ? 1000 : static_cast<int>(exponent);
+		uint32_t bits = ComputeFloat(q, w);
+		// The digits that were cut off only matter if w + 1 rounds
+		// differently.
+		if (truncated) {
+			const uint32_t highBits = ComputeFloat(q, w + 1);
+			if (highBits != bits)
+				bits = RoundExactly(integerBegin, integerEnd, fractionBegin, fractionEnd, explicitExponent, bits, highBits);
+		}
+		std::memcpy(&result, &bits, sizeof(result));
+	}
+
+	value = minus ? -result : result;
+	return true;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+namespace TASLogger
+{
+	// Whether the JSON number has neither a fraction nor an exponent, which
+	// RapidJSON passes on as an integer.
+	inline bool IsIntegerNumber(const char *str, size_t length)
+	{
+		for (size_t i = 0; i < length; ++i) {
+			if (str[i] == '.' || str[i] == 'e' || str[i] == 'E')
+				return false;
+		}
+		return true;
+	}
+
+	// Converts the JSON number in [str, str + length) to the nearest float,
+	// without going through double. Returns false if it is not a valid JSON
+	// number. Numbers that are too large become infinity.
+	bool ParseFloat(const char *str, size_t length, float &value);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "taslogger/reader.hpp"
+
+namespace TASLogger
+{
+	// Resets a ReaderPhysicsFrame for reuse while keeping the nested
+	// collision vectors and strings around, so that a streaming parse stops
+	// allocating once it has seen the largest frame.
+	template<typename PhysicsFrame>
+	class FrameRecycler
+	{
+	public:
+		typedef typename PhysicsFrame::StringType StringType;
+		typedef typename PhysicsFrame::CommandFrameType CommandFrameType;
+		typedef typename PhysicsFrame::CollisionListType CollisionListType;
+
+		void Reset(PhysicsFrame &frame)
+		{
+			for (CommandFrameType &commandFrame : frame.commandFrameList) {
+				commandFrame.collisionList.clear();
+				spareCollisionLists.push_back(CollisionListType());
+				spareCollisionLists.back().swap(commandFrame.collisionList);
+			}
+			for (StringType &message : frame.consolePrintList) {
+				spareStrings.push_back(StringType());
+				std::swap(spareStrings.back(), message);
+			}
+
+			frame.commandFrameList.clear();
+			frame.consolePrintList.clear();
+			frame.damageList.clear();
+			frame.objectMoveList.clear();
+			ClearString(frame.commandBuffer);
+			frame.frameTime = 0;
+			frame.paused = false;
+			frame.clientState = 5;
+			frame.rng = ReaderRng();
+		}
+
+		CommandFrameType &AddCommandFrame(PhysicsFrame &frame)
+		{
+			frame.commandFrameList.push_back(CommandFrameType());
+			CommandFrameType &commandFrame = frame.commandFrameList.back();
+			if (!spareCollisionLists.empty()) {
+				commandFrame.collisionList.swap(spareCollisionLists.back());
+				spareCollisionLists.pop_back();
+			}
+			return commandFrame;
+		}
+
+		StringType &AddConsolePrint(PhysicsFrame &frame)
+		{
+			frame.consolePrintList.push_back(StringType());
+			StringType &message = frame.consolePrintList.back();
+			if (!spareStrings.empty()) {
+				std::swap(message, spareStrings.back());
+				spareStrings.pop_back();
+			}
+			return message;
+		}
+
+	private:
+		template<typename Allocator>
+		static void ClearString(std::basic_string<char, std::char_traits<char>, Allocator> &str) { str.clear(); }
+		static void ClearString(StringRef &str) { str = StringRef(); }
+
+		std::vector<CollisionListType> spareCollisionLists;
+		std::vector<StringType> spareStrings;
+	};
+}
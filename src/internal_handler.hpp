@@ -0,0 +1,1017 @@
+#pragma once
+
+#include <cstring>
+#include <functional>
+#include <string>
+#include "rapidjson/reader.h"
+#include "taslogger/reader.hpp"
+#include "float_parse.hpp"
+#include "frame_recycler.hpp"
+#include "rng.hpp"
+
+namespace TASLogger
+{
+	enum ParseState
+	{
+		StateLog,
+		StateToolVersion,
+		StateBuildNumber,
+		StateGameMod,
+		StateDeltaEncoded,
+
+		StatePhysicsFrameList,
+		StatePhysicsFrame,
+		StateFrameTime,
+		StateCommandBuffer,
+		StatePaused,
+		StateClientState,
+		StateRng,
+
+		StateConsoleMessageList,
+		StateConsoleMessage,
+
+		StateDamageList,
+		StateDamage,
+		StateDamageAmount,
+		StateDamageBits,
+		StateDamageDirection,
+
+		StateObjectMoveList,
+		StateObjectMove,
+		StateObjectPull,
+		StateObjectVelocity,
+		StateObjectPosition,
+
+		StateCommandFrameList,
+		StateCommandFrame,
+		StateMilliseconds,
+		StateFrameTimeRemainder,
+		StateFramebulkId,
+		StateSharedSeed,
+		StateViewangles,
+		StatePunchangles,
+		StateButtons,
+		StateImpulse,
+		StateFSU,
+		StateEntFriction,
+		StateEntGravity,
+		StateHealth,
+		StateArmor,
+		StatePrePlayerMove,
+		StatePostPlayerMove,
+
+		StateCollisionList,
+		StateCollision,
+		StateCollisionEntity,
+		StateCollisionPlaneNormal,
+		StateCollisionPlaneDistance,
+		StateImpactVelocity,
+
+		StateVelocity,
+		StatePosition,
+		StateBaseVelocity,
+		StateOnGround,
+		StateOnLadder,
+		StateWaterLevel,
+		StateDuckState,
+
+		StateIdum,
+		StateIy,
+		StateIv
+	};
+
+	// The flags to parse with for InternalHandler. The numbers are passed to
+	// RawNumber as strings and converted to float directly, instead of to
+	// double by RapidJSON first.
+	const unsigned HANDLER_PARSE_FLAGS = rapidjson::kParseNumbersAsStringsFlag;
+
+	// All of the keys fit in eight bytes, so a key is looked up by packing it
+	// into an integer and scanning the handful of keys valid in the current
+	// object for it.
+	const size_t MAX_KEY_LENGTH = 8;
+
+	constexpr uint64_t PackKey(const char *key, size_t length)
+	{
+		return length == 0 ? 0 : (PackKey(key + 1, length - 1) << 8) | static_cast<unsigned char>(key[0]);
+	}
+
+	struct KeyEntry
+	{
+		uint64_t packedKey;
+		ParseState state;
+	};
+
+	template<size_t N>
+	constexpr KeyEntry MakeKeyEntry(const char (&key)[N], ParseState state)
+	{
+		static_assert(N - 1 <= MAX_KEY_LENGTH, "Key too long to pack.");
+		return KeyEntry{PackKey(key, N - 1), state};
+	}
+
+	inline bool LookupKey(const KeyEntry *table, size_t count, const char *str, rapidjson::SizeType length, ParseState &state)
+	{
+		if (length == 0 || length > MAX_KEY_LENGTH)
+			return false;
+
+		uint64_t packedKey = 0;
+		for (rapidjson::SizeType i = length; i-- > 0;)
+			packedKey = (packedKey << 8) | static_cast<unsigned char>(str[i]);
+
+		for (const KeyEntry *entry = table; entry != table + count; ++entry) {
+			if (entry->packedKey == packedKey) {
+				state = entry->state;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	template<size_t N>
+	inline bool LookupKey(const KeyEntry (&table)[N], const char *str, rapidjson::SizeType length, ParseState &state)
+	{
+		return LookupKey(table, N, str, length, state);
+	}
+
+	const KeyEntry KEY_TABLE_LOG[] = {
+		MakeKeyEntry(KEY_TOOL_VERSION, StateToolVersion),
+		MakeKeyEntry(KEY_BUILD_NUMBER, StateBuildNumber),
+		MakeKeyEntry(KEY_MOD, StateGameMod),
+		MakeKeyEntry(KEY_PHYSICS_FRAMES, StatePhysicsFrameList),
+		MakeKeyEntry(KEY_DELTA_ENCODED, StateDeltaEncoded)
+	};
+
+	const KeyEntry KEY_TABLE_PHYSICS_FRAME[] = {
+		MakeKeyEntry(KEY_FRAMETIME, StateFrameTime),
+		MakeKeyEntry(KEY_COMMAND_BUFFER, StateCommandBuffer),
+		MakeKeyEntry(KEY_PAUSED, StatePaused),
+		MakeKeyEntry(KEY_CLIENT_STATE, StateClientState),
+		MakeKeyEntry(KEY_DAMAGES, StateDamageList),
+		MakeKeyEntry(KEY_OBJECT_BOOSTS, StateObjectMoveList),
+		MakeKeyEntry(KEY_COMMAND_FRAMES, StateCommandFrameList),
+		MakeKeyEntry(KEY_CONSOLE_MESSAGES, StateConsoleMessageList),
+		MakeKeyEntry(KEY_RNG, StateRng)
+	};
+
+	const KeyEntry KEY_TABLE_DAMAGE[] = {
+		MakeKeyEntry(KEY_DAMAGE_AMOUNT, StateDamageAmount),
+		MakeKeyEntry(KEY_DAMAGE_BITS, StateDamageBits),
+		MakeKeyEntry(KEY_DAMAGE_DIRECTION, StateDamageDirection)
+	};
+
+	const KeyEntry KEY_TABLE_OBJECT_MOVE[] = {
+		MakeKeyEntry(KEY_IS_PULL, StateObjectPull),
+		MakeKeyEntry(KEY_OBJECT_VELOCITY, StateObjectVelocity),
+		MakeKeyEntry(KEY_OBJECT_POSITION, StateObjectPosition)
+	};
+
+	const KeyEntry KEY_TABLE_COMMAND_FRAME[] = {
+		MakeKeyEntry(KEY_MILLISECONDS, StateMilliseconds),
+		MakeKeyEntry(KEY_FRAMETIME_REMAINDER, StateFrameTimeRemainder),
+		MakeKeyEntry(KEY_FRAMEBULK_ID, StateFramebulkId),
+		MakeKeyEntry(KEY_SHARED_SEED, StateSharedSeed),
+		MakeKeyEntry(KEY_VIEWANGLES, StateViewangles),
+		MakeKeyEntry(KEY_PUNCHANGLES, StatePunchangles),
+		MakeKeyEntry(KEY_BUTTONS, StateButtons),
+		MakeKeyEntry(KEY_IMPULSE, StateImpulse),
+		MakeKeyEntry(KEY_FSU, StateFSU),
+		MakeKeyEntry(KEY_ENT_FRICTION, StateEntFriction),
+		MakeKeyEntry(KEY_ENT_GRAVITY, StateEntGravity),
+		MakeKeyEntry(KEY_HEALTH, StateHealth),
+		MakeKeyEntry(KEY_ARMOR, StateArmor),
+		MakeKeyEntry(KEY_PRE_PLAYERMOVE, StatePrePlayerMove),
+		MakeKeyEntry(KEY_POST_PLAYERMOVE, StatePostPlayerMove),
+		MakeKeyEntry(KEY_COLLISIONS, StateCollisionList)
+	};
+
+	const KeyEntry KEY_TABLE_COLLISION[] = {
+		MakeKeyEntry(KEY_COLLISION_ENTITY, StateCollisionEntity),
+		MakeKeyEntry(KEY_COLLISION_PLANE_NORMAL, StateCollisionPlaneNormal),
+		MakeKeyEntry(KEY_COLLISION_PLANE_DISTANCE, StateCollisionPlaneDistance),
+		MakeKeyEntry(KEY_COLLISION_IMPACT_VELOCITY, StateImpactVelocity)
+	};
+
+	const KeyEntry KEY_TABLE_PLAYER[] = {
+		MakeKeyEntry(KEY_VELOCITY, StateVelocity),
+		MakeKeyEntry(KEY_POSITION, StatePosition),
+		MakeKeyEntry(KEY_BASEVELOCITY, StateBaseVelocity),
+		MakeKeyEntry(KEY_ONGROUND, StateOnGround),
+		MakeKeyEntry(KEY_ONLADDER, StateOnLadder),
+		MakeKeyEntry(KEY_WATERLEVEL, StateWaterLevel),
+		MakeKeyEntry(KEY_DUCK_STATE, StateDuckState)
+	};
+
+	const KeyEntry KEY_TABLE_RNG[] = {
+		MakeKeyEntry(KEY_IDUM, StateIdum),
+		MakeKeyEntry(KEY_IY, StateIy),
+		MakeKeyEntry(KEY_IV, StateIv)
+	};
+
+	// For the handlers that only look for a few keys.
+	template<size_t N>
+	inline bool IsKey(const char *str, rapidjson::SizeType length, const char (&key)[N])
+	{
+		return length == N - 1 && std::memcmp(str, key, N - 1) == 0;
+	}
+
+	inline bool IsWhitespace(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+	}
+
+	template<typename Allocator>
+	inline void AssignString(std::basic_string<char, std::char_traits<char>, Allocator> &dest, const char *str, rapidjson::SizeType length)
+	{
+		dest.assign(str, length);
+	}
+
+	inline void AssignString(StringRef &dest, const char *str, rapidjson::SizeType length)
+	{
+		dest = StringRef(str, length);
+	}
+
+	// Copies everything but the collisions, which are not delta encoded.
+	template<typename Dest, typename Src>
+	inline void CopyCommandFrameFields(Dest &dest, const Src &src)
+	{
+		dest.prePMState = src.prePMState;
+		dest.postPMState = src.postPMState;
+		std::memcpy(dest.viewangles, src.viewangles, sizeof(dest.viewangles));
+		std::memcpy(dest.punchangles, src.punchangles, sizeof(dest.punchangles));
+		std::memcpy(dest.FSU, src.FSU, sizeof(dest.FSU));
+		dest.frameTimeRemainder = src.frameTimeRemainder;
+		dest.entFriction = src.entFriction;
+		dest.entGravity = src.entGravity;
+		dest.health = src.health;
+		dest.armor = src.armor;
+		dest.framebulkId = src.framebulkId;
+		dest.sharedSeed = src.sharedSeed;
+		dest.msec = src.msec;
+		dest.buttons = src.buttons;
+		dest.impulse = src.impulse;
+	}
+
+	// The RapidJSON SAX handler that fills the reader structs, shared by all
+	// of the JSON parse paths.
+	template<typename Log>
+	class InternalHandler
+	{
+	public:
+		typedef typename Log::PhysicsFrameType PhysicsFrame;
+		typedef typename PhysicsFrame::CommandFrameType CommandFrame;
+		typedef std::function<bool(const PhysicsFrame &physicsFrame)> Callback;
+
+		explicit InternalHandler(Log &tasLog, const Callback &callback = Callback());
+
+		bool Null();
+		bool Bool(bool b);
+		bool Int(int i);
+		bool Uint(unsigned i);
+		bool Int64(int64_t i);
+		bool Uint64(uint64_t i);
+		bool Double(double d);
+		bool RawNumber(const char *str, rapidjson::SizeType length, bool copy);
+		bool String(const char *str, rapidjson::SizeType length, bool copy);
+		bool StartObject();
+		bool Key(const char *str, rapidjson::SizeType length, bool copy);
+		bool EndObject(rapidjson::SizeType memberCount);
+		bool StartArray();
+		bool EndArray(rapidjson::SizeType elementCount);
+
+		// Continue as if the physics frame list had just been opened, for
+		// parsing a run of physics frames cut out of a log.
+		inline void StartInPhysicsFrameList() { state = StatePhysicsFrameList; }
+
+		// Whether the parse is between the physics frames, which it is after
+		// the physics frame list is opened and after each complete frame.
+		inline bool InPhysicsFrameList() const { return state == StatePhysicsFrameList; }
+
+		// Where the array of three floats that the last key names goes, or
+		// nullptr if the value of the key is something else. A caller that
+		// reads the array itself stores it there and calls EndArray.
+		float *TripleDestination();
+
+	private:
+		bool Float(float f);
+
+		Log &tasLog;
+		PhysicsFrame *physicsFrame;
+		ParseState state;
+		bool prePlayerMove;
+
+		int arrayIndex;
+
+		// In a delta encoded log, a command frame starts out as a copy of the
+		// previous one, the pre-PM state as the previous post-PM state and the
+		// post-PM state as this pre-PM state.
+		bool deltaEncoded;
+		bool postPlayerMoveSeen;
+		ReaderCommandFrame deltaBase;
+
+		// The state that a step count in place of the rng object refers to.
+		RngState rngBase;
+		bool rngBaseSet;
+
+		const Callback callback;
+		PhysicsFrame streamedFrame;
+		FrameRecycler<PhysicsFrame> recycler;
+	};
+
+	template<typename Log>
+	InternalHandler<Log>::InternalHandler(Log &tasLog, const Callback &callback)
+		: tasLog(tasLog),
+		physicsFrame(nullptr),
+		state(StateLog),
+		deltaEncoded(false),
+		postPlayerMoveSeen(false),
+		deltaBase(),
+		rngBaseSet(false),
+		callback(callback)
+	{
+		deltaBase.entFriction = 1;
+		deltaBase.entGravity = 1;
+	}
+
+	template<typename Log>
+	bool InternalHandler<Log>::Null()
+	{
+		return false;
+	}
+
+	template<typename Log>
+	bool InternalHandler<Log>::Bool(bool b)
+	{
+		switch (state) {
+		case StateDeltaEncoded:
+			deltaEncoded = b;
+			state = StateLog;
+			break;
+		case StatePaused:
+			physicsFrame->paused = b;
+			state = StatePhysicsFrame;
+			break;
+		case StateObjectPull:
+			physicsFrame->objectMoveList.back().pull = b;
+			state = StateObjectMove;
+			break;
+		case StateOnGround: {
+			CommandFrame &frame = physicsFrame->commandFrameList.back();
+			(prePlayerMove ? frame.prePMState : frame.postPMState).onGround = b;
+			state = prePlayerMove ? StatePrePlayerMove : StatePostPlayerMove;
+			break;
+		}
+		case StateOnLadder: {
+			CommandFrame &frame = physicsFrame->commandFrameList.back();
+			(prePlayerMove ? frame.prePMState : frame.postPMState).onLadder = b;
+			state = prePlayerMove ? StatePrePlayerMove : StatePostPlayerMove;
+			break;
+		}
+		default:
+			return false;
+		}
+
+		return true;
+	}
+
+	template<typename Log>
+	bool InternalHandler<Log>::Int(int i)
+	{
+		switch (state) {
+			case StateIdum:
+				physicsFrame->rng.idum = i;
+				state = StateRng;
+				break;
+			case StateIy:
+				physicsFrame->rng.iy = i;
+				state = StateRng;
+				break;
+			case StateIv:
+				if (arrayIndex >= 32)
+					return false;
+				physicsFrame->rng.iv[arrayIndex++] = i;
+				break;
+			case StateCollisionEntity:
+				physicsFrame->commandFrameList.back().collisionList.back()
+					.entity = i;
+				state = StateCollision;
+				break;
+			default:
+				return false;
+		}
+
+		return true;
+	}
+
+	template<typename Log>
+	bool InternalHandler<Log>::Uint(unsigned i)
+	{
+		switch (state) {
+		case StateBuildNumber:
+			tasLog.buildNumber = static_cast<int32_t>(i);
+			state = StateLog;
+			break;
+		case StateClientState:
+			physicsFrame->clientState = static_cast<int8_t>(i);
+			state = StatePhysicsFrame;
+			break;
+		case StateDamageBits:
+			physicsFrame->damageList.back().damageBits = static_cast<int32_t>(i);
+			state = StateDamage;
+			break;
+		case StateMilliseconds:
+			physicsFrame->commandFrameList.back().msec = static_cast<uint8_t>(i);
+			state = StateCommandFrame;
+			break;
+		case StateFramebulkId:
+			physicsFrame->commandFrameList.back().framebulkId = i;
+			state = StateCommandFrame;
+			break;
+		case StateSharedSeed:
+			physicsFrame->commandFrameList.back().sharedSeed = i;
+			state = StateCommandFrame;
+			break;
+		case StateImpulse:
+			physicsFrame->commandFrameList.back().impulse = static_cast<uint8_t>(i);
+			state = StateCommandFrame;
+			break;
+		case StateButtons:
+			physicsFrame->commandFrameList.back().buttons = static_cast<uint8_t>(i);
+			state = StateCommandFrame;
+			break;
+		case StateWaterLevel: {
+			CommandFrame &frame = physicsFrame->commandFrameList.back();
+			(prePlayerMove ? frame.prePMState : frame.postPMState).waterLevel = static_cast<uint8_t>(i);
+			state = prePlayerMove ? StatePrePlayerMove : StatePostPlayerMove;
+			break;
+		}
+		case StateDuckState: {
+			CommandFrame &frame = physicsFrame->commandFrameList.back();
+			(prePlayerMove ? frame.prePMState : frame.postPMState).duckState = static_cast<uint8_t>(i);
+			state = prePlayerMove ? StatePrePlayerMove : StatePostPlayerMove;
+			break;
+		}
+		case StateCollisionEntity:
+			physicsFrame->commandFrameList.back().collisionList.back()
+				.entity = static_cast<int32_t>(i);
+			state = StateCollision;
+			break;
+		case StateRng:
+			if (!rngBaseSet || i > RNG_MAX_STEPS)
+				return false;
+			for (unsigned step = 0; step < i; ++step)
+				AdvanceRng(rngBase);
+			physicsFrame->rng = rngBase;
+			state = StatePhysicsFrame;
+			break;
+		case StateIdum:
+			physicsFrame->rng.idum = static_cast<int32_t>(i);
+			state = StateRng;
+			break;
+		case StateIy:
+			physicsFrame->rng.iy = static_cast<int32_t>(i);
+			state = StateRng;
+			break;
+		case StateIv:
+			if (arrayIndex >= 32)
+				return false;
+			physicsFrame->rng.iv[arrayIndex++] = static_cast<int32_t>(i);
+			break;
+		default:
+			return false;
+		}
+
+		return true;
+	}
+
+	template<typename Log>
+	bool InternalHandler<Log>::Int64(int64_t)
+	{
+		return false;
+	}
+
+	template<typename Log>
+	bool InternalHandler<Log>::Uint64(uint64_t)
+	{
+		return false;
+	}
+
+	template<typename Log>
+	bool InternalHandler<Log>::Double(double d)
+	{
+		return Float(static_cast<float>(d));
+	}
+
+	template<typename Log>
+	bool InternalHandler<Log>::Float(float f)
+	{
+		switch (state) {
+		case StateFrameTime:
+			physicsFrame->frameTime = f;
+			state = StatePhysicsFrame;
+			break;
+		case StateDamageAmount:
+			physicsFrame->damageList.back().damage = f;
+			state = StateDamage;
+			break;
+		case StateDamageDirection:
+			if (arrayIndex >= 3)
+				return false;
+			physicsFrame->damageList.back()
+				.direction[arrayIndex++] = f;
+			break;
+		case StateObjectVelocity:
+			if (arrayIndex >= 3)
+				return false;
+			physicsFrame->objectMoveList.back()
+				.velocity[arrayIndex++] = f;
+			break;
+		case StateObjectPosition:
+			if (arrayIndex >= 3)
+				return false;
+			physicsFrame->objectMoveList.back()
+				.position[arrayIndex++] = f;
+			break;
+		case StateFrameTimeRemainder:
+			physicsFrame->commandFrameList.back()
+				.frameTimeRemainder = f;
+			state = StateCommandFrame;
+			break;
+		case StateViewangles:
+			if (arrayIndex >= 3)
+				return false;
+			physicsFrame->commandFrameList.back()
+				.viewangles[arrayIndex++] = f;
+			break;
+		case StatePunchangles:
+			if (arrayIndex >= 3)
+				return false;
+			physicsFrame->commandFrameList.back()
+				.punchangles[arrayIndex++] = f;
+			break;
+		case StateFSU:
+			if (arrayIndex >= 3)
+				return false;
+			physicsFrame->commandFrameList.back()
+				.FSU[arrayIndex++] = f;
+			break;
+		case StateEntFriction:
+			physicsFrame->commandFrameList.back().entFriction = f;
+			state = StateCommandFrame;
+			break;
+		case StateEntGravity:
+			physicsFrame->commandFrameList.back().entGravity = f;
+			state = StateCommandFrame;
+			break;
+		case StateHealth:
+			physicsFrame->commandFrameList.back().health = f;
+			state = StateCommandFrame;
+			break;
+		case StateArmor:
+			physicsFrame->commandFrameList.back().armor = f;
+			state = StateCommandFrame;
+			break;
+		case StateVelocity: {
+			if (arrayIndex >= 3)
+				return false;
+			CommandFrame &frame = physicsFrame->commandFrameList.back();
+			(prePlayerMove ? frame.prePMState : frame.postPMState)
+				.velocity[arrayIndex++] = f;
+			break;
+		}
+		case StatePosition: {
+			if (arrayIndex >= 3)
+				return false;
+			CommandFrame &frame = physicsFrame->commandFrameList.back();
+			(prePlayerMove ? frame.prePMState : frame.postPMState)
+				.position[arrayIndex++] = f;
+			break;
+		}
+		case StateBaseVelocity: {
+			if (arrayIndex >= 3)
+				return false;
+			CommandFrame &frame = physicsFrame->commandFrameList.back();
+			(prePlayerMove ? frame.prePMState : frame.postPMState)
+				.baseVelocity[arrayIndex++] = f;
+			break;
+		}
+		case StateCollisionPlaneNormal:
+			if (arrayIndex >= 3)
+				return false;
+			physicsFrame->commandFrameList.back().collisionList.back()
+				.normal[arrayIndex++] = f;
+			break;
+		case StateCollisionPlaneDistance:
+			physicsFrame->commandFrameList.back().collisionList.back()
+				.distance = f;
+			state = StateCollision;
+			break;
+		case StateImpactVelocity:
+			if (arrayIndex >= 3)
+				return false;
+			physicsFrame->commandFrameList.back().collisionList.back()
+				.impactVelocity[arrayIndex++] = f;
+			break;
+		default:
+			return false;
+		}
+
+		return true;
+	}
+
+	template<typename Log>
+	float *InternalHandler<Log>::TripleDestination()
+	{
+		switch (state) {
+		case StateDamageDirection:
+			return physicsFrame->damageList.back().direction;
+		case StateObjectVelocity:
+			return physicsFrame->objectMoveList.back().velocity;
+		case StateObjectPosition:
+			return physicsFrame->objectMoveList.back().position;
+		case StateViewangles:
+			return physicsFrame->commandFrameList.back().viewangles;
+		case StatePunchangles:
+			return physicsFrame->commandFrameList.back().punchangles;
+		case StateFSU:
+			return physicsFrame->commandFrameList.back().FSU;
+		case StateVelocity: {
+			CommandFrame &frame = physicsFrame->commandFrameList.back();
+			return (prePlayerMove ? frame.prePMState : frame.postPMState).velocity;
+		}
+		case StatePosition: {
+			CommandFrame &frame = physicsFrame->commandFrameList.back();
+			return (prePlayerMove ? frame.prePMState : frame.postPMState).position;
+		}
+		case StateBaseVelocity: {
+			CommandFrame &frame = physicsFrame->commandFrameList.back();
+			return (prePlayerMove ? frame.prePMState : frame.postPMState).baseVelocity;
+		}
+		case StateCollisionPlaneNormal:
+			return physicsFrame->commandFrameList.back().collisionList.back().normal;
+		case StateImpactVelocity:
+			return physicsFrame->commandFrameList.back().collisionList.back().impactVelocity;
+		default:
+			return nullptr;
+		}
+	}
+
+	template<typename Log>
+	bool InternalHandler<Log>::RawNumber(const char *str, rapidjson::SizeType length, bool)
+	{
+		// Integers go where RapidJSON would pass them without
+		// kParseNumbersAsStringsFlag, and so do integers too large for 64 bits.
+		if (IsIntegerNumber(str, length)) {
+			const bool minus = length != 0 && str[0] == '-';
+			const char *p = str + (minus ? 1 : 0);
+			const char *const end = str + length;
+			if (p == end || (*p == '0' && end - p > 1))
+				return false;
+
+			uint64_t i = 0;
+			bool overflow = false;
+			for (; p != end; ++p) {
+				if (*p < '0' || *p > '9')
+					return false;
+				const unsigned digit = static_cast<unsigned>(*p - '0');
+				overflow |= i > (UINT64_MAX - digit) / 10;
+				i = i * 10 + digit;
+			}
+
+			if (!overflow) {
+				if (!minus && i <= UINT32_MAX)
+					return Uint(static_cast<unsigned>(i));
+				if (!minus)
+					return Uint64(i);
+				if (i <= uint64_t(1) << 31)
+					return Int(static_cast<int>(-static_cast<int64_t>(i)));
+				if (i <= uint64_t(1) << 63)
+					return Int64(static_cast<int64_t>(~i + 1));
+			}
+		}
+
+		float f;
+		if (!ParseFloat(str, length, f))
+			return false;
+		return Float(f);
+	}
+
+	template<typename Log>
+	bool InternalHandler<Log>::String(const char *str, rapidjson::SizeType length, bool)
+	{
+		switch (state) {
+		case StateToolVersion:
+			AssignString(tasLog.toolVersion, str, length);
+			state = StateLog;
+			break;
+		case StateGameMod:
+			AssignString(tasLog.gameMod, str, length);
+			state = StateLog;
+			break;
+		case StateCommandBuffer:
+			AssignString(physicsFrame->commandBuffer, str, length);
+			state = StatePhysicsFrame;
+			break;
+		case StateConsoleMessageList:
+			AssignString(recycler.AddConsolePrint(*physicsFrame), str, length);
+			break;
+		default:
+			return false;
+		}
+
+		return true;
+	}
+
+	template<typename Log>
+	bool InternalHandler<Log>::StartObject()
+	{
+		switch (state) {
+		case StateLog:
+		case StateRng:
+			break;
+		case StatePhysicsFrameList:
+			state = StatePhysicsFrame;
+			if (callback) {
+				recycler.Reset(streamedFrame);
+				physicsFrame = &streamedFrame;
+			} else {
+				tasLog.physicsFrameList.push_back(PhysicsFrame());
+				physicsFrame = &tasLog.physicsFrameList.back();
+			}
+			physicsFrame->paused = false;
+			physicsFrame->clientState = 5;
+			break;
+		case StateDamageList: {
+			state = StateDamage;
+			auto &damageList = physicsFrame->damageList;
+			damageList.push_back(ReaderDamage());
+			damageList.back().direction[0] = 0;
+			damageList.back().direction[1] = 0;
+			damageList.back().direction[2] = 0;
+			break;
+		}
+		case StateObjectMoveList: {
+			state = StateObjectMove;
+			auto &objectMoveList = physicsFrame->objectMoveList;
+			objectMoveList.push_back(ReaderObjectMove());
+			objectMoveList.back().pull = true;
+			break;
+		}
+		case StateCommandFrameList: {
+			state = StateCommandFrame;
+			CommandFrame &frame = recycler.AddCommandFrame(*physicsFrame);
+			if (deltaEncoded) {
+				CopyCommandFrameFields(frame, deltaBase);
+				frame.prePMState = deltaBase.postPMState;
+				postPlayerMoveSeen = false;
+				break;
+			}
+			frame.punchangles[0] = 0;
+			frame.punchangles[1] = 0;
+			frame.punchangles[2] = 0;
+			frame.impulse = 0;
+			frame.entFriction = 1;
+			frame.entGravity = 1;
+			break;
+		}
+		case StatePrePlayerMove: {
+			if (deltaEncoded)
+				break;
+			CommandFrame &frame = physicsFrame->commandFrameList.back();
+			frame.prePMState.baseVelocity[0] = 0;
+			frame.prePMState.baseVelocity[1] = 0;
+			frame.prePMState.baseVelocity[2] = 0;
+			frame.prePMState.onLadder = false;
+			frame.prePMState.waterLevel = 0;
+			frame.prePMState.duckState = static_cast<uint8_t>(UNDUCKED);
+			break;
+		}
+		case StatePostPlayerMove: {
+			CommandFrame &frame = physicsFrame->commandFrameList.back();
+			if (deltaEncoded) {
+				frame.postPMState = frame.prePMState;
+				postPlayerMoveSeen = true;
+				break;
+			}
+			frame.postPMState.baseVelocity[0] = 0;
+			frame.postPMState.baseVelocity[1] = 0;
+			frame.postPMState.baseVelocity[2] = 0;
+			frame.postPMState.onLadder = false;
+			frame.postPMState.waterLevel = 0;
+			frame.postPMState.duckState = static_cast<uint8_t>(UNDUCKED);
+			break;
+		}
+		case StateCollisionList: {
+			state = StateCollision;
+			physicsFrame->commandFrameList.back()
+				.collisionList.push_back(ReaderCollision());
+			break;
+		}
+		default:
+			return false;
+		}
+
+		return true;
+	}
+
+	template<typename Log>
+	bool InternalHandler<Log>::Key(const char *str, rapidjson::SizeType length, bool)
+	{
+		switch (state) {
+		case StateLog:
+			return LookupKey(KEY_TABLE_LOG, str, length, state);
+		case StatePhysicsFrame:
+			return LookupKey(KEY_TABLE_PHYSICS_FRAME, str, length, state);
+		case StateCommandFrame:
+			return LookupKey(KEY_TABLE_COMMAND_FRAME, str, length, state);
+		case StatePrePlayerMove:
+			prePlayerMove = true;
+			return LookupKey(KEY_TABLE_PLAYER, str, length, state);
+		case StatePostPlayerMove:
+			prePlayerMove = false;
+			return LookupKey(KEY_TABLE_PLAYER, str, length, state);
+		case StateDamage:
+			return LookupKey(KEY_TABLE_DAMAGE, str, length, state);
+		case StateObjectMove:
+			return LookupKey(KEY_TABLE_OBJECT_MOVE, str, length, state);
+		case StateCollision:
+			return LookupKey(KEY_TABLE_COLLISION, str, length, state);
+		case StateRng:
+			return LookupKey(KEY_TABLE_RNG, str, length, state);
+		default:
+			return false;
+		}
+	}
+
+	template<typename Log>
+	bool InternalHandler<Log>::EndObject(rapidjson::SizeType)
+	{
+		switch (state) {
+		case StateLog:
+			break;
+		case StatePhysicsFrame:
+			state = StatePhysicsFrameList;
+			if (callback && !callback(*physicsFrame))
+				return false;
+			break;
+		case StateDamage:
+			state = StateDamageList;
+			break;
+		case StateObjectMove:
+			state = StateObjectMoveList;
+			break;
+		case StateCommandFrame: {
+			state = StateCommandFrameList;
+			if (deltaEncoded) {
+				CommandFrame &frame = physicsFrame->commandFrameList.back();
+				if (!postPlayerMoveSeen)
+					frame.postPMState = frame.prePMState;
+				CopyCommandFrameFields(deltaBase, frame);
+			}
+			break;
+		}
+		case StatePrePlayerMove:
+			state = StateCommandFrame;
+			break;
+		case StatePostPlayerMove:
+			state = StateCommandFrame;
+			break;
+		case StateCollision:
+			state = StateCollisionList;
+			break;
+		case StateRng:
+			rngBase = physicsFrame->rng;
+			rngBaseSet = true;
+			state = StatePhysicsFrame;
+			break;
+		default:
+			return false;
+		}
+
+		return true;
+	}
+
+	template<typename Log>
+	bool InternalHandler<Log>::StartArray()
+	{
+		switch (state) {
+		case StatePhysicsFrameList:
+			if (!callback)
+				tasLog.physicsFrameList.reserve(10000);
+			break;
+		case StateDamageList:
+			break;
+		case StateDamageDirection:
+			arrayIndex = 0;
+			break;
+		case StateObjectMoveList:
+			break;
+		case StateObjectVelocity:
+			arrayIndex = 0;
+			break;
+		case StateObjectPosition:
+			arrayIndex = 0;
+			break;
+		case StateCommandFrameList:
+			break;
+		case StateViewangles:
+			arrayIndex = 0;
+			break;
+		case StatePunchangles:
+			arrayIndex = 0;
+			break;
+		case StateFSU:
+			arrayIndex = 0;
+			break;
+		case StateVelocity:
+			arrayIndex = 0;
+			break;
+		case StatePosition:
+			arrayIndex = 0;
+			break;
+		case StateBaseVelocity:
+			arrayIndex = 0;
+			break;
+		case StateConsoleMessageList:
+			break;
+		case StateCollisionList:
+			break;
+		case StateCollisionPlaneNormal:
+			arrayIndex = 0;
+			break;
+		case StateImpactVelocity:
+			arrayIndex = 0;
+			break;
+		case StateIv:
+			arrayIndex = 0;
+			break;
+		default:
+			return false;
+		}
+
+		return true;
+	}
+
+	template<typename Log>
+	bool InternalHandler<Log>::EndArray(rapidjson::SizeType)
+	{
+		switch (state) {
+		case StatePhysicsFrameList:
+			state = StateLog;
+			break;
+		case StateDamageList:
+			state = StatePhysicsFrame;
+			break;
+		case StateDamageDirection:
+			state = StateDamage;
+			break;
+		case StateObjectMoveList:
+			state = StatePhysicsFrame;
+			break;
+		case StateObjectVelocity:
+			state = StateObjectMove;
+			break;
+		case StateObjectPosition:
+			state = StateObjectMove;
+			break;
+		case StateCommandFrameList:
+			state = StatePhysicsFrame;
+			break;
+		case StateViewangles:
+			state = StateCommandFrame;
+			break;
+		case StatePunchangles:
+			state = StateCommandFrame;
+			break;
+		case StateFSU:
+			state = StateCommandFrame;
+			break;
+		case StateVelocity:
+			state = prePlayerMove ? StatePrePlayerMove : StatePostPlayerMove;
+			break;
+		case StatePosition:
+			state = prePlayerMove ? StatePrePlayerMove : StatePostPlayerMove;
+			break;
+		case StateBaseVelocity:
+			state = prePlayerMove ? StatePrePlayerMove : StatePostPlayerMove;
+			break;
+		case StateConsoleMessageList:
+			state = StatePhysicsFrame;
+			break;
+		case StateCollisionList:
+			state = StateCommandFrame;
+			break;
+		case StateCollisionPlaneNormal:
+			state = StateCollision;
+			break;
+		case StateImpactVelocity:
+			state = StateCollision;
+			break;
+		case StateIv:
+			state = StateRng;
+			break;
+		default:
+			return false;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,370 @@
+#include <cstdint>
+#include <cstring>
+#include "rapidjson/memorystream.h"
+#include "taslogger/lazy_log.hpp"
+#include "compression.hpp"
+#include "file_mapping.hpp"
+#include "internal_handler.hpp"
+
+using namespace TASLogger;
+
+// Converts the build number the same way as the full parse, through RapidJSON.
+class NumberHandler
+{
+public:
+	NumberHandler() : value(0) {}
+
+	bool Null() { return false; }
+	bool Bool(bool) { return false; }
+	bool Int(int i) { value = i; return true; }
+	bool Uint(unsigned i) { value = i; return true; }
+	bool Int64(int64_t i) { value = static_cast<double>(i); return true; }
+	bool Uint64(uint64_t i) { value = static_cast<double>(i); return true; }
+	bool Double(double d) { value = d; return true; }
+	bool RawNumber(const char *, rapidjson::SizeType, bool) { return false; }
+	bool String(const char *, rapidjson::SizeType, bool) { return false; }
+	bool StartObject() { return false; }
+	bool Key(const char *, rapidjson::SizeType, bool) { return false; }
+	bool EndObject(rapidjson::SizeType) { return false; }
+	bool StartArray() { return false; }
+	bool EndArray(rapidjson::SizeType) { return false; }
+
+	double value;
+};
+
+static bool ParseNumber(const char *str, rapidjson::SizeType length, double &value)
+{
+	rapidjson::MemoryStream ms(str, length);
+	NumberHandler handler;
+	rapidjson::Reader reader;
+	if (reader.Parse(ms, handler).IsError())
+		return false;
+	value = handler.value;
+	return true;
+}
+
+// Records the header and the summaries of the physics frames. The numbers are
+// passed as strings, and only the frame times and the build number are
+// converted.
+class SummaryHandler
+{
+public:
+	SummaryHandler(const rapidjson::MemoryStream &stream, std::string &toolVersion, std::string &gameMod, int32_t &buildNumber, std::vector<PhysicsFrameSummary> &summaries)
+		: stream(stream),
+		toolVersion(toolVersion),
+		gameMod(gameMod),
+		buildNumber(buildNumber),
+		summaries(summaries),
+		next(KindOther),
+		deltaEncoded(false)
+	{
+	}
+
+	bool Null() { return Value(); }
+	bool Int(int) { return Value(); }
+	bool Uint(unsigned) { return Value(); }
+	bool Int64(int64_t) { return Value(); }
+	bool Uint64(uint64_t) { return Value(); }
+	bool Double(double) { return Value(); }
+
+	bool Bool(bool b)
+	{
+		if (next == KindDeltaEncoded && b) {
+			deltaEncoded = true;
+			return false;
+		}
+		return Value();
+	}
+
+	bool RawNumber(const char *str, rapidjson::SizeType length, bool)
+	{
+		if (next == KindFrameTime) {
+			if (!ParseFloat(str, length, summary.frameTime))
+				return false;
+		} else if (next == KindBuildNumber) {
+			double value;
+			if (!ParseNumber(str, length, value))
+				return false;
+			buildNumber = static_cast<int32_t>(value);
+		}
+		return Value();
+	}
+
+	bool String(const char *str, rapidjson::SizeType length, bool)
+	{
+		if (next == KindToolVersion)
+			toolVersion.assign(str, length);
+		else if (next == KindGameMod)
+			gameMod.assign(str, length);
+		return Value();
+	}
+
+	bool StartObject()
+	{
+		if (kinds.empty()) {
+			kinds.push_back(KindLog);
+		} else if (kinds.back() == KindFrameList) {
+			summary = PhysicsFrameSummary();
+			summary.offset = stream.Tell() - 1;
+			kinds.push_back(KindFrame);
+		} else if (kinds.back() == KindCommandFrameList) {
+			++summary.commandFrameCount;
+			kinds.push_back(KindCommandFrame);
+		} else {
+			kinds.push_back(KindOther);
+		}
+		next = KindOther;
+		return true;
+	}
+
+	bool Key(const char *str, rapidjson::SizeType length, bool)
+	{
+		next = KindOther;
+		switch (kinds.back()) {
+		case KindLog:
+			if (IsKey(str, length, KEY_TOOL_VERSION))
+				next = KindToolVersion;
+			else if (IsKey(str, length, KEY_MOD))
+				next = KindGameMod;
+			else if (IsKey(str, length, KEY_BUILD_NUMBER))
+				next = KindBuildNumber;
+			else if (IsKey(str, length, KEY_DELTA_ENCODED))
+				next = KindDeltaEncoded;
+			else if (IsKey(str, length, KEY_PHYSICS_FRAMES))
+				next = KindFrameList;
+			break;
+		case KindFrame:
+			if (IsKey(str, length, KEY_FRAMETIME))
+				next = KindFrameTime;
+			else if (IsKey(str, length, KEY_COMMAND_FRAMES))
+				next = KindCommandFrameList;
+			else if (IsKey(str, length, KEY_CONSOLE_MESSAGES))
+				next = KindConsoleMessages;
+			else if (IsKey(str, length, KEY_DAMAGES))
+				next = KindDamages;
+			break;
+		case KindCommandFrame:
+			if (IsKey(str, length, KEY_COLLISIONS))
+				next = KindCollisions;
+			break;
+		default:
+			break;
+		}
+		return true;
+	}
+
+	bool EndObject(rapidjson::SizeType)
+	{
+		if (kinds.back() == KindFrame) {
+			const uint64_t length = stream.Tell() - summary.offset;
+			if (length > UINT32_MAX)
+				return false;
+			summary.length = static_cast<uint32_t>(length);
+			summaries.push_back(summary);
+		}
+		kinds.pop_back();
+		return true;
+	}
+
+	bool StartArray()
+	{
+		switch (next) {
+		case KindFrameList:
+		case KindCommandFrameList:
+		case KindConsoleMessages:
+		case KindDamages:
+		case KindCollisions:
+			kinds.push_back(next);
+			break;
+		default:
+			kinds.push_back(KindOther);
+			break;
+		}
+		next = KindOther;
+		return true;
+	}
+
+	bool EndArray(rapidjson::SizeType elementCount)
+	{
+		if (elementCount != 0) {
+			switch (kinds.back()) {
+			case KindConsoleMessages:
+				summary.hasConsoleMessages = true;
+				break;
+			case KindDamages:
+				summary.hasDamages = true;
+				break;
+			case KindCollisions:
+				summary.hasCollisions = true;
+				break;
+			default:
+				break;
+			}
+		}
+		kinds.pop_back();
+		return true;
+	}
+
+	inline bool DeltaEncoded() const { return deltaEncoded; }
+
+private:
+	enum Kind : uint8_t
+	{
+		KindOther,
+		KindLog,
+		KindToolVersion,
+		KindGameMod,
+		KindBuildNumber,
+		KindDeltaEncoded,
+		KindFrameList,
+		KindFrame,
+		KindFrameTime,
+		KindCommandFrameList,
+		KindCommandFrame,
+		KindConsoleMessages,
+		KindDamages,
+		KindCollisions
+	};
+
+	inline bool Value()
+	{
+		next = KindOther;
+		return true;
+	}
+
+	const rapidjson::MemoryStream &stream;
+	std::string &toolVersion;
+	std::string &gameMod;
+	int32_t &buildNumber;
+	std::vector<PhysicsFrameSummary> &summaries;
+
+	// Containers that are open, and what the value after the last key is.
+	std::vector<Kind> kinds;
+	Kind next;
+	PhysicsFrameSummary summary;
+	bool deltaEncoded;
+};
+
+// Includes the buffers that the frame owns.
+static size_t EstimateSize(const ReaderPhysicsFrame &frame)
+{
+	size_t size = sizeof(frame) + frame.commandBuffer.capacity();
+	size += frame.consolePrintList.capacity() * sizeof(std::string);
+	for (const std::string &message : frame.consolePrintList)
+		size += message.capacity();
+	size += frame.commandFrameList.capacity() * sizeof(ReaderCommandFrame);
+	for (const ReaderCommandFrame &commandFrame : frame.commandFrameList)
+		size += commandFrame.collisionList.capacity() * sizeof(ReaderCollision);
+	size += frame.damageList.capacity() * sizeof(ReaderDamage);
+	size += frame.objectMoveList.capacity() * sizeof(ReaderObjectMove);
+	return size;
+}
+
+LazyTASLog::LazyTASLog()
+	: mapping(nullptr), buildNumber(0), cacheCapacity(DEFAULT_CACHE_CAPACITY), stats()
+{
+}
+
+LazyTASLog::~LazyTASLog()
+{
+	Close();
+}
+
+rapidjson::ParseResult LazyTASLog::Open(const char *filename)
+{
+	Close();
+
+	mapping = new FileMapping;
+	if (!mapping->Open(filename)) {
+		Close();
+		return rapidjson::ParseResult(rapidjson::kParseErrorDocumentEmpty, 0);
+	}
+	const char *data = mapping->Data();
+	if (data[0] == BINARY_MAGIC[0] || static_cast<unsigned char>(data[0]) == ZSTD_MAGIC_BYTE) {
+		Close();
+		return rapidjson::ParseResult(rapidjson::kParseErrorValueInvalid, 0);
+	}
+
+	rapidjson::MemoryStream ms(data, mapping->Size());
+	SummaryHandler handler(ms, toolVersion, gameMod, buildNumber, summaries);
+	rapidjson::Reader reader;
+	const rapidjson::ParseResult res = reader.Parse<rapidjson::kParseNumbersAsStringsFlag>(ms, handler);
+	if (handler.DeltaEncoded()) {
+		Close();
+		return rapidjson::ParseResult(rapidjson::kParseErrorValueInvalid, 0);
+	}
+	if (res.IsError())
+		Close();
+	return res;
+}
+
+void LazyTASLog::Close()
+{
+	delete mapping;
+	mapping = nullptr;
+	toolVersion.clear();
+	gameMod.clear();
+	buildNumber = 0;
+	summaries.clear();
+	cache.clear();
+	recentlyUsed.clear();
+	stats = LazyCacheStats();
+}
+
+std::shared_ptr<const ReaderPhysicsFrame> LazyTASLog::PhysicsFrame(size_t index)
+{
+	if (index >= summaries.size())
+		return nullptr;
+
+	const auto cached = cache.find(index);
+	if (cached != cache.end()) {
+		++stats.hits;
+		recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, cached->second.use);
+		return cached->second.frame;
+	}
+	++stats.misses;
+
+	// The frame is parsed as the only one of a cut out physics frame list.
+	const PhysicsFrameSummary &summary = summaries[index];
+	TASLog frameLog;
+	InternalHandler<TASLog> handler(frameLog);
+	handler.StartInPhysicsFrameList();
+	rapidjson::MemoryStream ms(mapping->Data() + summary.offset, summary.length);
+	rapidjson::Reader reader;
+	if (reader.Parse<HANDLER_PARSE_FLAGS>(ms, handler).IsError() || frameLog.physicsFrameList.size() != 1)
+		return nullptr;
+
+	const std::shared_ptr<const ReaderPhysicsFrame> frame = std::make_shared<ReaderPhysicsFrame>(std::move(frameLog.physicsFrameList[0]));
+	recentlyUsed.push_front(index);
+	CacheEntry &entry = cache[index];
+	entry.frame = frame;
+	entry.use = recentlyUsed.begin();
+	entry.size = EstimateSize(*frame);
+	stats.cachedBytes += entry.size;
+	Evict();
+	return frame;
+}
+
+void LazyTASLog::SetCacheCapacity(size_t bytes)
+{
+	cacheCapacity = bytes;
+	Evict();
+}
+
+LazyCacheStats LazyTASLog::GetCacheStats() const
+{
+	LazyCacheStats result = stats;
+	result.cachedFrames = cache.size();
+	return result;
+}
+
+void LazyTASLog::Evict()
+{
+	while (stats.cachedBytes > cacheCapacity && cache.size() > 1) {
+		const auto entry = cache.find(recentlyUsed.back());
+		stats.cachedBytes -= entry->second.size;
+		cache.erase(entry);
+		recentlyUsed.pop_back();
+		++stats.evictions;
+	}
+}
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include "rapidjson/memorystream.h"
+#include "taslogger/reader.hpp"
+#include "internal_handler.hpp"
+
+using namespace TASLogger;
+
+static uint64_t GetLittleEndian(const char *data, size_t size)
+{
+	uint64_t value = 0;
+	for (size_t i = 0; i < size; ++i)
+		value |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+	return value;
+}
+
+static bool ReadAt(FILE *file, uint64_t offset, char *dest, size_t size)
+{
+#ifdef _WIN32
+	if (_fseeki64(file, static_cast<__int64>(offset), SEEK_SET) != 0)
+		return false;
+#else
+	if (fseeko(file, static_cast<off_t>(offset), SEEK_SET) != 0)
+		return false;
+#endif
+	return std::fread(dest, 1, size, file) == size;
+}
+
+LogIndex::LogIndex()
+	: physicsFrameListEnd(0), flags(0)
+{
+}
+
+bool LogIndex::Load(FILE *indexFile)
+{
+	physicsFrameOffsets.clear();
+	framebulks.clear();
+
+	std::vector<char> data;
+	char buf[65536];
+	size_t n;
+	while ((n = std::fread(buf, 1, sizeof(buf), indexFile)) != 0)
+		data.insert(data.end(), buf, buf + n);
+
+	const size_t headerSize = INDEX_MAGIC_LENGTH + 2 + 3 * 8;
+	if (data.size() < headerSize
+		|| std::memcmp(data.data(), INDEX_MAGIC, INDEX_MAGIC_LENGTH) != 0
+		|| static_cast<uint8_t>(data[INDEX_MAGIC_LENGTH]) != INDEX_VERSION)
+		return false;
+
+	const char *p = data.data() + INDEX_MAGIC_LENGTH + 1;
+	flags = static_cast<uint8_t>(*p++);
+	const uint64_t physicsFrameCount = GetLittleEndian(p, 8);
+	const uint64_t framebulkCount = GetLittleEndian(p + 8, 8);
+	physicsFrameListEnd = GetLittleEndian(p + 16, 8);
+	p += 24;
+
+	if (physicsFrameCount > (data.size() - headerSize) / 8
+		|| framebulkCount != (data.size() - headerSize - physicsFrameCount * 8) / 12)
+		return false;
+
+	physicsFrameOffsets.resize(static_cast<size_t>(physicsFrameCount));
+	for (uint64_t &offset : physicsFrameOffsets) {
+		offset = GetLittleEndian(p, 8);
+		p += 8;
+	}
+
+	framebulks.resize(static_cast<size_t>(framebulkCount));
+	for (auto &framebulk : framebulks) {
+		framebulk.first = static_cast<uint32_t>(GetLittleEndian(p, 4));
+		framebulk.second = GetLittleEndian(p + 4, 8);
+		p += 12;
+	}
+
+	// Framebulk ids may repeat, keep the first physics frame of each.
+	std::stable_sort(framebulks.begin(), framebulks.end(),
+		[](const std::pair<uint32_t, uint64_t> &a, const std::pair<uint32_t, uint64_t> &b) { return a.first < b.first; });
+	framebulks.erase(std::unique(framebulks.begin(), framebulks.end(),
+		[](const std::pair<uint32_t, uint64_t> &a, const std::pair<uint32_t, uint64_t> &b) { return a.first == b.first; }),
+		framebulks.end());
+	return true;
+}
+
+size_t LogIndex::FindFramebulk(uint32_t framebulkId) const
+{
+	const auto it = std::lower_bound(framebulks.begin(), framebulks.end(), framebulkId,
+		[](const std::pair<uint32_t, uint64_t> &framebulk, uint32_t id) { return framebulk.first < id; });
+	if (it == framebulks.end() || it->first != framebulkId)
+		return PhysicsFrameCount();
+	return static_cast<size_t>(it->second);
+}
+
+// Streams the log from the start and keeps the frames of the range.
+static rapidjson::ParseResult ParseRangeSequential(FILE *file, size_t first, size_t count, TASLog &tasLog)
+{
+	std::rewind(file);
+
+	size_t frame = 0;
+	const rapidjson::ParseResult res = ParseFile(file, tasLog, [&](const ReaderPhysicsFrame &physicsFrame) {
+		if (frame >= first && frame < first + count)
+			tasLog.physicsFrameList.push_back(physicsFrame);
+		return ++frame < first + count;
+	});
+	if (res.Code() == rapidjson::kParseErrorTermination && frame >= first + count)
+		return rapidjson::ParseResult();
+	return res;
+}
+
+rapidjson::ParseResult TASLogger::ParseFileRange(FILE *file, const LogIndex &index, size_t first, size_t count, TASLog &tasLog)
+{
+	const size_t physicsFrameCount = index.PhysicsFrameCount();
+	first = std::min(first, physicsFrameCount);
+	count = std::min(count, physicsFrameCount - first);
+
+	if (index.flags & (INDEX_COMPRESSED | INDEX_DELTA_ENCODED))
+		return ParseRangeSequential(file, first, count, tasLog);
+
+	// Splice the header, which ends with the start of the physics frame list,
+	// the physics frames of the range and the end of the list and the log.
+	const uint64_t headerEnd = physicsFrameCount != 0 ? index.physicsFrameOffsets[0] : index.physicsFrameListEnd;
+	uint64_t rangeBegin = headerEnd;
+	uint64_t rangeEnd = headerEnd;
+	if (count != 0) {
+		rangeBegin = index.physicsFrameOffsets[first];
+		// Leave out the comma in front of the next physics frame.
+		rangeEnd = first + count < physicsFrameCount ? index.physicsFrameOffsets[first + count] - 1 : index.physicsFrameListEnd;
+	}
+	if (rangeBegin < headerEnd || rangeEnd < rangeBegin)
+		return rapidjson::ParseResult(rapidjson::kParseErrorValueInvalid, 0);
+
+	const size_t headerSize = static_cast<size_t>(headerEnd);
+	const size_t rangeSize = static_cast<size_t>(rangeEnd - rangeBegin);
+	std::string json(headerSize + rangeSize + 2, '\0');
+	if (!ReadAt(file, 0, &json[0], headerSize) || !ReadAt(file, rangeBegin, &json[headerSize], rangeSize))
+		return rapidjson::ParseResult(rapidjson::kParseErrorDocumentEmpty, 0);
+	json[headerSize + rangeSize] = ']';
+	json[headerSize + rangeSize + 1] = '}';
+
+	tasLog = TASLog();
+
+	rapidjson::MemoryStream ms(json.data(), json.size());
+	InternalHandler<TASLog> internalHandler(tasLog);
+	rapidjson::Reader reader;
+	return reader.Parse<HANDLER_PARSE_FLAGS>(ms, internalHandler);
+}
@@ -0,0 +1,304 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include "rapidjson/filereadstream.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "taslogger/manifest.hpp"
+#include "taslogger/reader.hpp"
+#include "internal_handler.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+using namespace TASLogger;
+
+class ManifestHandler
+{
+public:
+	explicit ManifestHandler(LogManifest &manifest) : manifest(manifest), state(StateStart) {}
+
+	bool Null() { return false; }
+	bool Double(double) { return false; }
+	bool RawNumber(const char *, rapidjson::SizeType, bool) { return false; }
+
+	bool Bool(bool b)
+	{
+		if (state != StateComplete)
+			return false;
+		manifest.complete = b;
+		state = StateManifest;
+		return true;
+	}
+
+	bool Int(int i)
+	{
+		if (state != StateBuildNumber)
+			return false;
+		manifest.buildNumber = i;
+		state = StateManifest;
+		return true;
+	}
+
+	bool Uint(unsigned i) { return Uint64(i); }
+
+	bool Int64(int64_t i)
+	{
+		if (i < 0)
+			return false;
+		return Uint64(static_cast<uint64_t>(i));
+	}
+
+	bool Uint64(uint64_t i)
+	{
+		if (state == StateBuildNumber && i <= INT32_MAX)
+			return Int(static_cast<int>(i));
+		if (state != StateSegmentPhysicsFrames)
+			return false;
+		manifest.segments.back().physicsFrames = i;
+		state = StateSegment;
+		return true;
+	}
+
+	bool String(const char *str, rapidjson::SizeType length, bool)
+	{
+		switch (state) {
+		case StateToolVersion:
+			manifest.toolVersion.assign(str, length);
+			state = StateManifest;
+			return true;
+		case StateGameMod:
+			manifest.gameMod.assign(str, length);
+			state = StateManifest;
+			return true;
+		case StateSegmentFile:
+			manifest.segments.back().filename.assign(str, length);
+			state = StateSegment;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	bool StartObject()
+	{
+		if (state == StateStart) {
+			state = StateManifest;
+			return true;
+		}
+		if (state == StateSegmentList) {
+			LogSegment segment = LogSegment();
+			manifest.segments.push_back(segment);
+			state = StateSegment;
+			return true;
+		}
+		return false;
+	}
+
+	bool Key(const char *str, rapidjson::SizeType length, bool)
+	{
+		if (state == StateManifest) {
+			if (IsKey(str, length, KEY_TOOL_VERSION))
+				state = StateToolVersion;
+			else if (IsKey(str, length, KEY_BUILD_NUMBER))
+				state = StateBuildNumber;
+			else if (IsKey(str, length, KEY_MOD))
+				state = StateGameMod;
+			else if (IsKey(str, length, KEY_SEGMENTS))
+				state = StateSegments;
+			else if (IsKey(str, length, KEY_COMPLETE))
+				state = StateComplete;
+			else
+				return false;
+			return true;
+		}
+		if (state == StateSegment) {
+			if (IsKey(str, length, KEY_SEGMENT_FILE))
+				state = StateSegmentFile;
+			else if (IsKey(str, length, KEY_SEGMENT_PHYSICS_FRAMES))
+				state = StateSegmentPhysicsFrames;
+			else
+				return false;
+			return true;
+		}
+		return false;
+	}
+
+	bool EndObject(rapidjson::SizeType)
+	{
+		if (state == StateSegment) {
+			state = StateSegmentList;
+			return true;
+		}
+		if (state == StateManifest) {
+			state = StateEnd;
+			return true;
+		}
+		return false;
+	}
+
+	bool StartArray()
+	{
+		if (state != StateSegments)
+			return false;
+		state = StateSegmentList;
+		return true;
+	}
+
+	bool EndArray(rapidjson::SizeType)
+	{
+		if (state != StateSegmentList)
+			return false;
+		state = StateManifest;
+		return true;
+	}
+
+private:
+	enum State
+	{
+		StateStart,
+		StateManifest,
+		StateToolVersion,
+		StateBuildNumber,
+		StateGameMod,
+		StateComplete,
+		StateSegments,
+		StateSegmentList,
+		StateSegment,
+		StateSegmentFile,
+		StateSegmentPhysicsFrames,
+		StateEnd
+	};
+
+	LogManifest &manifest;
+	State state;
+};
+
+bool TASLogger::LoadManifest(const char *path, LogManifest &manifest)
+{
+	manifest = LogManifest();
+
+	FILE *file = std::fopen(path, "rb");
+	if (!file)
+		return false;
+
+	char buf[4096];
+	rapidjson::FileReadStream fs(file, buf, sizeof(buf));
+	ManifestHandler handler(manifest);
+	rapidjson::Reader reader;
+	const bool ok = !reader.Parse(fs, handler).IsError();
+	std::fclose(file);
+	return ok;
+}
+
+bool TASLogger::SaveManifest(const char *path, const LogManifest &manifest)
+{
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+	writer.StartObject();
+	writer.Key(KEY_TOOL_VERSION);
+	writer.String(manifest.toolVersion.c_str(), static_cast<rapidjson::SizeType>(manifest.toolVersion.size()));
+	writer.Key(KEY_BUILD_NUMBER);
+	writer.Int(manifest.buildNumber);
+	writer.Key(KEY_MOD);
+	writer.String(manifest.gameMod.c_str(), static_cast<rapidjson::SizeType>(manifest.gameMod.size()));
+	writer.Key(KEY_SEGMENTS);
+	writer.StartArray();
+	for (const LogSegment &segment : manifest.segments) {
+		writer.StartObject();
+		writer.Key(KEY_SEGMENT_FILE);
+		writer.String(segment.filename.c_str(), static_cast<rapidjson::SizeType>(segment.filename.size()));
+		writer.Key(KEY_SEGMENT_PHYSICS_FRAMES);
+		writer.Uint64(segment.physicsFrames);
+		writer.EndObject();
+	}
+	writer.EndArray();
+	writer.Key(KEY_COMPLETE);
+	writer.Bool(manifest.complete);
+	writer.EndObject();
+
+	// Written next to the manifest and renamed over it.
+	const std::string tempPath = std::string(path) + ".tmp";
+	FILE *file = std::fopen(tempPath.c_str(), "wb");
+	if (!file)
+		return false;
+	const bool written = std::fwrite(buffer.GetString(), 1, buffer.GetSize(), file) == buffer.GetSize();
+	if (std::fclose(file) != 0 || !written) {
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+#ifdef _WIN32
+	return MoveFileExA(tempPath.c_str(), path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return std::rename(tempPath.c_str(), path) == 0;
+#endif
+}
+
+std::string TASLogger::SegmentPath(const char *manifestPath, const LogSegment &segment)
+{
+	const char *end = std::strrchr(manifestPath, '/');
+#ifdef _WIN32
+	const char *backslash = std::strrchr(manifestPath, '\\');
+	if (backslash && (!end || backslash > end))
+		end = backslash;
+#endif
+	if (!end)
+		return segment.filename;
+	return std::string(manifestPath, end + 1) + segment.filename;
+}
+
+// Takes the header from the manifest and calls parse with every segment file
+// in order.
+template<typename Parse>
+static rapidjson::ParseResult ParseSegments(const char *manifestPath, TASLog &header, Parse parse)
+{
+	LogManifest manifest;
+	if (!LoadManifest(manifestPath, manifest))
+		return rapidjson::ParseResult(rapidjson::kParseErrorValueInvalid, 0);
+
+	header = TASLog();
+	header.toolVersion = manifest.toolVersion;
+	header.gameMod = manifest.gameMod;
+	header.buildNumber = manifest.buildNumber;
+
+	for (const LogSegment &segment : manifest.segments) {
+		FILE *file = std::fopen(SegmentPath(manifestPath, segment).c_str(), "rb");
+		if (!file)
+			return rapidjson::ParseResult(rapidjson::kParseErrorDocumentEmpty, 0);
+		const rapidjson::ParseResult res = parse(file);
+		std::fclose(file);
+		if (res.IsError())
+			return res;
+	}
+
+	return rapidjson::ParseResult();
+}
+
+rapidjson::ParseResult TASLogger::ParseSegmentedLog(const char *manifestPath, TASLog &tasLog)
+{
+	TASLog segmentLog;
+	return ParseSegments(manifestPath, tasLog, [&](FILE *file) -> rapidjson::ParseResult {
+		const rapidjson::ParseResult res = ParseFile(file, segmentLog);
+		auto &frames = segmentLog.physicsFrameList;
+		if (res.IsError())
+			return res;
+		if (tasLog.physicsFrameList.empty())
+			tasLog.physicsFrameList.swap(frames);
+		else
+			tasLog.physicsFrameList.insert(tasLog.physicsFrameList.end(),
+				std::make_move_iterator(frames.begin()), std::make_move_iterator(frames.end()));
+		return res;
+	});
+}
+
+rapidjson::ParseResult TASLogger::ParseSegmentedLog(const char *manifestPath, TASLog &header, const PhysicsFrameCallback &callback)
+{
+	TASLog segmentHeader;
+	return ParseSegments(manifestPath, header, [&](FILE *file) {
+		return ParseFile(file, segmentHeader, callback);
+	});
+}
@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include "taslogger/output_sink.hpp"
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace TASLogger;
+
+#ifndef _WIN32
+// Pipes and sockets cannot be synced, which is not an error.
+static bool SyncFd(int fd)
+{
+#ifdef __APPLE__
+	// No fdatasync.
+	const int result = fsync(fd);
+#else
+	const int result = fdatasync(fd);
+#endif
+	return result == 0 || errno == EINVAL;
+}
+#endif
+
+bool FileSink::Write(const char *data, size_t size)
+{
+	if (!file)
+		return false;
+	return std::fwrite(data, 1, size, file) == size;
+}
+
+bool FileSink::Flush()
+{
+	if (!file)
+		return false;
+	return std::fflush(file) == 0;
+}
+
+// Syncs the file descriptor, not the FILE buffer, which Flush empties.
+bool FileSink::Sync()
+{
+	if (!file)
+		return false;
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return SyncFd(fileno(file));
+#endif
+}
+
+bool FdSink::Write(const char *data, size_t size)
+{
+	while (size != 0) {
+#ifdef _WIN32
+		const int n = _write(fd, data, static_cast<unsigned>(std::min<size_t>(size, 1 << 30)));
+#else
+		const ssize_t n = write(fd, data, size);
+#endif
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		data += n;
+		size -= static_cast<size_t>(n);
+	}
+	return true;
+}
+
+bool FdSink::Sync()
+{
+#ifdef _WIN32
+	return _commit(fd) == 0;
+#else
+	return SyncFd(fd);
+#endif
+}
+
+MemorySink::MemorySink()
+	: size(0), capacity(0)
+{
+}
+
+bool MemorySink::Write(const char *data, size_t size)
+{
+	size_t available;
+	char *dest = Reserve(size, available);
+	std::memcpy(dest, data, size);
+	return Commit(size);
+}
+
+char *MemorySink::Reserve(size_t minSize, size_t &size)
+{
+	if (capacity - this->size < minSize) {
+		const size_t newCapacity = std::max(capacity * 2, this->size + minSize);
+		char *newData = new char[newCapacity];
+		if (this->size != 0)
+			std::memcpy(newData, data.get(), this->size);
+		data.reset(newData);
+		capacity = newCapacity;
+	}
+
+	size = capacity - this->size;
+	return data.get() + this->size;
+}
+
+bool MemorySink::Commit(size_t size)
+{
+	this->size += size;
+	return true;
+}
+
+void MemorySink::Clear()
+{
+	size = 0;
+}
+
+MappedFileSink::MappedFileSink(size_t growSize)
+	:
+#ifdef _WIN32
+	file(INVALID_HANDLE_VALUE),
+	mapping(nullptr),
+#else
+	fd(-1),
+#endif
+	data(nullptr),
+	size(0),
+	mappedSize(0),
+	growSize(std::max<size_t>(growSize, 65536))
+{
+}
+
+MappedFileSink::~MappedFileSink()
+{
+	Finish();
+}
+
+bool MappedFileSink::Open(const char *filename)
+{
+	Finish();
+
+#ifdef _WIN32
+	file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+#else
+	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1)
+		return false;
+#endif
+
+	size = 0;
+	return Map(growSize);
+}
+
+// Replaces the mapping with a larger one that has room for minSize more bytes.
+bool MappedFileSink::Map(size_t minSize)
+{
+	std::lock_guard<std::mutex> lock(mappingMutex);
+	Unmap();
+	const size_t newSize = std::max(mappedSize + growSize, size + minSize);
+
+#ifdef _WIN32
+	const uint64_t size64 = newSize;
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64), nullptr);
+	if (!mapping)
+		return false;
+	data = static_cast<char *>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, newSize));
+	if (!data) {
+		CloseHandle(mapping);
+		mapping = nullptr;
+		return false;
+	}
+#else
+	if (ftruncate(fd, static_cast<off_t>(newSize)) != 0)
+		return false;
+	void *p = mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		return false;
+	data = static_cast<char *>(p);
+#endif
+
+	mappedSize = newSize;
+	return true;
+}
+
+void MappedFileSink::Unmap()
+{
+	if (!data)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(mapping);
+	mapping = nullptr;
+#else
+	munmap(data, mappedSize);
+#endif
+	data = nullptr;
+}
+
+bool MappedFileSink::Write(const char *data, size_t size)
+{
+	size_t available;
+	char *dest = Reserve(size, available);
+	if (!dest)
+		return false;
+	std::memcpy(dest, data, size);
+	return Commit(size);
+}
+
+char *MappedFileSink::Reserve(size_t minSize, size_t &size)
+{
+	if (!data || mappedSize - this->size < minSize) {
+		if (!Map(minSize))
+			return nullptr;
+	}
+
+	size = mappedSize - this->size;
+	return data + this->size;
+}
+
+bool MappedFileSink::Commit(size_t size)
+{
+	this->size += size;
+	return true;
+}
+
+// Flushes the whole mapping, since pages that were not written are not
+// dirty. Pages of earlier mappings are flushed with the file.
+bool MappedFileSink::Sync()
+{
+	std::lock_guard<std::mutex> lock(mappingMutex);
+#ifdef _WIN32
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	if (data && !FlushViewOfFile(data, 0))
+		return false;
+	return FlushFileBuffers(file) != 0;
+#else
+	if (fd == -1)
+		return false;
+	if (data && msync(data, mappedSize, MS_SYNC) != 0)
+		return false;
+	return SyncFd(fd);
+#endif
+}
+
+bool MappedFileSink::Finish()
+{
+	std::lock_guard<std::mutex> lock(mappingMutex);
+	Unmap();
+
+	// Cut off the unused part of the last mapping.
+	bool ok = true;
+#ifdef _WIN32
+	if (file == INVALID_HANDLE_VALUE)
+		return true;
+	LARGE_INTEGER end;
+	end.QuadPart = static_cast<LONGLONG>(size);
+	ok = SetFilePointerEx(file, end, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+	CloseHandle(file);
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (fd == -1)
+		return true;
+	ok = ftruncate(fd, static_cast<off_t>(size)) == 0;
+	close(fd);
+	fd = -1;
+#endif
+
+	mappedSize = 0;
+	return ok;
+}
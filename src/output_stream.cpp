@@ -0,0 +1,344 @@
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "taslogger/output_stream.hpp"
+#include "compression.hpp"
+
+using namespace TASLogger;
+
+// Full buffers waiting for the helper thread before Submit blocks.
+static const size_t MAX_QUEUED_BUFFERS = 8;
+
+namespace TASLogger
+{
+	// Syncs the sink on request, so that the thread that writes never waits
+	// for the disk. Requests made while a sync is running are combined into
+	// one more sync.
+	class SyncThread
+	{
+	public:
+		explicit SyncThread(OutputSink &sink);
+		~SyncThread();
+
+		void Request();
+		// Waits for the running sync and stops the thread.
+		bool Finish();
+
+	private:
+		void Run();
+
+		OutputSink &sink;
+		std::mutex mutex;
+		std::condition_variable requested;
+		bool pending;
+		bool finishing;
+		bool failed;
+		std::thread thread;
+	};
+
+	class CompressionThread
+	{
+	public:
+		explicit CompressionThread(Compressor *compressor);
+		~CompressionThread();
+
+		// Queues the contents of buffer and swaps in an empty buffer.
+		void Submit(std::vector<char> &buffer);
+		// Flushes the compressor and the sink once the queued buffers are
+		// compressed, then requests a sync from syncThread unless it is
+		// nullptr.
+		void Checkpoint(SyncThread *syncThread);
+		// Compresses the queued buffers, ends the compressed data and stops the thread.
+		bool Finish();
+
+	private:
+		void Run();
+
+		std::unique_ptr<Compressor> compressor;
+		std::mutex mutex;
+		std::condition_variable queueChanged;
+		// Empty buffers mark checkpoints, which are never submitted otherwise.
+		std::deque<std::vector<char>> queue;
+		std::deque<SyncThread *> checkpoints;
+		std::vector<std::vector<char>> freeBuffers;
+		bool finishing;
+		bool failed;
+		std::thread thread;
+	};
+}
+
+SyncThread::SyncThread(OutputSink &sink)
+	: sink(sink), pending(false), finishing(false), failed(false)
+{
+	thread = std::thread(&SyncThread::Run, this);
+}
+
+SyncThread::~SyncThread()
+{
+	Finish();
+}
+
+void SyncThread::Request()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending = true;
+	}
+	requested.notify_one();
+}
+
+bool SyncThread::Finish()
+{
+	if (thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			finishing = true;
+		}
+		requested.notify_one();
+		thread.join();
+	}
+	return !failed;
+}
+
+void SyncThread::Run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		requested.wait(lock, [this] { return pending || finishing; });
+		if (!pending)
+			break;
+		pending = false;
+
+		lock.unlock();
+		const bool ok = sink.Sync();
+		lock.lock();
+		if (!ok)
+			failed = true;
+	}
+}
+
+CompressionThread::CompressionThread(Compressor *compressor)
+	: compressor(compressor), finishing(false), failed(false)
+{
+	thread = std::thread(&CompressionThread::Run, this);
+}
+
+CompressionThread::~CompressionThread()
+{
+	Finish();
+}
+
+void CompressionThread::Submit(std::vector<char> &buffer)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	queueChanged.wait(lock, [this] { return queue.size() < MAX_QUEUED_BUFFERS; });
+
+	queue.push_back(std::vector<char>());
+	queue.back().swap(buffer);
+	if (!freeBuffers.empty()) {
+		buffer.swap(freeBuffers.back());
+		freeBuffers.pop_back();
+	}
+	queueChanged.notify_all();
+}
+
+void CompressionThread::Checkpoint(SyncThread *syncThread)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	queueChanged.wait(lock, [this] { return queue.size() < MAX_QUEUED_BUFFERS; });
+
+	queue.push_back(std::vector<char>());
+	checkpoints.push_back(syncThread);
+	queueChanged.notify_all();
+}
+
+bool CompressionThread::Finish()
+{
+	if (thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			finishing = true;
+		}
+		queueChanged.notify_all();
+		thread.join();
+	}
+	return !failed;
+}
+
+void CompressionThread::Run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		queueChanged.wait(lock, [this] { return !queue.empty() || finishing; });
+		if (queue.empty())
+			break;
+
+		std::vector<char> buffer;
+		buffer.swap(queue.front());
+		queue.pop_front();
+		SyncThread *syncThread = nullptr;
+		const bool checkpoint = buffer.empty();
+		if (checkpoint) {
+			syncThread = checkpoints.front();
+			checkpoints.pop_front();
+		}
+		queueChanged.notify_all();
+
+		lock.unlock();
+		if (checkpoint) {
+			if (!failed && !compressor->Flush())
+				failed = true;
+			if (!failed && syncThread)
+				syncThread->Request();
+			lock.lock();
+			continue;
+		}
+		if (!failed && !compressor->Write(buffer.data(), buffer.size()))
+			failed = true;
+		lock.lock();
+
+		freeBuffers.push_back(std::vector<char>());
+		freeBuffers.back().swap(buffer);
+	}
+	lock.unlock();
+
+	if (!failed && !compressor->Finish())
+		failed = true;
+}
+
+OutputStream::OutputStream()
+	: sink(nullptr),
+	compressionThread(nullptr),
+	syncThread(nullptr),
+	bufferSize(DEFAULT_OUTPUT_BUFFER_SIZE),
+	sinkMemory(false),
+	bufferBegin(nullptr),
+	current(nullptr),
+	bufferEnd(nullptr),
+	flushedBytes(0),
+	failed(false)
+{
+}
+
+OutputStream::~OutputStream()
+{
+	Close();
+}
+
+bool OutputStream::Open(OutputSink &sink, Compression compression, int level, size_t bufferSize)
+{
+	Close();
+
+	if (compression != COMPRESSION_NONE) {
+		Compressor *compressor = Compressor::Create(sink, compression, level);
+		if (!compressor)
+			return false;
+		compressionThread = new CompressionThread(compressor);
+	}
+
+	this->sink = &sink;
+	this->bufferSize = std::max<size_t>(bufferSize, 4096);
+	flushedBytes = 0;
+	failed = false;
+	ResetBuffer();
+	return true;
+}
+
+void OutputStream::Close()
+{
+	if (!sink)
+		return;
+
+	Flush();
+	if (compressionThread) {
+		if (!compressionThread->Finish())
+			failed = true;
+		delete compressionThread;
+		compressionThread = nullptr;
+	}
+	if (syncThread) {
+		if (!syncThread->Finish())
+			failed = true;
+		delete syncThread;
+		syncThread = nullptr;
+	}
+	if (!sink->Finish())
+		failed = true;
+
+	sink = nullptr;
+	sinkMemory = false;
+	bufferBegin = current = bufferEnd = nullptr;
+}
+
+void OutputStream::Checkpoint(bool sync)
+{
+	if (!sink)
+		return;
+
+	Flush();
+	if (sync && !syncThread)
+		syncThread = new SyncThread(*sink);
+
+	if (compressionThread) {
+		compressionThread->Checkpoint(sync ? syncThread : nullptr);
+		return;
+	}
+	if (!sink->Flush())
+		failed = true;
+	else if (sync)
+		syncThread->Request();
+}
+
+bool OutputStream::Failed() const
+{
+	return failed;
+}
+
+void OutputStream::Flush()
+{
+	if (!sink)
+		return;
+
+	const size_t size = current - bufferBegin;
+	if (size == 0)
+		return;
+
+	bool ok;
+	if (sinkMemory) {
+		ok = sink->Commit(size);
+	} else if (compressionThread) {
+		buffer.resize(size);
+		compressionThread->Submit(buffer);
+		ok = true;
+	} else {
+		ok = sink->Write(buffer.data(), size);
+	}
+	if (!ok)
+		failed = true;
+
+	flushedBytes += size;
+	ResetBuffer();
+}
+
+void OutputStream::ResetBuffer()
+{
+	// Compression needs buffers of its own to hand to the helper thread.
+	if (!compressionThread && !failed) {
+		size_t size;
+		bufferBegin = sink->Reserve(bufferSize, size);
+		if (bufferBegin) {
+			sinkMemory = true;
+			current = bufferBegin;
+			bufferEnd = bufferBegin + size;
+			return;
+		}
+	}
+
+	sinkMemory = false;
+	buffer.resize(bufferSize);
+	bufferBegin = current = buffer.data();
+	bufferEnd = current + buffer.size();
+}
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include "taslogger/reader.hpp"
+#include "compression.hpp"
+#include "fast_scan.hpp"
+#include "file_mapping.hpp"
+#include "internal_handler.hpp"
+
+using namespace TASLogger;
+
+// Presents the log with a range of bytes cut out as one stream. Used to parse
+// everything around the physics frames with the regular state machine.
+class SplicedStream
+{
+public:
+	typedef char Ch;
+
+	SplicedStream(const char *data, size_t cutBegin, size_t cutEnd, size_t size)
+		: data(data), pos(cutBegin == 0 ? cutEnd : 0), cutBegin(cutBegin), cutEnd(cutEnd), size(size)
+	{
+	}
+
+	inline Ch Peek() const { return pos == size ? '\0' : data[pos]; }
+	inline size_t Tell() const { return pos; }
+
+	inline Ch Take()
+	{
+		if (pos == size)
+			return '\0';
+		const Ch c = data[pos++];
+		if (pos == cutBegin)
+			pos = cutEnd;
+		return c;
+	}
+
+	Ch *PutBegin() { return nullptr; }
+	void Put(Ch) {}
+	void Flush() {}
+	size_t PutEnd(Ch *) { return 0; }
+
+private:
+	const char *data;
+	size_t pos;
+	size_t cutBegin;
+	size_t cutEnd;
+	size_t size;
+};
+
+static const char *FindPattern(const char *begin, const char *end, const std::string &pattern)
+{
+	while (static_cast<size_t>(end - begin) >= pattern.size()) {
+		const char *p = static_cast<const char *>(std::memchr(begin, pattern[0], end - begin - pattern.size() + 1));
+		if (!p)
+			return end;
+		if (std::memcmp(p, pattern.data(), pattern.size()) == 0)
+			return p;
+		begin = p + 1;
+	}
+	return end;
+}
+
+// Parses a comma-separated run of physics frame objects.
+static rapidjson::ParseResult ParseChunk(const char *data, size_t begin, size_t end, TASLog &chunkLog)
+{
+	InternalHandler<TASLog> internalHandler(chunkLog);
+	internalHandler.StartInPhysicsFrameList();
+
+	ScanningReadStream ss(data + begin, end - begin);
+	ScanningHandler<InternalHandler<TASLog>> handler(internalHandler, ss);
+	rapidjson::Reader reader;
+	for (;;) {
+		const rapidjson::ParseResult res = reader.Parse<HANDLER_PARSE_FLAGS | rapidjson::kParseStopWhenDoneFlag>(ss, handler);
+		if (res.IsError())
+			return rapidjson::ParseResult(res.Code(), begin + res.Offset());
+
+		while (ss.Tell() != end - begin && IsWhitespace(ss.Peek()))
+			ss.Take();
+		if (ss.Tell() == end - begin)
+			return rapidjson::ParseResult();
+		if (ss.Peek() != ',')
+			return rapidjson::ParseResult(rapidjson::kParseErrorArrayMissCommaOrSquareBracket, begin + ss.Tell());
+		ss.Take();
+	}
+}
+
+static rapidjson::ParseResult ParseSequential(const char *data, size_t size, TASLog &tasLog)
+{
+	ScanningReadStream ss(data, size);
+	InternalHandler<TASLog> internalHandler(tasLog);
+	ScanningHandler<InternalHandler<TASLog>> handler(internalHandler, ss);
+	rapidjson::Reader reader;
+	return reader.Parse<HANDLER_PARSE_FLAGS>(ss, handler);
+}
+
+rapidjson::ParseResult TASLogger::ParseFileParallel(const char *filename, TASLog &tasLog, unsigned threadCount)
+{
+	tasLog = TASLog();
+
+	FileMapping mapping;
+	if (!mapping.Open(filename))
+		return rapidjson::ParseResult(rapidjson::kParseErrorDocumentEmpty, 0);
+
+	const char *data = mapping.Data();
+	const size_t size = mapping.Size();
+
+	if (size != 0 && (data[0] == BINARY_MAGIC[0] || static_cast<unsigned char>(data[0]) == ZSTD_MAGIC_BYTE)) {
+		mapping.Close();
+		FILE *file = std::fopen(filename, "rb");
+		if (!file)
+			return rapidjson::ParseResult(rapidjson::kParseErrorDocumentEmpty, 0);
+		const rapidjson::ParseResult res = ParseFile(file, tasLog);
+		std::fclose(file);
+		return res;
+	}
+
+	// A literal quote cannot appear unescaped inside a JSON string, and only
+	// physics frames have the frametime key, so these patterns can only match
+	// at the start of the physics frame list and between two physics frames.
+	const std::string frameStart = std::string("{\"") + KEY_FRAMETIME + "\":";
+	const std::string listStart = "[" + frameStart;
+	const std::string separator = "}," + frameStart;
+
+	const char *listBegin = FindPattern(data, data + size, listStart);
+	if (listBegin == data + size)
+		return ParseSequential(data, size, tasLog);
+	const size_t framesBegin = listBegin - data + 1;
+
+	// Command frames of a delta encoded log depend on the previous ones, so
+	// the chunks cannot be parsed independently.
+	const std::string deltaEncoded = std::string("\"") + KEY_DELTA_ENCODED + "\":true";
+	if (FindPattern(data, listBegin, deltaEncoded) != listBegin)
+		return ParseSequential(data, size, tasLog);
+
+	// The physics frame list is written last, so the log ends with "}]}".
+	size_t framesEnd = size;
+	while (framesEnd > framesBegin && IsWhitespace(data[framesEnd - 1]))
+		--framesEnd;
+	if (framesEnd <= framesBegin || data[--framesEnd] != '}')
+		return ParseSequential(data, size, tasLog);
+	while (framesEnd > framesBegin && IsWhitespace(data[framesEnd - 1]))
+		--framesEnd;
+	if (framesEnd <= framesBegin || data[--framesEnd] != ']')
+		return ParseSequential(data, size, tasLog);
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<size_t> chunkBegins(1, framesBegin);
+	for (unsigned i = 1; i < threadCount; ++i) {
+		const size_t target = framesBegin + (framesEnd - framesBegin) / threadCount * i;
+		if (target <= chunkBegins.back())
+			continue;
+		const char *p = FindPattern(data + target, data + framesEnd, separator);
+		if (p == data + framesEnd)
+			break;
+		chunkBegins.push_back(p - data + 2);
+	}
+
+	const size_t chunkCount = chunkBegins.size();
+	std::vector<TASLog> chunkLogs(chunkCount);
+	std::vector<rapidjson::ParseResult> chunkResults(chunkCount);
+	std::vector<std::thread> threads;
+
+	for (size_t i = 0; i < chunkCount; ++i) {
+		const size_t chunkEnd = i + 1 < chunkCount ? chunkBegins[i + 1] - 1 : framesEnd;
+		threads.push_back(std::thread([&, i, chunkEnd]() {
+			chunkResults[i] = ParseChunk(data, chunkBegins[i], chunkEnd, chunkLogs[i]);
+		}));
+	}
+
+	SplicedStream ss(data, framesBegin, framesEnd, size);
+	InternalHandler<TASLog> internalHandler(tasLog);
+	rapidjson::Reader reader;
+	const rapidjson::ParseResult res = reader.Parse<HANDLER_PARSE_FLAGS>(ss, internalHandler);
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	if (res.IsError())
+		return res;
+
+	size_t frameCount = 0;
+	for (const TASLog &chunkLog : chunkLogs)
+		frameCount += chunkLog.physicsFrameList.size();
+
+	std::vector<ReaderPhysicsFrame>().swap(tasLog.physicsFrameList);
+	tasLog.physicsFrameList.reserve(frameCount);
+	for (size_t i = 0; i < chunkCount; ++i) {
+		std::vector<ReaderPhysicsFrame> &frames = chunkLogs[i].physicsFrameList;
+		tasLog.physicsFrameList.insert(tasLog.physicsFrameList.end(),
+			std::make_move_iterator(frames.begin()), std::make_move_iterator(frames.end()));
+		std::vector<ReaderPhysicsFrame>().swap(frames);
+
+		if (chunkResults[i].IsError())
+			return chunkResults[i];
+	}
+
+	return rapidjson::ParseResult();
+}
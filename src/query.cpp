@@ -0,0 +1,377 @@
+#include <cstdio>
+#include <cstring>
+#include "taslogger/query.hpp"
+#include "compression.hpp"
+#include "file_mapping.hpp"
+#include "internal_handler.hpp"
+
+using namespace TASLogger;
+
+// Reads from memory that is followed by a zero byte, like a FileMapping.
+// After SkipValue, the value that follows the next colon is jumped over
+// without the reader seeing it; the reader gets a 0 in its place.
+class SkippingStream
+{
+public:
+	typedef char Ch;
+
+	SkippingStream(const char *data, size_t size) : data(data), end(data + size), p(data), skip(SkipNone) {}
+
+	inline void SkipValue() { skip = SkipColon; }
+
+	inline Ch Peek() const { return skip == SkipNone ? *p : PeekSkipping(); }
+
+	inline Ch Take()
+	{
+		if (skip != SkipNone)
+			return TakeSkipping();
+		return p == end ? '\0' : *p++;
+	}
+
+	inline size_t Tell() const { return static_cast<size_t>(p - data); }
+
+	Ch *PutBegin() { return nullptr; }
+	void Put(Ch) {}
+	void Flush() {}
+	size_t PutEnd(Ch *) { return 0; }
+
+private:
+	enum SkipState
+	{
+		SkipNone,
+		SkipColon,
+		SkipWhitespace,
+		SkipReplaced
+	};
+
+	Ch PeekSkipping() const
+	{
+		if (skip == SkipColon || (skip == SkipWhitespace && IsWhitespace(*p)))
+			return *p;
+		if (skip == SkipWhitespace) {
+			p = EndOfValue(p);
+			skip = SkipReplaced;
+		}
+		return '0';
+	}
+
+	Ch TakeSkipping()
+	{
+		const Ch c = PeekSkipping();
+		if (skip == SkipReplaced) {
+			skip = SkipNone;
+			return c;
+		}
+		if (p != end)
+			++p;
+		if (skip == SkipColon && c == ':')
+			skip = SkipWhitespace;
+		return c;
+	}
+
+	// q is just past the opening quote, returns just past the closing one.
+	const char *EndOfString(const char *q) const
+	{
+		while (q != end) {
+			const char *quote = static_cast<const char *>(std::memchr(q, '"', end - q));
+			if (!quote)
+				return end;
+			const char *backslashes = quote;
+			while (backslashes != q && backslashes[-1] == '\\')
+				--backslashes;
+			q = quote + 1;
+			if ((quote - backslashes) % 2 == 0)
+				return q;
+		}
+		return end;
+	}
+
+	const char *EndOfValue(const char *q) const
+	{
+		if (*q == '"')
+			return EndOfString(q + 1);
+		if (*q != '{' && *q != '[') {
+			while (q != end && *q != ',' && *q != '}' && *q != ']' && !IsWhitespace(*q))
+				++q;
+			return q;
+		}
+
+		unsigned depth = 0;
+		while (q != end) {
+			switch (*q++) {
+			case '"':
+				q = EndOfString(q);
+				break;
+			case '{':
+			case '[':
+				++depth;
+				break;
+			case '}':
+			case ']':
+				if (--depth == 0)
+					return q;
+				break;
+			default:
+				break;
+			}
+		}
+		return end;
+	}
+
+	const char *const data;
+	const char *const end;
+	mutable const char *p;
+	mutable SkipState skip;
+};
+
+// Decides which physics frames match the query. Sees every frame in order,
+// so that it can keep track of the landings.
+class QueryMatcher
+{
+public:
+	QueryMatcher(const FrameQuery &query, const QueryCallback &callback)
+		: query(query), callback(callback), index(0), previousOnGround(true)
+	{
+	}
+
+	bool operator()(const ReaderPhysicsFrame &physicsFrame)
+	{
+		const size_t frameIndex = index++;
+		if (!Matches(physicsFrame))
+			return true;
+		return callback(frameIndex, physicsFrame);
+	}
+
+private:
+	bool Matches(const ReaderPhysicsFrame &physicsFrame)
+	{
+		bool framebulkMatch = !query.filterFramebulks;
+		bool landed = !query.landing;
+		for (const ReaderCommandFrame &commandFrame : physicsFrame.commandFrameList) {
+			if (commandFrame.framebulkId >= query.firstFramebulk && commandFrame.framebulkId <= query.lastFramebulk)
+				framebulkMatch = true;
+			if (!previousOnGround && commandFrame.postPMState.onGround)
+				landed = true;
+			previousOnGround = commandFrame.postPMState.onGround;
+		}
+		if (!framebulkMatch || !landed)
+			return false;
+
+		if (query.damageBits != 0) {
+			bool damaged = false;
+			for (const ReaderDamage &damage : physicsFrame.damageList)
+				damaged |= (damage.damageBits & query.damageBits) != 0;
+			if (!damaged)
+				return false;
+		}
+
+		return !query.filter || query.filter(physicsFrame);
+	}
+
+	const FrameQuery &query;
+	const QueryCallback &callback;
+	size_t index;
+	// The first command frame of the log is not a landing.
+	bool previousOnGround;
+};
+
+// Forwards to the InternalHandler, except for the values that the query does
+// not need, which the stream skips.
+class QueryHandler
+{
+public:
+	QueryHandler(InternalHandler<TASLog> &handler, SkippingStream &stream, const FrameQuery &query)
+		: handler(handler), stream(stream), next(KindOther), skipped(false), deltaEncoded(false)
+	{
+		const uint32_t fields = query.fields;
+		consoleMessages = (fields & QUERY_CONSOLE_MESSAGES) != 0;
+		damages = (fields & QUERY_DAMAGES) != 0 || query.damageBits != 0;
+		objectMoves = (fields & QUERY_OBJECT_MOVES) != 0;
+		rng = (fields & QUERY_RNG) != 0;
+		commandFrameFields = (fields & QUERY_COMMAND_FRAMES) != 0;
+		framebulkIds = commandFrameFields || query.filterFramebulks;
+		prePlayerMove = (fields & QUERY_PLAYER_STATES) != 0;
+		postPlayerMove = prePlayerMove || query.landing;
+		collisions = (fields & QUERY_COLLISIONS) != 0;
+		commandFrames = framebulkIds || postPlayerMove || collisions;
+	}
+
+	bool Null() { return Skipped() || handler.Null(); }
+	bool Int(int i) { return Skipped() || handler.Int(i); }
+	bool Uint(unsigned i) { return Skipped() || handler.Uint(i); }
+	bool Int64(int64_t i) { return Skipped() || handler.Int64(i); }
+	bool Uint64(uint64_t i) { return Skipped() || handler.Uint64(i); }
+	bool Double(double d) { return Skipped() || handler.Double(d); }
+	bool RawNumber(const char *str, rapidjson::SizeType length, bool copy) { return Skipped() || handler.RawNumber(str, length, copy); }
+	bool String(const char *str, rapidjson::SizeType length, bool copy) { return Skipped() || handler.String(str, length, copy); }
+
+	bool Bool(bool b)
+	{
+		if (next == KindDeltaEncoded)
+			deltaEncoded = b;
+		return Skipped() || handler.Bool(b);
+	}
+
+	bool StartObject()
+	{
+		if (kinds.empty())
+			kinds.push_back(KindLog);
+		else if (kinds.back() == KindFrameList)
+			kinds.push_back(KindFrame);
+		else if (kinds.back() == KindCommandFrameList)
+			kinds.push_back(KindCommandFrame);
+		else
+			kinds.push_back(KindOther);
+		next = KindOther;
+		return handler.StartObject();
+	}
+
+	bool Key(const char *str, rapidjson::SizeType length, bool copy)
+	{
+		next = KindOther;
+		bool needed = true;
+		switch (kinds.back()) {
+		case KindLog:
+			if (IsKey(str, length, KEY_DELTA_ENCODED))
+				next = KindDeltaEncoded;
+			else if (IsKey(str, length, KEY_PHYSICS_FRAMES))
+				next = KindFrameList;
+			break;
+		case KindFrame:
+			if (IsKey(str, length, KEY_COMMAND_FRAMES)) {
+				needed = commandFrames;
+				next = KindCommandFrameList;
+			} else if (IsKey(str, length, KEY_CONSOLE_MESSAGES)) {
+				needed = consoleMessages;
+			} else if (IsKey(str, length, KEY_DAMAGES)) {
+				needed = damages;
+			} else if (IsKey(str, length, KEY_OBJECT_BOOSTS)) {
+				needed = objectMoves;
+			} else if (IsKey(str, length, KEY_RNG)) {
+				needed = rng;
+			}
+			break;
+		case KindCommandFrame:
+			// The command frames of a delta encoded log build on each other.
+			if (deltaEncoded)
+				break;
+			if (IsKey(str, length, KEY_FRAMEBULK_ID))
+				needed = framebulkIds;
+			else if (IsKey(str, length, KEY_PRE_PLAYERMOVE))
+				needed = prePlayerMove;
+			else if (IsKey(str, length, KEY_POST_PLAYERMOVE))
+				needed = postPlayerMove;
+			else if (IsKey(str, length, KEY_COLLISIONS))
+				needed = collisions;
+			else
+				needed = commandFrameFields;
+			break;
+		default:
+			break;
+		}
+
+		if (needed)
+			return handler.Key(str, length, copy);
+		stream.SkipValue();
+		skipped = true;
+		return true;
+	}
+
+	bool EndObject(rapidjson::SizeType memberCount)
+	{
+		kinds.pop_back();
+		return handler.EndObject(memberCount);
+	}
+
+	bool StartArray()
+	{
+		kinds.push_back(next == KindFrameList || next == KindCommandFrameList ? next : KindOther);
+		next = KindOther;
+		return handler.StartArray();
+	}
+
+	bool EndArray(rapidjson::SizeType elementCount)
+	{
+		kinds.pop_back();
+		return handler.EndArray(elementCount);
+	}
+
+private:
+	enum Kind : uint8_t
+	{
+		KindOther,
+		KindLog,
+		KindDeltaEncoded,
+		KindFrameList,
+		KindFrame,
+		KindCommandFrameList,
+		KindCommandFrame
+	};
+
+	// Swallows the 0 that replaces a skipped value.
+	inline bool Skipped()
+	{
+		next = KindOther;
+		if (!skipped)
+			return false;
+		skipped = false;
+		return true;
+	}
+
+	InternalHandler<TASLog> &handler;
+	SkippingStream &stream;
+	std::vector<Kind> kinds;
+	Kind next;
+	bool skipped;
+	bool deltaEncoded;
+
+	bool consoleMessages;
+	bool damages;
+	bool objectMoves;
+	bool rng;
+	bool commandFrames;
+	bool commandFrameFields;
+	bool framebulkIds;
+	bool prePlayerMove;
+	bool postPlayerMove;
+	bool collisions;
+};
+
+rapidjson::ParseResult TASLogger::QueryFile(const char *filename, const FrameQuery &query, TASLog &header, const QueryCallback &callback)
+{
+	header = TASLog();
+
+	FileMapping mapping;
+	if (!mapping.Open(filename))
+		return rapidjson::ParseResult(rapidjson::kParseErrorDocumentEmpty, 0);
+
+	QueryMatcher matcher(query, callback);
+	const PhysicsFrameCallback frameCallback = std::ref(matcher);
+
+	const char *data = mapping.Data();
+	if (data[0] == BINARY_MAGIC[0] || static_cast<unsigned char>(data[0]) == ZSTD_MAGIC_BYTE) {
+		mapping.Close();
+		FILE *file = std::fopen(filename, "rb");
+		if (!file)
+			return rapidjson::ParseResult(rapidjson::kParseErrorDocumentEmpty, 0);
+		const rapidjson::ParseResult res = ParseFile(file, header, frameCallback);
+		std::fclose(file);
+		return res;
+	}
+
+	SkippingStream stream(data, mapping.Size());
+	InternalHandler<TASLog> internalHandler(header, frameCallback);
+	QueryHandler handler(internalHandler, stream, query);
+	rapidjson::Reader reader;
+	return reader.Parse<HANDLER_PARSE_FLAGS>(stream, handler);
+}
+
+rapidjson::ParseResult TASLogger::QueryFile(const char *filename, const FrameQuery &query, TASLog &tasLog, std::vector<size_t> &physicsFrameIndexes)
+{
+	physicsFrameIndexes.clear();
+	return QueryFile(filename, query, tasLog, [&](size_t index, const ReaderPhysicsFrame &physicsFrame) {
+		tasLog.physicsFrameList.push_back(physicsFrame);
+		physicsFrameIndexes.push_back(index);
+		return true;
+	});
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include "taslogger/common.hpp"
+
+namespace TASLogger
+{
+	// One call of ran1, as in the engine.
+	inline void AdvanceRng(RngState &rng)
+	{
+		const int32_t IA = 16807;
+		const int32_t IM = 2147483647;
+		const int32_t IQ = 127773;
+		const int32_t IR = 2836;
+		const int32_t NDIV = 1 + (IM - 1) / 32;
+
+		if (rng.idum <= 0 || rng.iy == 0) {
+			const int64_t seed = -static_cast<int64_t>(rng.idum);
+			rng.idum = seed < 1 ? 1 : seed > IM ? IM : static_cast<int32_t>(seed);
+			for (int j = 32 + 7; j >= 0; --j) {
+				const int32_t k = rng.idum / IQ;
+				rng.idum = IA * (rng.idum - k * IQ) - IR * k;
+				if (rng.idum < 0)
+					rng.idum += IM;
+				if (j < 32)
+					rng.iv[j] = rng.idum;
+			}
+			rng.iy = rng.iv[0];
+		}
+
+		const int32_t k = rng.idum / IQ;
+		rng.idum = IA * (rng.idum - k * IQ) - IR * k;
+		if (rng.idum < 0)
+			rng.idum += IM;
+		// Masked so that a damaged state cannot index out of bounds, iy is
+		// below IM otherwise.
+		const uint32_t j = (static_cast<uint32_t>(rng.iy) / NDIV) & 31;
+		rng.iy = rng.iv[j];
+		rng.iv[j] = rng.idum;
+	}
+
+	// Finds the number of ran1 calls, up to RNG_MAX_STEPS, that turn from
+	// into to.
+	inline bool FindRngSteps(const RngState &from, const RngState &to, uint32_t &steps)
+	{
+		RngState rng = from;
+		for (steps = 0; steps <= RNG_MAX_STEPS; ++steps) {
+			if (rng.idum == to.idum && std::memcmp(&rng, &to, sizeof(rng)) == 0)
+				return true;
+			AdvanceRng(rng);
+		}
+		return false;
+	}
+}
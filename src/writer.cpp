@@ -1,38 +1,240 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include "taslogger/writer.hpp"
+#include "rapidjson/internal/dtoa.h"
+#include "rapidjson/internal/itoa.h"
+#include "command_frame.hpp"
+#include "float_format.hpp"
+#include "rng.hpp"
 
 using namespace TASLogger;
 
+enum DeltaCommandFrameField : uint32_t
+{
+	DELTA_SHARED_SEED = 1 << 0,
+	DELTA_VIEWANGLES = 1 << 1,
+	DELTA_PUNCHANGLES = 1 << 2,
+	DELTA_BUTTONS = 1 << 3,
+	DELTA_IMPULSE = 1 << 4,
+	DELTA_FSU = 1 << 5,
+	DELTA_ENT_FRICTION = 1 << 6,
+	DELTA_ENT_GRAVITY = 1 << 7,
+	DELTA_HEALTH = 1 << 8,
+	DELTA_ARMOR = 1 << 9
+};
+
+enum DeltaPlayerStateField : uint32_t
+{
+	DELTA_POSITION = 1 << 0,
+	DELTA_VELOCITY = 1 << 1,
+	DELTA_BASEVELOCITY = 1 << 2,
+	DELTA_ONGROUND = 1 << 3,
+	DELTA_ONLADDER = 1 << 4,
+	DELTA_WATERLEVEL = 1 << 5,
+	DELTA_DUCK_STATE = 1 << 6
+};
+
+enum DeltaPlayerStateIndex : uint32_t
+{
+	DELTA_PRE_PLAYERMOVE = 1 << 0,
+	DELTA_POST_PLAYERMOVE = 1 << 1
+};
+
+// Marks the field as set and returns whether the value differs from the
+// previous one, which it replaces.
+template<typename T>
+static bool UpdateDelta(uint32_t &fieldsSet, uint32_t field, T &previous, T value)
+{
+	fieldsSet |= field;
+	if (previous == value)
+		return false;
+	previous = value;
+	return true;
+}
+
+template<typename T>
+static bool UpdateDelta(uint32_t &fieldsSet, uint32_t field, T (&previous)[3], T x, T y, T z)
+{
+	fieldsSet |= field;
+	if (previous[0] == x && previous[1] == y && previous[2] == z)
+		return false;
+	previous[0] = x;
+	previous[1] = y;
+	previous[2] = z;
+	return true;
+}
+
 LogWriter::LogWriter()
 {
 }
 
 LogWriter::~LogWriter()
 {
-	if (pFileWriteStream)
-		delete pFileWriteStream;
 }
 
 void LogWriter::Clear()
 {
-	consolePrintQueue.clear();
-	damageQueue.clear();
-	objectMoveQueue.clear();
-	collisionQueue.clear();
-	if (pFileWriteStream) {
-		delete pFileWriteStream;
-		pFileWriteStream = nullptr;
+	consolePrintArena.clear();
+	consolePrints.clear();
+	damages.clear();
+	objectMoves.clear();
+	collisions.clear();
+	rngSet = false;
+	indexPhysicsFrames.clear();
+	indexFramebulks.clear();
+	stream.Close();
+
+	if (segmentFile) {
+		std::fclose(segmentFile);
+		segmentFile = nullptr;
+	}
+}
+
+void LogWriter::SetNumberFormat(NumberFormat format)
+{
+	numberFormat = format;
+}
+
+void LogWriter::SetDeltaEncoding(bool enabled)
+{
+	deltaEncoding = enabled;
+}
+
+bool LogWriter::SetCompression(Compression compression, int level)
+{
+	if (!IsCompressionSupported(compression))
+		return false;
+	this->compression = compression;
+	compressionLevel = level;
+	return true;
+}
+
+void LogWriter::SetIndexFile(FILE *indexFile)
+{
+	this->indexFile = indexFile;
+}
+
+static void PutLittleEndian(std::vector<char> &out, uint64_t value, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+		out.push_back(static_cast<char>(value >> (8 * i)));
+}
+
+void LogWriter::WriteIndex(uint64_t physicsFrameListEnd)
+{
+	uint8_t flags = 0;
+	if (compression != COMPRESSION_NONE)
+		flags |= INDEX_COMPRESSED;
+	if (deltaEncoding)
+		flags |= INDEX_DELTA_ENCODED;
+
+	std::vector<char> out(INDEX_MAGIC, INDEX_MAGIC + INDEX_MAGIC_LENGTH);
+	out.reserve(out.size() + 26 + indexPhysicsFrames.size() * 8 + indexFramebulks.size() * 12);
+	out.push_back(static_cast<char>(INDEX_VERSION));
+	out.push_back(static_cast<char>(flags));
+	PutLittleEndian(out, indexPhysicsFrames.size(), 8);
+	PutLittleEndian(out, indexFramebulks.size(), 8);
+	PutLittleEndian(out, physicsFrameListEnd, 8);
+	for (uint64_t offset : indexPhysicsFrames)
+		PutLittleEndian(out, offset, 8);
+	for (const auto &framebulk : indexFramebulks) {
+		PutLittleEndian(out, framebulk.first, 4);
+		PutLittleEndian(out, framebulk.second, 8);
+	}
+
+	std::fwrite(out.data(), 1, out.size(), indexFile);
+	indexPhysicsFrames.clear();
+	indexFramebulks.clear();
+}
+
+void LogWriter::WriteNumber(double value)
+{
+	if (numberFormat == NUMBER_FORMAT_FLOAT) {
+		char buffer[MAX_FLOAT_LENGTH];
+		const size_t length = FormatShortestFloat(static_cast<float>(value), buffer);
+		if (length != 0) {
+			writer.RawValue(buffer, length, rapidjson::kNumberType);
+			return;
+		}
 	}
+
+	writer.Double(value);
+}
+
+void LogWriter::SetDurability(const DurabilityOptions &options)
+{
+	durability = options;
+}
+
+void LogWriter::CheckpointIfDue()
+{
+	const uint64_t position = stream.Position();
+	const auto now = std::chrono::steady_clock::now();
+	if (position - lastCheckpointPosition < durability.flushBytes
+		&& now - lastCheckpointTime < std::chrono::milliseconds(durability.flushInterval))
+		return;
+
+	stream.Checkpoint(durability.sync);
+	lastCheckpointPosition = position;
+	lastCheckpointTime = now;
+}
+
+void LogWriter::SetBufferSize(size_t size)
+{
+	bufferSize = size;
+}
+
+bool LogWriter::Failed() const
+{
+	return stream.Failed() || segmentFailed;
 }
 
 void LogWriter::StartLog(FILE *file, const char *toolVer, int32_t buildNumber, const char *mod)
 {
-	static char writeBuffer[65536];
+	Clear();
+
+	fileSink = FileSink(file);
+	StartLog(fileSink, toolVer, buildNumber, mod);
+}
+
+void LogWriter::StartLog(OutputSink &sink, const char *toolVer, int32_t buildNumber, const char *mod)
+{
+	Clear();
+
+	segmentBasePath.clear();
+	segmentFailed = false;
+	writeIndex = indexFile != nullptr;
+
+	stream.Open(sink, compression, compressionLevel, bufferSize);
+	writer.Reset(stream);
+	WriteHeader(toolVer, buildNumber, mod);
+}
 
+bool LogWriter::StartSegmentedLog(const char *basePath, const SegmentOptions &options, const char *toolVer, int32_t buildNumber, const char *mod)
+{
 	Clear();
 
-	pFileWriteStream = new rapidjson::FileWriteStream(file, writeBuffer, sizeof(writeBuffer));
-	writer.Reset(*pFileWriteStream);
+	segmentBasePath = basePath;
+	manifestPath = segmentBasePath + ".manifest.json";
+	segmentOptions = options;
+	segmentPending = false;
+	segmentFailed = false;
+	writeIndex = false;
+
+	manifest = LogManifest();
+	manifest.toolVersion = toolVer;
+	manifest.buildNumber = buildNumber;
+	manifest.gameMod = mod;
+	if (!SaveManifest(manifestPath.c_str(), manifest))
+		segmentFailed = true;
+
+	StartSegment();
+	return !segmentFailed;
+}
 
+void LogWriter::WriteHeader(const char *toolVer, int32_t buildNumber, const char *mod)
+{
 	writer.StartObject();
 
 	writer.Key(KEY_TOOL_VERSION);
@@ -44,22 +246,105 @@ void LogWriter::StartLog(FILE *file, const char *toolVer, int32_t buildNumber, c
 	writer.Key(KEY_MOD);
 	writer.String(mod);
 
+	if (deltaEncoding) {
+		writer.Key(KEY_DELTA_ENCODED);
+		writer.Bool(true);
+
+		deltaFrame = DeltaCommandFrame();
+		deltaFrame.entFriction = 1;
+		deltaFrame.entGravity = 1;
+		deltaPlayer = DeltaPlayerState();
+	}
+
 	writer.Key(KEY_PHYSICS_FRAMES);
 	writer.StartArray();
+
+	previousRngSet = false;
+	lastCheckpointPosition = 0;
+	lastCheckpointTime = std::chrono::steady_clock::now();
+}
+
+void LogWriter::StartSegment()
+{
+#ifdef _WIN32
+	const std::string::size_type slash = segmentBasePath.find_last_of("/\\");
+#else
+	const std::string::size_type slash = segmentBasePath.rfind('/');
+#endif
+	char suffix[32];
+	std::snprintf(suffix, sizeof(suffix), ".%04u.json", static_cast<unsigned>(manifest.segments.size()));
+	segment = LogSegment();
+	segment.filename = segmentBasePath.substr(slash == std::string::npos ? 0 : slash + 1) + suffix;
+
+	// A segment that cannot be created fails every write to it.
+	segmentFile = std::fopen(SegmentPath(manifestPath.c_str(), segment).c_str(), "wb");
+	if (!segmentFile)
+		segmentFailed = true;
+	fileSink = FileSink(segmentFile);
+
+	stream.Open(fileSink, compression, compressionLevel, bufferSize);
+	writer.Reset(stream);
+	WriteHeader(manifest.toolVersion.c_str(), manifest.buildNumber, manifest.gameMod.c_str());
+}
+
+// The manifest lists the segment only once all of it has been written.
+void LogWriter::FinishSegment()
+{
+	writer.EndArray();
+	writer.EndObject();
+	stream.Close();
+	if (stream.Failed())
+		segmentFailed = true;
+
+	if (segmentFile) {
+		if (durability.enabled && durability.sync && (!fileSink.Flush() || !fileSink.Sync()))
+			segmentFailed = true;
+		if (std::fclose(segmentFile) != 0)
+			segmentFailed = true;
+		segmentFile = nullptr;
+	}
+
+	manifest.segments.push_back(segment);
+	if (!SaveManifest(manifestPath.c_str(), manifest))
+		segmentFailed = true;
 }
 
 void LogWriter::EndLog()
 {
+	if (!segmentBasePath.empty()) {
+		manifest.complete = true;
+		if (segmentPending) {
+			segmentPending = false;
+			if (!SaveManifest(manifestPath.c_str(), manifest))
+				segmentFailed = true;
+		} else {
+			FinishSegment();
+		}
+		return;
+	}
+
+	const uint64_t physicsFrameListEnd = stream.Position();
 	writer.EndArray();
 	writer.EndObject();
+	stream.Close();
+
+	if (writeIndex)
+		WriteIndex(physicsFrameListEnd);
 }
 
 void LogWriter::StartPhysicsFrame(double frameTime, int32_t clstate, bool paused, const char *cbuf)
 {
+	if (segmentPending) {
+		segmentPending = false;
+		StartSegment();
+	}
+
 	writer.StartObject();
+	if (writeIndex)
+		indexPhysicsFrames.push_back(stream.Position() - 1);
 
 	writer.Key(KEY_FRAMETIME);
-	writer.Double(frameTime);
+	WriteNumber(frameTime);
 
 	if (clstate != 5) {
 		writer.Key(KEY_CLIENT_STATE);
@@ -82,25 +367,24 @@ void LogWriter::EndPhysicsFrame()
 {
 	writer.EndArray();
 
-	if (!consolePrintQueue.empty()) {
+	if (!consolePrints.empty()) {
 		writer.Key(KEY_CONSOLE_MESSAGES);
 		writer.StartArray();
-		while (!consolePrintQueue.empty()) {
-			writer.String(consolePrintQueue.front().c_str());
-			consolePrintQueue.pop_front();
-		}
+		for (const auto &message : consolePrints)
+			writer.String(consolePrintArena.data() + message.first, static_cast<rapidjson::SizeType>(message.second));
 		writer.EndArray();
+		consolePrintArena.clear();
+		consolePrints.clear();
 	}
 
-	if (!damageQueue.empty()) {
+	if (!damages.empty()) {
 		writer.Key(KEY_DAMAGES);
 		writer.StartArray();
-		while (!damageQueue.empty()) {
-			const Damage &damage = damageQueue.front();
+		for (const Damage &damage : damages) {
 			writer.StartObject();
 
 			writer.Key(KEY_DAMAGE_AMOUNT);
-			writer.Double(damage.damage);
+			WriteNumber(damage.damage);
 
 			writer.Key(KEY_DAMAGE_BITS);
 			writer.Int(damage.damageBits);
@@ -108,23 +392,22 @@ void LogWriter::EndPhysicsFrame()
 			if (damage.direction[0] != 0.0 || damage.direction[1] != 0.0 || damage.direction[2] != 0.0) {
 				writer.Key(KEY_DAMAGE_DIRECTION);
 				writer.StartArray();
-				writer.Double(damage.direction[0]);
-				writer.Double(damage.direction[1]);
-				writer.Double(damage.direction[2]);
+				WriteNumber(damage.direction[0]);
+				WriteNumber(damage.direction[1]);
+				WriteNumber(damage.direction[2]);
 				writer.EndArray();
 			}
 
 			writer.EndObject();
-			damageQueue.pop_front();
 		}
 		writer.EndArray();
+		damages.clear();
 	}
 
-	if (!objectMoveQueue.empty()) {
+	if (!objectMoves.empty()) {
 		writer.Key(KEY_OBJECT_BOOSTS);
 		writer.StartArray();
-		while (!objectMoveQueue.empty()) {
-			const ObjectMove &objectMove = objectMoveQueue.front();
+		for (const ObjectMove &objectMove : objectMoves) {
 			writer.StartObject();
 
 			if (!objectMove.pull) {
@@ -134,46 +417,119 @@ void LogWriter::EndPhysicsFrame()
 
 			writer.Key(KEY_OBJECT_VELOCITY);
 			writer.StartArray();
-			writer.Double(objectMove.velocity[0]);
-			writer.Double(objectMove.velocity[1]);
-			writer.Double(objectMove.velocity[2]);
+			WriteNumber(objectMove.velocity[0]);
+			WriteNumber(objectMove.velocity[1]);
+			WriteNumber(objectMove.velocity[2]);
 			writer.EndArray();
 
 			writer.Key(KEY_OBJECT_POSITION);
 			writer.StartArray();
-			writer.Double(objectMove.position[0]);
-			writer.Double(objectMove.position[1]);
-			writer.Double(objectMove.position[2]);
+			WriteNumber(objectMove.position[0]);
+			WriteNumber(objectMove.position[1]);
+			WriteNumber(objectMove.position[2]);
 			writer.EndArray();
 
 			writer.EndObject();
-			objectMoveQueue.pop_front();
 		}
 		writer.EndArray();
+		objectMoves.clear();
 	}
 
+	if (rngSet)
+		WriteRng();
+
 	writer.EndObject();
+
+	if (!segmentBasePath.empty()) {
+		++segment.physicsFrames;
+		if ((segmentOptions.maxPhysicsFrames != 0 && segment.physicsFrames >= segmentOptions.maxPhysicsFrames)
+			|| (segmentOptions.maxBytes != 0 && stream.Position() >= segmentOptions.maxBytes)) {
+			FinishSegment();
+			segmentPending = true;
+			return;
+		}
+	}
+
+	if (durability.enabled)
+		CheckpointIfDue();
+}
+
+void LogWriter::SetRng(const RngState &rng)
+{
+	this->rng = rng;
+	rngSet = true;
+}
+
+void LogWriter::WriteRng()
+{
+	writer.Key(KEY_RNG);
+
+	uint32_t steps;
+	if (deltaEncoding && previousRngSet && FindRngSteps(previousRng, rng, steps)) {
+		writer.Uint(steps);
+	} else {
+		writer.StartObject();
+		writer.Key(KEY_IDUM);
+		writer.Int(rng.idum);
+		writer.Key(KEY_IY);
+		writer.Int(rng.iy);
+		writer.Key(KEY_IV);
+		writer.StartArray();
+		for (int32_t iv : rng.iv)
+			writer.Int(iv);
+		writer.EndArray();
+		writer.EndObject();
+	}
+
+	previousRng = rng;
+	previousRngSet = true;
+	rngSet = false;
 }
 
 void LogWriter::PushDamage(const Damage &damage)
 {
-	damageQueue.push_back(damage);
+	damages.push_back(damage);
 }
 
 void LogWriter::PushObjectMove(const ObjectMove &objectMove)
 {
-	objectMoveQueue.push_back(objectMove);
+	objectMoves.push_back(objectMove);
 }
 
 void LogWriter::StartCmdFrame(uint32_t framebulkId, uint32_t msec, double remainder)
 {
 	writer.StartObject();
 
+	if (writeIndex && (indexFramebulks.empty() || indexFramebulks.back().first != framebulkId))
+		indexFramebulks.emplace_back(framebulkId, indexPhysicsFrames.size() - 1);
+
+	if (deltaEncoding) {
+		deltaFrameFields = 0;
+		deltaPlayerStates = 0;
+
+		if (msec != deltaFrame.msec) {
+			deltaFrame.msec = msec;
+			writer.Key(KEY_MILLISECONDS);
+			writer.Uint(msec);
+		}
+		if (remainder != deltaFrame.remainder) {
+			deltaFrame.remainder = remainder;
+			writer.Key(KEY_FRAMETIME_REMAINDER);
+			WriteNumber(remainder);
+		}
+		if (framebulkId != deltaFrame.framebulkId) {
+			deltaFrame.framebulkId = framebulkId;
+			writer.Key(KEY_FRAMEBULK_ID);
+			writer.Uint(framebulkId);
+		}
+		return;
+	}
+
 	writer.Key(KEY_MILLISECONDS);
 	writer.Uint(msec);
 
 	writer.Key(KEY_FRAMETIME_REMAINDER);
-	writer.Double(remainder);
+	WriteNumber(remainder);
 
 	writer.Key(KEY_FRAMEBULK_ID);
 	writer.Uint(framebulkId);
@@ -181,190 +537,356 @@ void LogWriter::StartCmdFrame(uint32_t framebulkId, uint32_t msec, double remain
 
 void LogWriter::SetSharedSeed(uint32_t seed)
 {
+	if (deltaEncoding && !UpdateDelta(deltaFrameFields, DELTA_SHARED_SEED, deltaFrame.sharedSeed, seed))
+		return;
 	writer.Key(KEY_SHARED_SEED);
 	writer.Uint(seed);
 }
 
 void LogWriter::SetViewangles(double yaw, double pitch, double roll)
 {
+	if (deltaEncoding && !UpdateDelta(deltaFrameFields, DELTA_VIEWANGLES, deltaFrame.viewangles, yaw, pitch, roll))
+		return;
 	writer.Key(KEY_VIEWANGLES);
 	writer.StartArray();
-	writer.Double(yaw);
-	writer.Double(pitch);
-	writer.Double(roll);
+	WriteNumber(yaw);
+	WriteNumber(pitch);
+	WriteNumber(roll);
 	writer.EndArray();
 }
 
 void LogWriter::SetPunchangles(double yaw, double pitch, double roll)
 {
-	if (yaw == 0.0 && pitch == 0.0 && roll == 0.0)
+	if (deltaEncoding) {
+		if (!UpdateDelta(deltaFrameFields, DELTA_PUNCHANGLES, deltaFrame.punchangles, yaw, pitch, roll))
+			return;
+	} else if (yaw == 0.0 && pitch == 0.0 && roll == 0.0) {
 		return;
+	}
 	writer.Key(KEY_PUNCHANGLES);
 	writer.StartArray();
-	writer.Double(yaw);
-	writer.Double(pitch);
-	writer.Double(roll);
+	WriteNumber(yaw);
+	WriteNumber(pitch);
+	WriteNumber(roll);
 	writer.EndArray();
 }
 
 void LogWriter::SetButtons(uint32_t buttons)
 {
+	if (deltaEncoding && !UpdateDelta(deltaFrameFields, DELTA_BUTTONS, deltaFrame.buttons, buttons))
+		return;
 	writer.Key(KEY_BUTTONS);
 	writer.Uint(buttons);
 }
 
 void LogWriter::SetImpulse(uint32_t impulse)
 {
-	if (impulse == 0.0)
+	if (deltaEncoding) {
+		if (!UpdateDelta(deltaFrameFields, DELTA_IMPULSE, deltaFrame.impulse, impulse))
+			return;
+	} else if (impulse == 0.0) {
 		return;
+	}
 	writer.Key(KEY_IMPULSE);
 	writer.Uint(impulse);
 }
 
 void LogWriter::SetFSU(double F, double S, double U)
 {
+	if (deltaEncoding && !UpdateDelta(deltaFrameFields, DELTA_FSU, deltaFrame.FSU, F, S, U))
+		return;
 	writer.Key(KEY_FSU);
 	writer.StartArray();
-	writer.Double(F);
-	writer.Double(S);
-	writer.Double(U);
+	WriteNumber(F);
+	WriteNumber(S);
+	WriteNumber(U);
 	writer.EndArray();
 }
 
 void LogWriter::SetEntFriction(double friction)
 {
-	if (friction == 1.0)
+	if (deltaEncoding) {
+		if (!UpdateDelta(deltaFrameFields, DELTA_ENT_FRICTION, deltaFrame.entFriction, friction))
+			return;
+	} else if (friction == 1.0) {
 		return;
+	}
 	writer.Key(KEY_ENT_FRICTION);
-	writer.Double(friction);
+	WriteNumber(friction);
 }
 
 void LogWriter::SetEntGravity(double gravity)
 {
-	if (gravity == 1.0)
+	if (deltaEncoding) {
+		if (!UpdateDelta(deltaFrameFields, DELTA_ENT_GRAVITY, deltaFrame.entGravity, gravity))
+			return;
+	} else if (gravity == 1.0) {
 		return;
+	}
 	writer.Key(KEY_ENT_GRAVITY);
-	writer.Double(gravity);
+	WriteNumber(gravity);
 }
 
 void LogWriter::PushConsolePrint(const char *message)
 {
-	consolePrintQueue.push_back(message);
+	const size_t length = std::strlen(message);
+	consolePrints.emplace_back(consolePrintArena.size(), length);
+	consolePrintArena.insert(consolePrintArena.end(), message, message + length);
 }
 
 void LogWriter::PushCollision(const Collision &collision)
 {
-	collisionQueue.push_back(collision);
+	this->collisions.push_back(collision);
 }
 
-void LogWriter::SetCollisions(const std::deque<Collision> collisions)
+void LogWriter::SetCollisions(const Collision *collisions, size_t count)
 {
-	collisionQueue = collisions;
+	this->collisions.assign(collisions, collisions + count);
+}
+
+void LogWriter::SetCollisions(const std::deque<Collision> &collisions)
+{
+	this->collisions.assign(collisions.begin(), collisions.end());
 }
 
 void LogWriter::StartPrePlayer()
 {
+	if (deltaEncoding) {
+		StartDeltaPlayerState(KEY_PRE_PLAYERMOVE);
+		return;
+	}
 	writer.Key(KEY_PRE_PLAYERMOVE);
 	writer.StartObject();
 }
 
 void LogWriter::EndPrePlayer()
 {
+	if (deltaEncoding) {
+		EndDeltaPlayerState();
+		deltaPlayerStates |= DELTA_PRE_PLAYERMOVE;
+		return;
+	}
 	writer.EndObject();
 }
 
 void LogWriter::StartPostPlayer()
 {
+	if (deltaEncoding) {
+		// The post-PM state is encoded against the pre-PM state.
+		if (!(deltaPlayerStates & DELTA_PRE_PLAYERMOVE)) {
+			StartPrePlayer();
+			EndPrePlayer();
+		}
+		StartDeltaPlayerState(KEY_POST_PLAYERMOVE);
+		return;
+	}
 	writer.Key(KEY_POST_PLAYERMOVE);
 	writer.StartObject();
 }
 
 void LogWriter::EndPostPlayer()
 {
+	if (deltaEncoding) {
+		EndDeltaPlayerState();
+		deltaPlayerStates |= DELTA_POST_PLAYERMOVE;
+		return;
+	}
 	writer.EndObject();
 }
 
+void LogWriter::StartDeltaPlayerState(const char *key)
+{
+	deltaPlayerFields = 0;
+	deltaPlayerKey = key;
+	deltaPlayerOpen = false;
+}
+
+void LogWriter::EndDeltaPlayerState()
+{
+	WritePlayerStateDefaults();
+	if (deltaPlayerOpen)
+		writer.EndObject();
+	deltaPlayerKey = nullptr;
+	deltaPlayerOpen = false;
+}
+
+// Player state objects without changes are left out of delta encoded logs.
+void LogWriter::OpenPlayerState()
+{
+	if (!deltaPlayerKey)
+		return;
+	writer.Key(deltaPlayerKey);
+	writer.StartObject();
+	deltaPlayerKey = nullptr;
+	deltaPlayerOpen = true;
+}
+
+// Unset fields have their default values, which are only implied by an
+// absent key when the log is not delta encoded.
+void LogWriter::WritePlayerStateDefaults()
+{
+	const float zero[3] = {0, 0, 0};
+	if (!(deltaPlayerFields & DELTA_POSITION))
+		SetPosition(zero);
+	if (!(deltaPlayerFields & DELTA_VELOCITY))
+		SetVelocity(zero);
+	if (!(deltaPlayerFields & DELTA_BASEVELOCITY))
+		SetBaseVelocity(zero);
+	if (!(deltaPlayerFields & DELTA_ONGROUND))
+		SetOnGround(false);
+	if (!(deltaPlayerFields & DELTA_ONLADDER))
+		SetOnLadder(false);
+	if (!(deltaPlayerFields & DELTA_WATERLEVEL))
+		SetWaterLevel(0);
+	if (!(deltaPlayerFields & DELTA_DUCK_STATE))
+		SetDuckState(UNDUCKED);
+}
+
+void LogWriter::WriteCommandFrameDefaults()
+{
+	if (!(deltaFrameFields & DELTA_SHARED_SEED))
+		SetSharedSeed(0);
+	if (!(deltaFrameFields & DELTA_VIEWANGLES))
+		SetViewangles(0, 0, 0);
+	if (!(deltaFrameFields & DELTA_PUNCHANGLES))
+		SetPunchangles(0, 0, 0);
+	if (!(deltaFrameFields & DELTA_BUTTONS))
+		SetButtons(0);
+	if (!(deltaFrameFields & DELTA_IMPULSE))
+		SetImpulse(0);
+	if (!(deltaFrameFields & DELTA_FSU))
+		SetFSU(0, 0, 0);
+	if (!(deltaFrameFields & DELTA_ENT_FRICTION))
+		SetEntFriction(1);
+	if (!(deltaFrameFields & DELTA_ENT_GRAVITY))
+		SetEntGravity(1);
+	if (!(deltaFrameFields & DELTA_HEALTH))
+		SetHealth(0);
+	if (!(deltaFrameFields & DELTA_ARMOR))
+		SetArmor(0);
+}
+
 void LogWriter::SetPosition(const float position[3])
 {
+	if (deltaEncoding && !UpdateDelta(deltaPlayerFields, DELTA_POSITION, deltaPlayer.position, position[0], position[1], position[2]))
+		return;
+	OpenPlayerState();
 	writer.Key(KEY_POSITION);
 	writer.StartArray();
-	writer.Double(position[0]);
-	writer.Double(position[1]);
-	writer.Double(position[2]);
+	WriteNumber(position[0]);
+	WriteNumber(position[1]);
+	WriteNumber(position[2]);
 	writer.EndArray();
 }
 
 void LogWriter::SetVelocity(const float velocity[3])
 {
+	if (deltaEncoding && !UpdateDelta(deltaPlayerFields, DELTA_VELOCITY, deltaPlayer.velocity, velocity[0], velocity[1], velocity[2]))
+		return;
+	OpenPlayerState();
 	writer.Key(KEY_VELOCITY);
 	writer.StartArray();
-	writer.Double(velocity[0]);
-	writer.Double(velocity[1]);
-	writer.Double(velocity[2]);
+	WriteNumber(velocity[0]);
+	WriteNumber(velocity[1]);
+	WriteNumber(velocity[2]);
 	writer.EndArray();
 }
 
 void LogWriter::SetBaseVelocity(const float baseVelocity[3])
 {
-	if (baseVelocity[0] == 0.0 && baseVelocity[1] == 0.0 && baseVelocity[2] == 0.0)
+	if (deltaEncoding) {
+		if (!UpdateDelta(deltaPlayerFields, DELTA_BASEVELOCITY, deltaPlayer.baseVelocity, baseVelocity[0], baseVelocity[1], baseVelocity[2]))
+			return;
+		OpenPlayerState();
+	} else if (baseVelocity[0] == 0.0 && baseVelocity[1] == 0.0 && baseVelocity[2] == 0.0) {
 		return;
+	}
 	writer.Key(KEY_BASEVELOCITY);
 	writer.StartArray();
-	writer.Double(baseVelocity[0]);
-	writer.Double(baseVelocity[1]);
-	writer.Double(baseVelocity[2]);
+	WriteNumber(baseVelocity[0]);
+	WriteNumber(baseVelocity[1]);
+	WriteNumber(baseVelocity[2]);
 	writer.EndArray();
 }
 
 void LogWriter::SetOnGround(bool onGround)
 {
+	if (deltaEncoding && !UpdateDelta(deltaPlayerFields, DELTA_ONGROUND, deltaPlayer.onGround, onGround))
+		return;
+	OpenPlayerState();
 	writer.Key(KEY_ONGROUND);
 	writer.Bool(onGround);
 }
 
 void LogWriter::SetOnLadder(bool onLadder)
 {
-	if (!onLadder)
+	if (deltaEncoding) {
+		if (!UpdateDelta(deltaPlayerFields, DELTA_ONLADDER, deltaPlayer.onLadder, onLadder))
+			return;
+		OpenPlayerState();
+	} else if (!onLadder) {
 		return;
+	}
 	writer.Key(KEY_ONLADDER);
 	writer.Bool(onLadder);
 }
 
 void LogWriter::SetWaterLevel(uint32_t waterLevel)
 {
-	if (waterLevel == 0.0)
+	if (deltaEncoding) {
+		if (!UpdateDelta(deltaPlayerFields, DELTA_WATERLEVEL, deltaPlayer.waterLevel, waterLevel))
+			return;
+		OpenPlayerState();
+	} else if (waterLevel == 0.0) {
 		return;
+	}
 	writer.Key(KEY_WATERLEVEL);
 	writer.Uint(waterLevel);
 }
 
 void LogWriter::SetDuckState(DuckState duckState)
 {
-	if (duckState == UNDUCKED)
+	if (deltaEncoding) {
+		if (!UpdateDelta(deltaPlayerFields, DELTA_DUCK_STATE, deltaPlayer.duckState, static_cast<uint32_t>(duckState)))
+			return;
+		OpenPlayerState();
+	} else if (duckState == UNDUCKED) {
 		return;
+	}
 	writer.Key(KEY_DUCK_STATE);
 	writer.Uint(duckState);
 }
 
 void LogWriter::SetHealth(double health)
 {
+	if (deltaEncoding && !UpdateDelta(deltaFrameFields, DELTA_HEALTH, deltaFrame.health, health))
+		return;
 	writer.Key(KEY_HEALTH);
-	writer.Double(health);
+	WriteNumber(health);
 }
 
 void LogWriter::SetArmor(double armor)
 {
+	if (deltaEncoding && !UpdateDelta(deltaFrameFields, DELTA_ARMOR, deltaFrame.armor, armor))
+		return;
 	writer.Key(KEY_ARMOR);
-	writer.Double(armor);
+	WriteNumber(armor);
 }
 
 void LogWriter::EndCmdFrame()
 {
-	if (!collisionQueue.empty()) {
+	if (deltaEncoding) {
+		if (!(deltaPlayerStates & DELTA_POST_PLAYERMOVE)) {
+			StartPostPlayer();
+			EndPostPlayer();
+		}
+		WriteCommandFrameDefaults();
+	}
+
+	if (!collisions.empty()) {
 		writer.Key(KEY_COLLISIONS);
 		writer.StartArray();
-		while (!collisionQueue.empty()) {
-			const Collision &collision = collisionQueue.front();
+		for (const Collision &collision : collisions) {
 			writer.StartObject();
 
 			writer.Key(KEY_COLLISION_ENTITY);
@@ -372,26 +894,229 @@ void LogWriter::EndCmdFrame()
 
 			writer.Key(KEY_COLLISION_PLANE_NORMAL);
 			writer.StartArray();
-			writer.Double(collision.normal[0]);
-			writer.Double(collision.normal[1]);
-			writer.Double(collision.normal[2]);
+			WriteNumber(collision.normal[0]);
+			WriteNumber(collision.normal[1]);
+			WriteNumber(collision.normal[2]);
 			writer.EndArray();
 
 			writer.Key(KEY_COLLISION_PLANE_DISTANCE);
-			writer.Double(collision.distance);
+			WriteNumber(collision.distance);
 
 			writer.Key(KEY_COLLISION_IMPACT_VELOCITY);
 			writer.StartArray();
-			writer.Double(collision.impactVelocity[0]);
-			writer.Double(collision.impactVelocity[1]);
-			writer.Double(collision.impactVelocity[2]);
+			WriteNumber(collision.impactVelocity[0]);
+			WriteNumber(collision.impactVelocity[1]);
+			WriteNumber(collision.impactVelocity[2]);
 			writer.EndArray();
 
 			writer.EndObject();
-			collisionQueue.pop_front();
 		}
 		writer.EndArray();
+		collisions.clear();
 	}
 
 	writer.EndObject();
 }
+
+// Puts ,"key": or, for the first key of an object, "key":.
+template<size_t N>
+static inline void PutKey(OutputStream &stream, const char (&key)[N], bool first = false)
+{
+	if (!first)
+		stream.Put(',');
+	stream.Put('"');
+	stream.Put(key, N - 1);
+	stream.Put('"');
+	stream.Put(':');
+}
+
+static inline void PutUint(OutputStream &stream, uint32_t value)
+{
+	char buffer[16];
+	stream.Put(buffer, rapidjson::internal::u32toa(value, buffer) - buffer);
+}
+
+static inline void PutInt(OutputStream &stream, int32_t value)
+{
+	char buffer[16];
+	stream.Put(buffer, rapidjson::internal::i32toa(value, buffer) - buffer);
+}
+
+static inline void PutBool(OutputStream &stream, bool value)
+{
+	if (value)
+		stream.Put("true", 4);
+	else
+		stream.Put("false", 5);
+}
+
+// Formats numbers like WriteNumber.
+void LogWriter::PutNumber(double value)
+{
+	char buffer[32];
+	if (numberFormat == NUMBER_FORMAT_FLOAT) {
+		const size_t length = FormatShortestFloat(static_cast<float>(value), buffer);
+		if (length != 0) {
+			stream.Put(buffer, length);
+			return;
+		}
+	}
+
+	// rapidjson::Writer writes nothing for NaN and infinity.
+	if (std::isfinite(value))
+		stream.Put(buffer, rapidjson::internal::dtoa(value, buffer) - buffer);
+}
+
+void LogWriter::PutVector(double x, double y, double z)
+{
+	stream.Put('[');
+	PutNumber(x);
+	stream.Put(',');
+	PutNumber(y);
+	stream.Put(',');
+	PutNumber(z);
+	stream.Put(']');
+}
+
+void LogWriter::PutPlayerState(const PlayerStateRecord &playerState)
+{
+	stream.Put('{');
+
+	PutKey(stream, KEY_POSITION, true);
+	PutVector(playerState.position[0], playerState.position[1], playerState.position[2]);
+
+	PutKey(stream, KEY_VELOCITY);
+	PutVector(playerState.velocity[0], playerState.velocity[1], playerState.velocity[2]);
+
+	if (playerState.baseVelocity[0] != 0.0 || playerState.baseVelocity[1] != 0.0 || playerState.baseVelocity[2] != 0.0) {
+		PutKey(stream, KEY_BASEVELOCITY);
+		PutVector(playerState.baseVelocity[0], playerState.baseVelocity[1], playerState.baseVelocity[2]);
+	}
+
+	PutKey(stream, KEY_ONGROUND);
+	PutBool(stream, playerState.onGround);
+
+	if (playerState.onLadder) {
+		PutKey(stream, KEY_ONLADDER);
+		PutBool(stream, true);
+	}
+
+	if (playerState.waterLevel != 0) {
+		PutKey(stream, KEY_WATERLEVEL);
+		PutUint(stream, playerState.waterLevel);
+	}
+
+	if (playerState.duckState != UNDUCKED) {
+		PutKey(stream, KEY_DUCK_STATE);
+		PutUint(stream, playerState.duckState);
+	}
+
+	stream.Put('}');
+}
+
+// The output is the same as from the individual calls. The command frame
+// object is opened and closed through the writer, which takes care of the
+// separator in the command frame list, and the contents are put straight
+// into the stream.
+void LogWriter::WriteCommandFrame(const CommandFrameRecord &frame)
+{
+	// Delta encoding compares every field on its own.
+	if (deltaEncoding) {
+		WriteCommandFrameCalls(*this, frame);
+		return;
+	}
+
+	if (writeIndex && (indexFramebulks.empty() || indexFramebulks.back().first != frame.framebulkId))
+		indexFramebulks.emplace_back(frame.framebulkId, indexPhysicsFrames.size() - 1);
+
+	writer.StartObject();
+
+	PutKey(stream, KEY_MILLISECONDS, true);
+	PutUint(stream, frame.msec);
+
+	PutKey(stream, KEY_FRAMETIME_REMAINDER);
+	PutNumber(frame.frameTimeRemainder);
+
+	PutKey(stream, KEY_FRAMEBULK_ID);
+	PutUint(stream, frame.framebulkId);
+
+	PutKey(stream, KEY_SHARED_SEED);
+	PutUint(stream, frame.sharedSeed);
+
+	PutKey(stream, KEY_VIEWANGLES);
+	PutVector(frame.viewangles[0], frame.viewangles[1], frame.viewangles[2]);
+
+	if (frame.punchangles[0] != 0.0 || frame.punchangles[1] != 0.0 || frame.punchangles[2] != 0.0) {
+		PutKey(stream, KEY_PUNCHANGLES);
+		PutVector(frame.punchangles[0], frame.punchangles[1], frame.punchangles[2]);
+	}
+
+	PutKey(stream, KEY_BUTTONS);
+	PutUint(stream, frame.buttons);
+
+	if (frame.impulse != 0) {
+		PutKey(stream, KEY_IMPULSE);
+		PutUint(stream, frame.impulse);
+	}
+
+	PutKey(stream, KEY_FSU);
+	PutVector(frame.FSU[0], frame.FSU[1], frame.FSU[2]);
+
+	if (frame.entFriction != 1.0) {
+		PutKey(stream, KEY_ENT_FRICTION);
+		PutNumber(frame.entFriction);
+	}
+
+	if (frame.entGravity != 1.0) {
+		PutKey(stream, KEY_ENT_GRAVITY);
+		PutNumber(frame.entGravity);
+	}
+
+	PutKey(stream, KEY_HEALTH);
+	PutNumber(frame.health);
+
+	PutKey(stream, KEY_ARMOR);
+	PutNumber(frame.armor);
+
+	PutKey(stream, KEY_PRE_PLAYERMOVE);
+	PutPlayerState(frame.prePMState);
+
+	PutKey(stream, KEY_POST_PLAYERMOVE);
+	PutPlayerState(frame.postPMState);
+
+	if (frame.collisionCount != 0) {
+		PutKey(stream, KEY_COLLISIONS);
+		stream.Put('[');
+		for (size_t i = 0; i < frame.collisionCount; ++i) {
+			const Collision &collision = frame.collisions[i];
+			if (i != 0)
+				stream.Put(',');
+			stream.Put('{');
+
+			PutKey(stream, KEY_COLLISION_ENTITY, true);
+			PutInt(stream, collision.entity);
+
+			PutKey(stream, KEY_COLLISION_PLANE_NORMAL);
+			PutVector(collision.normal[0], collision.normal[1], collision.normal[2]);
+
+			PutKey(stream, KEY_COLLISION_PLANE_DISTANCE);
+			PutNumber(collision.distance);
+
+			PutKey(stream, KEY_COLLISION_IMPACT_VELOCITY);
+			PutVector(collision.impactVelocity[0], collision.impactVelocity[1], collision.impactVelocity[2]);
+
+			stream.Put('}');
+		}
+		stream.Put(']');
+	}
+
+	// Collisions pushed for this frame are replaced, as with SetCollisions.
+	collisions.clear();
+	writer.EndObject();
+}
+
+void LogWriter::WriteCommandFrames(const CommandFrameRecord *frames, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		WriteCommandFrame(frames[i]);
+}
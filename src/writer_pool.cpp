@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include "taslogger/writer_pool.hpp"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+using namespace TASLogger;
+
+#ifdef IOV_MAX
+static const size_t MAX_IOVECS = IOV_MAX;
+#else
+static const size_t MAX_IOVECS = 16;
+#endif
+
+PooledSink::PooledSink(LogWriterPool &pool, int fd)
+	: pool(pool),
+	fd(fd),
+	openTime(std::chrono::steady_clock::now()),
+	writing(false),
+	failed(false),
+	bytesQueued(0),
+	bytesWritten(0),
+	writeCalls(0),
+	maxQueueDepth(0)
+{
+	current.size = 0;
+}
+
+PooledSink::~PooledSink()
+{
+	Finish();
+	pool.RemoveSink(this);
+}
+
+bool PooledSink::Write(const char *data, size_t size)
+{
+	while (size != 0) {
+		size_t available;
+		char *dest = Reserve(1, available);
+		const size_t n = std::min(size, available);
+		std::memcpy(dest, data, n);
+		Commit(n);
+		data += n;
+		size -= n;
+	}
+
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	return !failed;
+}
+
+bool PooledSink::Finish()
+{
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	pool.chunksWritten.wait(lock, [this] { return queue.empty() && !writing; });
+	return !failed;
+}
+
+char *PooledSink::Reserve(size_t minSize, size_t &size)
+{
+	if (current.data.empty()) {
+		std::unique_lock<std::mutex> lock(pool.mutex);
+		pool.chunksWritten.wait(lock, [this] { return queue.size() < pool.options.maxQueuedChunks; });
+		if (!freeChunks.empty()) {
+			current = std::move(freeChunks.back());
+			freeChunks.pop_back();
+		}
+	}
+
+	if (current.data.size() < minSize || current.data.size() < pool.options.chunkSize)
+		current.data.resize(std::max(minSize, pool.options.chunkSize));
+
+	size = current.data.size();
+	return current.data.data();
+}
+
+bool PooledSink::Commit(size_t size)
+{
+	current.size = size;
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		queue.push_back(std::move(current));
+		bytesQueued += size;
+		maxQueueDepth = std::max(maxQueueDepth, queue.size());
+	}
+	pool.workQueued.notify_one();
+
+	current = Chunk();
+	current.size = 0;
+	return true;
+}
+
+PooledSinkStats PooledSink::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(pool.mutex);
+
+	PooledSinkStats stats;
+	stats.bytesQueued = bytesQueued;
+	stats.bytesWritten = bytesWritten;
+	stats.writeCalls = writeCalls;
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - openTime).count();
+	stats.throughput = seconds > 0 ? bytesWritten / seconds : 0;
+	stats.queueDepth = queue.size();
+	stats.maxQueueDepth = maxQueueDepth;
+	stats.failed = failed;
+	return stats;
+}
+
+// Writes the chunks with as few calls as possible. Returns false on an error.
+bool LogWriterPool::WriteChunks(int fd, const std::vector<PooledSink::Chunk> &chunks, uint64_t &writeCalls)
+{
+#ifdef _WIN32
+	for (const PooledSink::Chunk &chunk : chunks) {
+		const char *data = chunk.data.data();
+		size_t size = chunk.size;
+		while (size != 0) {
+			const int n = _write(fd, data, static_cast<unsigned>(std::min<size_t>(size, 1 << 30)));
+			++writeCalls;
+			if (n < 0)
+				return false;
+			data += n;
+			size -= static_cast<size_t>(n);
+		}
+	}
+	return true;
+#else
+	std::vector<iovec> iovecs(chunks.size());
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		iovecs[i].iov_base = const_cast<char *>(chunks[i].data.data());
+		iovecs[i].iov_len = chunks[i].size;
+	}
+
+	size_t first = 0;
+	while (first < iovecs.size()) {
+		const int count = static_cast<int>(std::min(iovecs.size() - first, MAX_IOVECS));
+		const ssize_t n = writev(fd, &iovecs[first], count);
+		++writeCalls;
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		// Skip what was written, which may end in the middle of a chunk.
+		size_t written = static_cast<size_t>(n);
+		while (first < iovecs.size() && written >= iovecs[first].iov_len) {
+			written -= iovecs[first].iov_len;
+			++first;
+		}
+		if (written != 0) {
+			iovecs[first].iov_base = static_cast<char *>(iovecs[first].iov_base) + written;
+			iovecs[first].iov_len -= written;
+		}
+	}
+	return true;
+#endif
+}
+
+LogWriterPool::LogWriterPool()
+	: LogWriterPool(LogWriterPoolOptions())
+{
+}
+
+LogWriterPool::LogWriterPool(const LogWriterPoolOptions &options)
+	: options(options), stopping(false)
+{
+	thread = std::thread(&LogWriterPool::Run, this);
+}
+
+LogWriterPool::~LogWriterPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	workQueued.notify_one();
+	thread.join();
+}
+
+std::unique_ptr<PooledSink> LogWriterPool::OpenSink(int fd)
+{
+	std::unique_ptr<PooledSink> sink(new PooledSink(*this, fd));
+	std::lock_guard<std::mutex> lock(mutex);
+	sinks.push_back(sink.get());
+	return sink;
+}
+
+void LogWriterPool::RemoveSink(PooledSink *sink)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	sinks.erase(std::remove(sinks.begin(), sinks.end(), sink), sinks.end());
+}
+
+void LogWriterPool::Run()
+{
+	std::vector<Batch> batches;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		const auto hasWork = [this] {
+			for (const PooledSink *sink : sinks) {
+				if (!sink->queue.empty())
+					return true;
+			}
+			return false;
+		};
+		workQueued.wait(lock, [&] { return stopping || hasWork(); });
+		if (!hasWork())
+			break;
+
+		batches.clear();
+		for (PooledSink *sink : sinks) {
+			if (sink->queue.empty())
+				continue;
+			batches.push_back(Batch());
+			batches.back().sink = sink;
+			for (PooledSink::Chunk &chunk : sink->queue)
+				batches.back().chunks.push_back(std::move(chunk));
+			sink->queue.clear();
+			sink->writing = true;
+		}
+
+		lock.unlock();
+		std::vector<uint64_t> writeCalls(batches.size(), 0);
+		std::vector<bool> ok(batches.size());
+		for (size_t i = 0; i < batches.size(); ++i)
+			ok[i] = WriteChunks(batches[i].sink->fd, batches[i].chunks, writeCalls[i]);
+		lock.lock();
+
+		for (size_t i = 0; i < batches.size(); ++i) {
+			PooledSink *sink = batches[i].sink;
+			for (PooledSink::Chunk &chunk : batches[i].chunks) {
+				sink->bytesWritten += chunk.size;
+				sink->freeChunks.push_back(std::move(chunk));
+			}
+			sink->writeCalls += writeCalls[i];
+			if (!ok[i])
+				sink->failed = true;
+			sink->writing = false;
+		}
+		chunksWritten.notify_all();
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace TASLogger
+{
+	struct ArenaStats
+	{
+		// Allocations served from the arena blocks.
+		uint64_t allocationCount;
+		// Allocations too large for a block, passed on to operator new.
+		uint64_t largeAllocationCount;
+		uint64_t largeDeallocationCount;
+		size_t blockCount;
+		size_t bytesReserved;
+		size_t bytesUsed;
+	};
+
+	// A monotonic allocator. Memory is handed out from large blocks and only
+	// given back when the arena is destroyed, so that building and tearing
+	// down a log with millions of small containers takes a handful of calls
+	// to the system allocator. Large allocations, such as the growing
+	// physics frame list, bypass the blocks so their old buffers are freed.
+	class Arena
+	{
+	public:
+		Arena();
+		~Arena();
+
+		void *Allocate(size_t size, size_t alignment);
+		void Deallocate(void *p, size_t size);
+
+		ArenaStats GetStats() const;
+
+		// The arena used by default-constructed ArenaAllocators on this
+		// thread, or nullptr if there is none.
+		static Arena *Current();
+
+	private:
+		Arena(const Arena &) = delete;
+		Arena &operator=(const Arena &) = delete;
+
+		static const size_t FIRST_BLOCK_SIZE = 1 << 16;
+		static const size_t MAX_BLOCK_SIZE = 1 << 24;
+		static const size_t LARGE_ALLOCATION_SIZE = 1 << 16;
+
+		std::vector<char *> blocks;
+		char *cursor;
+		char *blockEnd;
+		size_t nextBlockSize;
+		ArenaStats stats;
+	};
+
+	// Makes an arena the current one on this thread for its lifetime.
+	class ArenaScope
+	{
+	public:
+		explicit ArenaScope(Arena *arena);
+		~ArenaScope();
+
+	private:
+		ArenaScope(const ArenaScope &) = delete;
+		ArenaScope &operator=(const ArenaScope &) = delete;
+
+		Arena *previous;
+	};
+
+	// Allocates from the arena that was current when the allocator was
+	// constructed, or from the heap if there was none. Containers keep their
+	// allocator, so a container created inside an ArenaScope keeps using the
+	// arena after the scope ends.
+	template<typename T>
+	struct ArenaAllocator
+	{
+		typedef T value_type;
+		typedef std::true_type propagate_on_container_copy_assignment;
+		typedef std::true_type propagate_on_container_move_assignment;
+		typedef std::true_type propagate_on_container_swap;
+
+		ArenaAllocator() : arena(Arena::Current()) {}
+		explicit ArenaAllocator(Arena *arena) : arena(arena) {}
+		template<typename U> ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+		T *allocate(size_t count)
+		{
+			if (!arena)
+				return static_cast<T *>(::operator new(count * sizeof(T)));
+			return static_cast<T *>(arena->Allocate(count * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T *p, size_t count)
+		{
+			if (!arena)
+				::operator delete(p);
+			else
+				arena->Deallocate(p, count * sizeof(T));
+		}
+
+		template<typename U> struct rebind { typedef ArenaAllocator<U> other; };
+
+		Arena *arena;
+	};
+
+	template<typename T, typename U>
+	inline bool operator==(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) { return lhs.arena == rhs.arena; }
+	template<typename T, typename U>
+	inline bool operator!=(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) { return lhs.arena != rhs.arena; }
+}
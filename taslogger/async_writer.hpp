@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+#include "taslogger/common.hpp"
+#include "taslogger/writer.hpp"
+
+namespace TASLogger
+{
+	enum BackpressurePolicy : uint32_t
+	{
+		// Wait on the game thread until the writer thread frees enough space.
+		BLOCK_WHEN_FULL = 0,
+		// Discard the whole physics frame that did not fit.
+		DROP_WHEN_FULL,
+		// Double the ring up to maxCapacity, then block.
+		GROW_WHEN_FULL
+	};
+
+	struct AsyncWriterOptions
+	{
+		size_t capacity = 1 << 20;
+		size_t maxCapacity = 1 << 26;
+		BackpressurePolicy policy = BLOCK_WHEN_FULL;
+		NumberFormat numberFormat = NUMBER_FORMAT_DOUBLE;
+		bool deltaEncoding = false;
+		// Unsupported compression is ignored, see IsCompressionSupported.
+		Compression compression = COMPRESSION_NONE;
+		int compressionLevel = DEFAULT_COMPRESSION_LEVEL;
+		// See LogWriter::SetIndexFile.
+		FILE *indexFile = nullptr;
+		size_t outputBufferSize = DEFAULT_OUTPUT_BUFFER_SIZE;
+		// Flushes happen on the background thread.
+		DurabilityOptions durability;
+	};
+
+	struct AsyncWriterStats
+	{
+		size_t capacity;
+		size_t highWaterMark;
+		uint64_t eventCount;
+		uint64_t fullCount;
+		uint64_t droppedFrames;
+		uint32_t growCount;
+	};
+
+	// Same interface as LogWriter, but the calls are only recorded into a
+	// single-producer single-consumer ring buffer. A background thread
+	// replays them into a LogWriter, so JSON formatting and file I/O never
+	// run on the calling thread. EndLog waits for the background thread to
+	// finish writing, after which the file may be closed.
+	class AsyncLogWriter
+	{
+	public:
+		AsyncLogWriter();
+		explicit AsyncLogWriter(const AsyncWriterOptions &options);
+		~AsyncLogWriter();
+
+		void StartLog(FILE *file, const char *toolVer, int32_t buildNumber, const char *mod);
+		// The sink is written to on the background thread and must stay alive
+		// until EndLog.
+		void StartLog(OutputSink &sink, const char *toolVer, int32_t buildNumber, const char *mod);
+		// See LogWriter::StartSegmentedLog. The segments are rolled over on
+		// the background thread.
+		void StartSegmentedLog(const char *basePath, const SegmentOptions &options, const char *toolVer, int32_t buildNumber, const char *mod);
+		void EndLog();
+
+		void StartPhysicsFrame(double frameTime, int32_t clstate, bool paused, const char *cbuf);
+		void EndPhysicsFrame();
+
+		void PushConsolePrint(const char *message);
+		void PushDamage(const Damage &damage);
+		void PushObjectMove(const ObjectMove &objectMove);
+		void SetRng(const RngState &rng);
+
+		void StartCmdFrame(uint32_t framebulkId, uint32_t msec, double remainder);
+		void EndCmdFrame();
+
+		void SetSharedSeed(uint32_t seed);
+		void SetViewangles(double yaw, double pitch, double roll);
+		void SetPunchangles(double yaw, double pitch, double roll);
+		void SetButtons(uint32_t buttons);
+		void SetImpulse(uint32_t impulse);
+		void SetFSU(double F, double S, double U);
+		void SetEntFriction(double friction);
+		void SetEntGravity(double gravity);
+		void SetHealth(double health);
+		void SetArmor(double armor);
+
+		void PushCollision(const Collision &collision);
+		void SetCollisions(const Collision *collisions, size_t count);
+		void SetCollisions(const std::deque<Collision> &collisions);
+
+		void StartPrePlayer();
+		void EndPrePlayer();
+		void StartPostPlayer();
+		void EndPostPlayer();
+		void SetPosition(const float position[3]);
+		void SetVelocity(const float velocity[3]);
+		void SetBaseVelocity(const float baseVelocity[3]);
+		void SetOnGround(bool onGround);
+		void SetOnLadder(bool onLadder);
+		void SetWaterLevel(uint32_t waterLevel);
+		void SetDuckState(DuckState duckState);
+
+		// See LogWriter::WriteCommandFrame. Records the whole frame at once.
+		void WriteCommandFrame(const CommandFrameRecord &frame);
+		void WriteCommandFrames(const CommandFrameRecord *frames, size_t count);
+
+		void Clear();
+
+		AsyncWriterStats GetStats() const;
+
+	private:
+		struct Ring;
+
+		char *Reserve(uint32_t op, size_t payloadSize);
+		void Record(uint32_t op);
+		template<typename T> void Record(uint32_t op, const T &payload);
+		void RecordString(uint32_t op, const char *str);
+		void Commit();
+		void Grow(size_t recordSize);
+		void Start(FILE *file, OutputSink *sink, const char *segmentBasePath, const char *toolVer, int32_t buildNumber, const char *mod);
+		void Stop();
+		void Run();
+		bool Dispatch(uint32_t op, const char *payload);
+
+		AsyncWriterOptions options;
+		LogWriter writer;
+		std::thread thread;
+		// Only used by the background thread.
+		std::vector<Collision> commandFrameCollisions;
+		// Set while the background thread is stopped.
+		std::string segmentBasePath;
+		SegmentOptions segmentOptions;
+
+		Ring *producerRing;
+		Ring *consumerRing;
+		size_t pendingTail = 0;
+		bool inPhysicsFrame = false;
+		bool droppingFrame = false;
+
+		size_t highWaterMark = 0;
+		uint64_t eventCount = 0;
+		uint64_t fullCount = 0;
+		uint64_t droppedFrames = 0;
+		uint32_t growCount = 0;
+	};
+}
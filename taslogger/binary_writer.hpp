@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+#include "taslogger/common.hpp"
+
+namespace TASLogger
+{
+	// Writes the same data as LogWriter in the binary log format.
+	class BinaryLogWriter
+	{
+	public:
+		BinaryLogWriter();
+		~BinaryLogWriter();
+
+		void StartLog(FILE *file, const char *toolVer, int32_t buildNumber, const char *mod);
+		void EndLog();
+
+		void StartPhysicsFrame(double frameTime, int32_t clstate, bool paused, const char *cbuf);
+		void EndPhysicsFrame();
+
+		void PushConsolePrint(const char *message);
+		void PushDamage(const Damage &damage);
+		void PushObjectMove(const ObjectMove &objectMove);
+		// See LogWriter::SetRng. Binary logs always use step counts when they
+		// can.
+		void SetRng(const RngState &rng);
+
+		void StartCmdFrame(uint32_t framebulkId, uint32_t msec, double remainder);
+		void EndCmdFrame();
+
+		void SetSharedSeed(uint32_t seed);
+		void SetViewangles(double yaw, double pitch, double roll);
+		void SetPunchangles(double yaw, double pitch, double roll);
+		void SetButtons(uint32_t buttons);
+		void SetImpulse(uint32_t impulse);
+		void SetFSU(double F, double S, double U);
+		void SetEntFriction(double friction);
+		void SetEntGravity(double gravity);
+		void SetHealth(double health);
+		void SetArmor(double armor);
+
+		void PushCollision(const Collision &collision);
+		void SetCollisions(const Collision *collisions, size_t count);
+		void SetCollisions(const std::deque<Collision> &collisions);
+
+		void StartPrePlayer();
+		void EndPrePlayer();
+		void StartPostPlayer();
+		void EndPostPlayer();
+		void SetPosition(const float position[3]);
+		void SetVelocity(const float velocity[3]);
+		void SetBaseVelocity(const float baseVelocity[3]);
+		void SetOnGround(bool onGround);
+		void SetOnLadder(bool onLadder);
+		void SetWaterLevel(uint32_t waterLevel);
+		void SetDuckState(DuckState duckState);
+
+		// See LogWriter::WriteCommandFrame.
+		void WriteCommandFrame(const CommandFrameRecord &frame);
+		void WriteCommandFrames(const CommandFrameRecord *frames, size_t count);
+
+		void Clear();
+
+	private:
+		struct PlayerState
+		{
+			uint32_t bits;
+			float position[3];
+			float velocity[3];
+			float baseVelocity[3];
+			uint32_t waterLevel;
+			uint32_t duckState;
+		};
+
+		void Flush();
+		void WriteByte(uint8_t value);
+		void WriteVarint(uint64_t value);
+		void WriteSignedVarint(int64_t value);
+		void WriteFloat(float value);
+		void WriteFloats(const float values[3]);
+		void WriteString(const char *str, size_t length);
+		void WritePlayerState(const PlayerState &playerState);
+
+		FILE *file = nullptr;
+		std::vector<char> buffer;
+
+		uint32_t commandFrameBits;
+		uint32_t framebulkId;
+		uint32_t msec;
+		float remainder;
+		uint32_t sharedSeed;
+		float viewangles[3];
+		float punchangles[3];
+		uint32_t buttons;
+		uint32_t impulse;
+		float FSU[3];
+		float entFriction;
+		float entGravity;
+		float health;
+		float armor;
+		PlayerState prePlayer;
+		PlayerState postPlayer;
+		PlayerState *currentPlayer = nullptr;
+
+		std::deque<std::string> consolePrintQueue;
+		std::deque<Damage> damageQueue;
+		std::deque<Collision> collisionQueue;
+		std::deque<ObjectMove> objectMoveQueue;
+		RngState rng;
+		bool rngSet = false;
+		RngState previousRng;
+		bool previousRngSet = false;
+	};
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <new>
+#include <string>
+#include <vector>
+#include "taslogger/reader.hpp"
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <cstdlib>
+#endif
+
+namespace TASLogger
+{
+	// Hands out storage aligned to a whole cache line, so that every column
+	// can be processed with aligned vector loads.
+	template<typename T>
+	struct ColumnAllocator
+	{
+		typedef T value_type;
+		static const size_t ALIGNMENT = 64;
+
+		ColumnAllocator() {}
+		template<typename U> ColumnAllocator(const ColumnAllocator<U> &) {}
+
+		T *allocate(size_t count)
+		{
+#ifdef _WIN32
+			void *p = _aligned_malloc(count * sizeof(T), ALIGNMENT);
+#else
+			void *p = nullptr;
+			if (posix_memalign(&p, ALIGNMENT, count * sizeof(T)) != 0)
+				p = nullptr;
+#endif
+			if (!p)
+				throw std::bad_alloc();
+			return static_cast<T *>(p);
+		}
+
+		void deallocate(T *p, size_t)
+		{
+#ifdef _WIN32
+			_aligned_free(p);
+#else
+			std::free(p);
+#endif
+		}
+
+		template<typename U> struct rebind { typedef ColumnAllocator<U> other; };
+	};
+
+	template<typename T, typename U>
+	inline bool operator==(const ColumnAllocator<T> &, const ColumnAllocator<U> &) { return true; }
+	template<typename T, typename U>
+	inline bool operator!=(const ColumnAllocator<T> &, const ColumnAllocator<U> &) { return false; }
+
+	template<typename T>
+	using Column = std::vector<T, ColumnAllocator<T>>;
+
+	// One bit per row, packed 64 rows to a word.
+	class BitColumn
+	{
+	public:
+		BitColumn() : count(0) {}
+
+		inline bool operator[](size_t i) const { return (words[i / 64] >> (i % 64)) & 1; }
+		inline size_t size() const { return count; }
+		inline const Column<uint64_t> &Words() const { return words; }
+
+		void push_back(bool value)
+		{
+			if (count % 64 == 0)
+				words.push_back(0);
+			if (value)
+				words.back() |= uint64_t(1) << (count % 64);
+			++count;
+		}
+
+		void clear()
+		{
+			words.clear();
+			count = 0;
+		}
+
+	private:
+		Column<uint64_t> words;
+		size_t count;
+	};
+
+	struct Vec3Column
+	{
+		Column<float> x;
+		Column<float> y;
+		Column<float> z;
+	};
+
+	struct PlayerStateColumns
+	{
+		Vec3Column position;
+		Vec3Column velocity;
+		Vec3Column baseVelocity;
+		BitColumn onGround;
+		BitColumn onLadder;
+		Column<uint8_t> waterLevel;
+		Column<uint8_t> duckState;
+	};
+
+	// A structure-of-arrays copy of a log. Per-frame fields are stored one
+	// column per component, so that a scan over one field touches only that
+	// field. Nested lists are stored flattened, and the items of row i of the
+	// parent are those in [offsets[i], offsets[i + 1]).
+	struct ColumnarTASLog
+	{
+		ColumnarTASLog();
+
+		// Appends a physics frame, for filling the log from a
+		// PhysicsFrameCallback.
+		void Append(const ReaderPhysicsFrame &physicsFrame);
+		void Clear();
+
+		inline size_t PhysicsFrameCount() const { return frameTime.size(); }
+		inline size_t CommandFrameCount() const { return msec.size(); }
+
+		std::string toolVersion;
+		std::string gameMod;
+		int32_t buildNumber;
+
+		// One row per physics frame.
+		Column<float> frameTime;
+		BitColumn paused;
+		Column<int8_t> clientState;
+		std::vector<std::string> commandBuffer;
+		std::vector<ReaderRng> rng;
+
+		Column<uint32_t> consolePrintOffsets;
+		std::vector<std::string> consolePrints;
+
+		Column<uint32_t> damageOffsets;
+		Column<float> damageAmount;
+		Vec3Column damageDirection;
+		Column<int32_t> damageBits;
+
+		Column<uint32_t> objectMoveOffsets;
+		Vec3Column objectVelocity;
+		Vec3Column objectPosition;
+		BitColumn objectPull;
+
+		Column<uint32_t> commandFrameOffsets;
+
+		// One row per command frame.
+		Column<uint8_t> msec;
+		Column<uint8_t> buttons;
+		Column<uint8_t> impulse;
+		Column<uint32_t> framebulkId;
+		Column<uint32_t> sharedSeed;
+		Column<float> frameTimeRemainder;
+		Vec3Column viewangles;
+		Vec3Column punchangles;
+		Vec3Column FSU;
+		Column<float> entFriction;
+		Column<float> entGravity;
+		Column<float> health;
+		Column<float> armor;
+		PlayerStateColumns prePMState;
+		PlayerStateColumns postPMState;
+
+		Column<uint32_t> collisionOffsets;
+		Vec3Column collisionNormal;
+		Column<float> collisionDistance;
+		Vec3Column collisionImpactVelocity;
+		Column<int32_t> collisionEntity;
+	};
+
+	// Parses a JSON or binary log straight into columns, one physics frame at
+	// a time, without building the whole TASLog first.
+	rapidjson::ParseResult ParseFileColumnar(FILE *file, ColumnarTASLog &tasLog);
+}
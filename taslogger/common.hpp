@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cinttypes>
+#include <cstddef>
 
 namespace TASLogger
 {
@@ -8,6 +9,7 @@ namespace TASLogger
 	const char KEY_BUILD_NUMBER[] = "build";
 	const char KEY_MOD[] = "mod";
 	const char KEY_PHYSICS_FRAMES[] = "pf";
+	const char KEY_DELTA_ENCODED[] = "delta";
 	const char KEY_FRAMETIME[] = "ft";
 	const char KEY_CLIENT_STATE[] = "cls";
 	const char KEY_RNG[] = "rng";
@@ -54,6 +56,89 @@ namespace TASLogger
 	const char KEY_IY[] = "iy";
 	const char KEY_IV[] = "iv";
 
+	// Manifest of a segmented log, see LogManifest.
+	const char KEY_SEGMENTS[] = "segments";
+	const char KEY_SEGMENT_FILE[] = "file";
+	const char KEY_SEGMENT_PHYSICS_FRAMES[] = "frames";
+	const char KEY_COMPLETE[] = "complete";
+
+	// Binary log format. A binary log starts with the magic and a version byte,
+	// followed by tagged records. Optional fields are marked by presence bits
+	// instead of keys; integers are varints and floats are little-endian.
+	const char BINARY_MAGIC[] = "\x89TLB";
+	const size_t BINARY_MAGIC_LENGTH = sizeof(BINARY_MAGIC) - 1;
+	const uint8_t BINARY_VERSION = 1;
+
+	enum BinaryTag : uint8_t
+	{
+		TAG_END_LOG = 0,
+		TAG_PHYSICS_FRAME,
+		TAG_COMMAND_FRAME,
+		TAG_PHYSICS_FRAME_END
+	};
+
+	enum BinaryPhysicsFrameBits : uint32_t
+	{
+		PF_CLIENT_STATE = 1 << 0,
+		PF_PAUSED = 1 << 1,
+		PF_CONSOLE_MESSAGES = 1 << 2,
+		PF_DAMAGES = 1 << 3,
+		PF_OBJECT_MOVES = 1 << 4,
+		PF_RNG = 1 << 5,
+		PF_RNG_STEPS = 1 << 6
+	};
+
+	enum BinaryCommandFrameBits : uint32_t
+	{
+		CF_SHARED_SEED = 1 << 0,
+		CF_VIEWANGLES = 1 << 1,
+		CF_PUNCHANGLES = 1 << 2,
+		CF_BUTTONS = 1 << 3,
+		CF_IMPULSE = 1 << 4,
+		CF_FSU = 1 << 5,
+		CF_ENT_FRICTION = 1 << 6,
+		CF_ENT_GRAVITY = 1 << 7,
+		CF_HEALTH = 1 << 8,
+		CF_ARMOR = 1 << 9,
+		CF_PRE_PLAYERMOVE = 1 << 10,
+		CF_POST_PLAYERMOVE = 1 << 11,
+		CF_COLLISIONS = 1 << 12
+	};
+
+	// Log index format. The magic and version byte are followed by a flags
+	// byte, the physics frame count, the framebulk count and the offset of the
+	// end of the physics frame list. Then come the offsets of the physics
+	// frames and the framebulk id and first physics frame of every framebulk
+	// change. Counts and offsets are 8 bytes, ids 4, all little-endian, so
+	// that any entry can be located without reading the ones before it.
+	const char INDEX_MAGIC[] = "\x89TLI";
+	const size_t INDEX_MAGIC_LENGTH = sizeof(INDEX_MAGIC) - 1;
+	const uint8_t INDEX_VERSION = 1;
+
+	enum IndexFlags : uint8_t
+	{
+		// Offsets are into the uncompressed log.
+		INDEX_COMPRESSED = 1 << 0,
+		INDEX_DELTA_ENCODED = 1 << 1
+	};
+
+	enum BinaryPlayerStateBits : uint32_t
+	{
+		PS_POSITION = 1 << 0,
+		PS_VELOCITY = 1 << 1,
+		PS_BASEVELOCITY = 1 << 2,
+		PS_ONGROUND = 1 << 3,
+		PS_ONLADDER = 1 << 4,
+		PS_WATERLEVEL = 1 << 5,
+		PS_DUCK_STATE = 1 << 6
+	};
+
+	enum BinaryItemBits : uint8_t
+	{
+		ITEM_DAMAGE_DIRECTION = 1 << 0,
+		ITEM_OBJECT_PULL = 1 << 0
+	};
+
 	struct Damage
 	{
 		double damage;
@@ -82,4 +167,52 @@ namespace TASLogger
 		INDUCK,
 		DUCKED
 	};
+
+	struct PlayerStateRecord
+	{
+		float position[3];
+		float velocity[3];
+		float baseVelocity[3];
+		bool onGround;
+		bool onLadder;
+		uint32_t waterLevel;
+		DuckState duckState;
+	};
+
+	// A whole command frame for WriteCommandFrame, laid out like
+	// ReaderCommandFrame with the types of the individual setters.
+	struct CommandFrameRecord
+	{
+		PlayerStateRecord prePMState;
+		PlayerStateRecord postPMState;
+		// Not owned, may be nullptr if collisionCount is 0.
+		const Collision *collisions;
+		size_t collisionCount;
+		double viewangles[3];
+		double punchangles[3];
+		double FSU[3];
+		double frameTimeRemainder;
+		double entFriction;
+		double entGravity;
+		double health;
+		double armor;
+		uint32_t framebulkId;
+		uint32_t sharedSeed;
+		uint32_t msec;
+		uint32_t buttons;
+		uint32_t impulse;
+	};
+
+	// State of the engine's random number generator, ran1 from Numerical
+	// Recipes.
+	struct RngState
+	{
+		int32_t idum;
+		int32_t iy;
+		int32_t iv[32];
+	};
+
+	// Delta encoded logs give the number of ran1 calls since the previous
+	// logged state instead of the state, if it is at most this many.
+	const uint32_t RNG_MAX_STEPS = 1024;
 }
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "taslogger/reader.hpp"
+
+namespace TASLogger
+{
+	// What the first pass of LazyTASLog records about every physics frame.
+	struct PhysicsFrameSummary
+	{
+		// Byte range of the physics frame object in the log file.
+		uint64_t offset;
+		uint32_t length;
+		uint32_t commandFrameCount;
+		float frameTime;
+		bool hasConsoleMessages;
+		bool hasDamages;
+		bool hasCollisions;
+	};
+
+	struct LazyCacheStats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		size_t cachedFrames;
+		// Estimated memory of the cached frames.
+		size_t cachedBytes;
+	};
+
+	// A log that is only decoded on demand. Open maps the file and records
+	// the byte range and a summary of every physics frame, without building
+	// the frames. PhysicsFrame decodes a frame when it is first accessed and
+	// keeps the most recently used frames in a cache of limited size.
+	// Not thread-safe.
+	class LazyTASLog
+	{
+	public:
+		static const size_t DEFAULT_CACHE_CAPACITY = 64 << 20;
+
+		LazyTASLog();
+		~LazyTASLog();
+
+		// Binary, compressed and delta encoded logs are rejected with
+		// kParseErrorValueInvalid, their frames cannot be decoded on their own.
+		rapidjson::ParseResult Open(const char *filename);
+		void Close();
+
+		inline const std::string &ToolVersion() const { return toolVersion; }
+		inline const std::string &GameMod() const { return gameMod; }
+		inline int32_t BuildNumber() const { return buildNumber; }
+
+		inline size_t PhysicsFrameCount() const { return summaries.size(); }
+		inline const PhysicsFrameSummary &Summary(size_t index) const { return summaries[index]; }
+
+		// Returns nullptr if the frame cannot be decoded. The frame stays
+		// valid while it is referenced, even if the cache evicts it.
+		std::shared_ptr<const ReaderPhysicsFrame> PhysicsFrame(size_t index);
+
+		// Estimated memory that the decoded frames in the cache may use. The
+		// most recently used frame is always kept.
+		void SetCacheCapacity(size_t bytes);
+		LazyCacheStats GetCacheStats() const;
+
+	private:
+		LazyTASLog(const LazyTASLog &) = delete;
+		LazyTASLog &operator=(const LazyTASLog &) = delete;
+
+		struct CacheEntry
+		{
+			std::shared_ptr<const ReaderPhysicsFrame> frame;
+			// Position in recentlyUsed.
+			std::list<size_t>::iterator use;
+			size_t size;
+		};
+
+		void Evict();
+
+		FileMapping *mapping;
+		std::string toolVersion;
+		std::string gameMod;
+		int32_t buildNumber;
+		std::vector<PhysicsFrameSummary> summaries;
+
+		std::unordered_map<size_t, CacheEntry> cache;
+		// Frame indexes, most recently used first.
+		std::list<size_t> recentlyUsed;
+		size_t cacheCapacity;
+		LazyCacheStats stats;
+	};
+}
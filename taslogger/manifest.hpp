@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace TASLogger
+{
+	struct LogSegment
+	{
+		// Relative to the directory of the manifest.
+		std::string filename;
+		uint64_t physicsFrames;
+	};
+
+	// Lists the segment files of a log that LogWriter splits up, see
+	// LogWriter::StartSegmentedLog. Every segment is a complete log with the
+	// header of the whole log.
+	struct LogManifest
+	{
+		std::string toolVersion;
+		std::string gameMod;
+		std::vector<LogSegment> segments;
+		int32_t buildNumber = 0;
+		// Whether the log has ended. Until then only the finished segments are
+		// listed.
+		bool complete = false;
+	};
+
+	// Returns false if the file cannot be read or is not a manifest.
+	bool LoadManifest(const char *path, LogManifest &manifest);
+
+	// Replaces the manifest file in one step, so that readers see either the
+	// old or the new manifest.
+	bool SaveManifest(const char *path, const LogManifest &manifest);
+
+	// Path of the segment file, for the manifest at manifestPath.
+	std::string SegmentPath(const char *manifestPath, const LogSegment &segment);
+}
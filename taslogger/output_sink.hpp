@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace TASLogger
+{
+	// Where LogWriter writes the log. Receives the output one buffer at a
+	// time; with compression, on the compression thread.
+	class OutputSink
+	{
+	public:
+		virtual ~OutputSink() {}
+
+		virtual bool Write(const char *data, size_t size) = 0;
+		// Called after the last Write of the log.
+		virtual bool Finish() { return true; }
+
+		// Passes anything the sink buffers itself on to the operating system.
+		virtual bool Flush() { return true; }
+		// Waits until the data passed to the operating system is on disk.
+		// Called on a background thread, possibly while Write is running.
+		virtual bool Sync() { return true; }
+
+		// Sinks that keep the log in memory can have the output formatted into
+		// that memory directly. Reserve returns space for at least minSize
+		// bytes and sets size to the space available, Commit then takes the
+		// first size bytes of it. Returning nullptr falls back to Write.
+		virtual char *Reserve(size_t /*minSize*/, size_t & /*size*/) { return nullptr; }
+		virtual bool Commit(size_t /*size*/) { return false; }
+	};
+
+	class FileSink : public OutputSink
+	{
+	public:
+		explicit FileSink(FILE *file = nullptr) : file(file) {}
+
+		bool Write(const char *data, size_t size) override;
+		bool Flush() override;
+		bool Sync() override;
+
+	private:
+		FILE *file;
+	};
+
+	// Writes to a file descriptor, such as a pipe or a socket, with one write
+	// call per buffer.
+	class FdSink : public OutputSink
+	{
+	public:
+		explicit FdSink(int fd) : fd(fd) {}
+
+		bool Write(const char *data, size_t size) override;
+		bool Sync() override;
+
+	private:
+		int fd;
+	};
+
+	class MemorySink : public OutputSink
+	{
+	public:
+		MemorySink();
+
+		bool Write(const char *data, size_t size) override;
+		char *Reserve(size_t minSize, size_t &size) override;
+		bool Commit(size_t size) override;
+
+		inline const char *Data() const { return data.get(); }
+		inline size_t Size() const { return size; }
+		void Clear();
+
+	private:
+		std::unique_ptr<char[]> data;
+		size_t size;
+		size_t capacity;
+	};
+
+	// Writes to a shared memory mapping of the file. The file is created or
+	// truncated, grows in steps of at least growSize bytes and is cut to the
+	// size of the log by Finish.
+	class MappedFileSink : public OutputSink
+	{
+	public:
+		explicit MappedFileSink(size_t growSize = 64 << 20);
+		~MappedFileSink();
+
+		bool Open(const char *filename);
+
+		bool Write(const char *data, size_t size) override;
+		bool Finish() override;
+		bool Sync() override;
+		char *Reserve(size_t minSize, size_t &size) override;
+		bool Commit(size_t size) override;
+
+	private:
+		MappedFileSink(const MappedFileSink &) = delete;
+		MappedFileSink &operator=(const MappedFileSink &) = delete;
+
+		bool Map(size_t minSize);
+		void Unmap();
+
+#ifdef _WIN32
+		void *file;
+		void *mapping;
+#else
+		int fd;
+#endif
+		char *data;
+		size_t size;
+		size_t mappedSize;
+		size_t growSize;
+		// Held while the mapping or the file is replaced or closed, which
+		// Sync must not see halfway.
+		std::mutex mappingMutex;
+	};
+
+	class CallbackSink : public OutputSink
+	{
+	public:
+		// Returning false reports a write error.
+		typedef std::function<bool(const char *data, size_t size)> Callback;
+
+		explicit CallbackSink(const Callback &callback) : callback(callback) {}
+
+		bool Write(const char *data, size_t size) override { return callback(data, size); }
+
+	private:
+		Callback callback;
+	};
+}
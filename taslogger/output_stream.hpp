@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "taslogger/output_sink.hpp"
+#include "rapidjson/rapidjson.h"
+
+namespace TASLogger
+{
+	enum Compression : uint32_t
+	{
+		COMPRESSION_NONE = 0,
+		// Zstandard, only available if the library was built with zstd.
+		COMPRESSION_ZSTD
+	};
+
+	const int DEFAULT_COMPRESSION_LEVEL = 3;
+	const size_t DEFAULT_OUTPUT_BUFFER_SIZE = 65536;
+
+	bool IsCompressionSupported(Compression compression);
+
+	class CompressionThread;
+	class SyncThread;
+
+	// The RapidJSON output stream of LogWriter. Collects the output in a
+	// buffer, or in the memory of the sink if it has any, and passes it to the
+	// sink whenever the buffer is full. With compression, full buffers are
+	// handed to a helper thread instead, which compresses them and passes the
+	// result to the sink.
+	class OutputStream
+	{
+	public:
+		typedef char Ch;
+
+		OutputStream();
+		~OutputStream();
+
+		// Returns false if the compression is not supported.
+		bool Open(OutputSink &sink, Compression compression = COMPRESSION_NONE, int level = DEFAULT_COMPRESSION_LEVEL,
+			size_t bufferSize = DEFAULT_OUTPUT_BUFFER_SIZE);
+		// Passes everything to the sink and finishes it.
+		void Close();
+
+		// Whether the sink or the compression failed since Open.
+		bool Failed() const;
+
+		inline void Put(Ch c)
+		{
+			if (current == bufferEnd)
+				Flush();
+			*current++ = c;
+		}
+
+		inline void Put(const Ch *data, size_t size)
+		{
+			while (static_cast<size_t>(bufferEnd - current) < size) {
+				const size_t available = bufferEnd - current;
+				std::memcpy(current, data, available);
+				current += available;
+				data += available;
+				size -= available;
+				Flush();
+			}
+			std::memcpy(current, data, size);
+			current += size;
+		}
+
+		void Flush();
+		// Passes everything put so far on to the operating system, through the
+		// helper thread with compression. With sync, a background thread then
+		// waits for it to reach the disk.
+		void Checkpoint(bool sync);
+
+		// Number of bytes put since Open, before compression.
+		inline uint64_t Position() const { return flushedBytes + (current - bufferBegin); }
+
+		// Not an input stream.
+		Ch Peek() const { RAPIDJSON_ASSERT(false); return 0; }
+		Ch Take() { RAPIDJSON_ASSERT(false); return 0; }
+		size_t Tell() const { RAPIDJSON_ASSERT(false); return 0; }
+		Ch *PutBegin() { RAPIDJSON_ASSERT(false); return 0; }
+		size_t PutEnd(Ch *) { RAPIDJSON_ASSERT(false); return 0; }
+
+	private:
+		OutputStream(const OutputStream &) = delete;
+		OutputStream &operator=(const OutputStream &) = delete;
+
+		void ResetBuffer();
+
+		OutputSink *sink;
+		CompressionThread *compressionThread;
+		SyncThread *syncThread;
+		std::vector<char> buffer;
+		size_t bufferSize;
+		// Whether the buffer is the memory of the sink.
+		bool sinkMemory;
+		char *bufferBegin;
+		char *current;
+		char *bufferEnd;
+		uint64_t flushedBytes;
+		bool failed;
+	};
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "taslogger/reader.hpp"
+
+namespace TASLogger
+{
+	// Parts of the physics frames that a query materializes. The frame time,
+	// client state, command buffer and paused flag are always read.
+	enum QueryField : uint32_t
+	{
+		QUERY_CONSOLE_MESSAGES = 1 << 0,
+		QUERY_DAMAGES = 1 << 1,
+		QUERY_OBJECT_MOVES = 1 << 2,
+		QUERY_RNG = 1 << 3,
+		// Every command frame field but the player states and collisions.
+		QUERY_COMMAND_FRAMES = 1 << 4,
+		QUERY_PLAYER_STATES = 1 << 5,
+		QUERY_COLLISIONS = 1 << 6,
+		QUERY_ALL = (1 << 7) - 1
+	};
+
+	// A physics frame matches if it passes every filter that is set.
+	struct FrameQuery
+	{
+		uint32_t fields = QUERY_ALL;
+
+		// A command frame with a framebulk id in [firstFramebulk, lastFramebulk].
+		bool filterFramebulks = false;
+		uint32_t firstFramebulk = 0;
+		uint32_t lastFramebulk = UINT32_MAX;
+
+		// A damage with any of these bits.
+		int32_t damageBits = 0;
+
+		// A command frame whose post-PM state is on ground while the post-PM
+		// state of the command frame before it, possibly in an earlier
+		// physics frame, is not.
+		bool landing = false;
+
+		// Runs last, on the materialized fields.
+		std::function<bool(const ReaderPhysicsFrame &physicsFrame)> filter;
+	};
+
+	// Called with every matching physics frame and its index in the log. The
+	// frame is reused like with PhysicsFrameCallback. Returning false stops
+	// the query with kParseErrorTermination.
+	typedef std::function<bool(size_t index, const ReaderPhysicsFrame &physicsFrame)> QueryCallback;
+
+	// Reads only what the fields and filters of the query need: the values of
+	// the other keys of an uncompressed JSON log are skipped over without
+	// being parsed. Parts that are not needed may be missing from the
+	// frames. Delta encoded logs read the whole command frames, binary and
+	// compressed logs are read in full and filtered afterwards.
+	rapidjson::ParseResult QueryFile(const char *filename, const FrameQuery &query, TASLog &header, const QueryCallback &callback);
+
+	// Collects the matching physics frames into tasLog and their indexes
+	// into physicsFrameIndexes.
+	rapidjson::ParseResult QueryFile(const char *filename, const FrameQuery &query, TASLog &tasLog, std::vector<size_t> &physicsFrameIndexes);
+}
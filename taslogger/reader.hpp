@@ -1,7 +1,11 @@
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
+#include "arena.hpp"
 #include "common.hpp"
 #include "rapidjson/reader.h"
 
@@ -40,11 +44,12 @@ namespace TASLogger
 		uint8_t duckState;
 	};
 
-	struct ReaderCommandFrame
+	template<template<typename> class Allocator>
+	struct BasicReaderCommandFrame
 	{
 		ReaderPlayerState prePMState;
 		ReaderPlayerState postPMState;
-		std::vector<ReaderCollision> collisionList;
+		std::vector<ReaderCollision, Allocator<ReaderCollision>> collisionList;
 		float viewangles[3];
 		float punchangles[3];
 		float FSU[3];
@@ -60,33 +65,197 @@ namespace TASLogger
 		uint8_t impulse;
 	};
 
-	struct ReaderRng
+	typedef BasicReaderCommandFrame<std::allocator> ReaderCommandFrame;
+
+	typedef RngState ReaderRng;
+
+	// A string that points into memory owned by someone else, such as the
+	// file mapping of a MappedTASLog.
+	struct StringRef
 	{
-		int32_t idum;
-		int32_t iy;
-		int32_t iv[32];
+		StringRef() : data(""), length(0) {}
+		StringRef(const char *data, size_t length) : data(data), length(length) {}
+
+		inline size_t size() const { return length; }
+		inline bool empty() const { return length == 0; }
+		inline std::string str() const { return std::string(data, length); }
+
+		const char *data;
+		size_t length;
 	};
 
-	struct ReaderPhysicsFrame
+	template<typename String, template<typename> class Allocator = std::allocator>
+	struct BasicReaderPhysicsFrame
 	{
-		std::string commandBuffer;
-		std::vector<std::string> consolePrintList;
-		std::vector<ReaderCommandFrame> commandFrameList;
-		std::vector<ReaderDamage> damageList;
-		std::vector<ReaderObjectMove> objectMoveList;
+		typedef String StringType;
+		typedef BasicReaderCommandFrame<Allocator> CommandFrameType;
+		typedef std::vector<ReaderCollision, Allocator<ReaderCollision>> CollisionListType;
+
+		String commandBuffer;
+		std::vector<String, Allocator<String>> consolePrintList;
+		std::vector<CommandFrameType, Allocator<CommandFrameType>> commandFrameList;
+		std::vector<ReaderDamage, Allocator<ReaderDamage>> damageList;
+		std::vector<ReaderObjectMove, Allocator<ReaderObjectMove>> objectMoveList;
 		float frameTime;
 		bool paused;
 		int8_t clientState;
 		ReaderRng rng;
 	};
 
-	struct TASLog
+	class FileMapping;
+
+	template<typename String, template<typename> class Allocator = std::allocator>
+	struct BasicTASLog
 	{
-		std::string toolVersion;
-		std::string gameMod;
-		std::vector<ReaderPhysicsFrame> physicsFrameList;
+		typedef BasicReaderPhysicsFrame<String, Allocator> PhysicsFrameType;
+
+		String toolVersion;
+		String gameMod;
+		std::vector<PhysicsFrameType, Allocator<PhysicsFrameType>> physicsFrameList;
 		int32_t buildNumber;
 	};
 
+	typedef BasicReaderPhysicsFrame<std::string> ReaderPhysicsFrame;
+	typedef BasicTASLog<std::string> TASLog;
+
+	// A log whose strings point into a private, writable mapping of the log
+	// file, which it keeps alive until it is destroyed. The strings are
+	// null-terminated.
+	class MappedTASLog : public BasicTASLog<StringRef>
+	{
+	public:
+		MappedTASLog();
+		MappedTASLog(MappedTASLog &&other);
+		MappedTASLog &operator=(MappedTASLog &&other);
+		~MappedTASLog();
+
+		void Unmap();
+
+	private:
+		MappedTASLog(const MappedTASLog &) = delete;
+		MappedTASLog &operator=(const MappedTASLog &) = delete;
+
+		friend rapidjson::ParseResult ParseMappedFile(const char *filename, MappedTASLog &tasLog);
+
+		FileMapping *mapping;
+	};
+
+	typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+
+	// Owns the arena of an ArenaTASLog. A base class, so that the arena is
+	// destroyed after the containers allocated from it.
+	struct ArenaHolder
+	{
+		std::unique_ptr<Arena> arena;
+	};
+
+	// A log whose strings and containers are allocated from an arena that it
+	// owns, so that parsing and destroying it allocate and free a few large
+	// blocks instead of every frame separately.
+	class ArenaTASLog : private ArenaHolder, public BasicTASLog<ArenaString, ArenaAllocator>
+	{
+	public:
+		ArenaTASLog();
+
+		// Frees everything and starts over with an empty arena.
+		void Reset();
+
+		ArenaStats GetArenaStats() const;
+
+	private:
+		ArenaTASLog(const ArenaTASLog &) = delete;
+		ArenaTASLog &operator=(const ArenaTASLog &) = delete;
+
+		friend rapidjson::ParseResult ParseArenaFile(FILE *file, ArenaTASLog &tasLog);
+	};
+
+	// Called once for every completed physics frame. The frame and its buffers
+	// are reused for the next one, so copy out anything that must outlive the
+	// call. Returning false stops the parse with kParseErrorTermination.
+	typedef std::function<bool(const ReaderPhysicsFrame &physicsFrame)> PhysicsFrameCallback;
+
+	// Detects the log format from the first byte of the file. Compressed JSON
+	// logs are decompressed while parsing.
 	rapidjson::ParseResult ParseFile(FILE *file, TASLog &tasLog);
+	rapidjson::ParseResult ParseBinaryFile(FILE *file, TASLog &tasLog);
+
+	// Streaming variants: header receives everything except physicsFrameList,
+	// the physics frames are passed to callback one at a time.
+	rapidjson::ParseResult ParseFile(FILE *file, TASLog &header, const PhysicsFrameCallback &callback);
+	rapidjson::ParseResult ParseBinaryFile(FILE *file, TASLog &header, const PhysicsFrameCallback &callback);
+
+	// Where ParseFileTolerant stopped reading.
+	struct RecoveryInfo
+	{
+		// Whether the log ended early or is damaged at the end.
+		bool truncated;
+		// The error that ended the parse, if truncated.
+		rapidjson::ParseResult stopReason;
+		// Complete physics frames that were read.
+		size_t physicsFrames;
+		// Offset just past the last complete physics frame, or past the
+		// header if there is none. In the uncompressed data of compressed
+		// logs.
+		uint64_t validLength;
+	};
+
+	// Like ParseFile, but keeps every complete physics frame of a log that
+	// ends early, such as a durable log of a game that crashed before EndLog.
+	// Fails only if the header is incomplete.
+	rapidjson::ParseResult ParseFileTolerant(FILE *file, TASLog &tasLog, RecoveryInfo &recovery);
+
+	// Parses the segments listed in the manifest of a segmented log, see
+	// LogWriter::StartSegmentedLog, as one log. The streaming variant passes
+	// the physics frames of all segments to callback in order. A manifest
+	// that cannot be read fails with kParseErrorValueInvalid, a missing
+	// segment with kParseErrorDocumentEmpty.
+	rapidjson::ParseResult ParseSegmentedLog(const char *manifestPath, TASLog &tasLog);
+	rapidjson::ParseResult ParseSegmentedLog(const char *manifestPath, TASLog &header, const PhysicsFrameCallback &callback);
+
+	// Maps the JSON log file into memory and parses it in situ, so that no
+	// string is copied or allocated on the heap. Binary and compressed logs
+	// are rejected with kParseErrorValueInvalid.
+	rapidjson::ParseResult ParseMappedFile(const char *filename, MappedTASLog &tasLog);
+
+	// Parses the JSON log into the arena of tasLog. Binary logs are rejected
+	// with kParseErrorValueInvalid.
+	rapidjson::ParseResult ParseArenaFile(FILE *file, ArenaTASLog &tasLog);
+
+	// The index that LogWriter writes next to a log, see LogWriter::SetIndexFile.
+	class LogIndex
+	{
+	public:
+		LogIndex();
+
+		// Reads the whole index. Returns false if it is not a valid index.
+		bool Load(FILE *indexFile);
+
+		inline size_t PhysicsFrameCount() const { return physicsFrameOffsets.size(); }
+
+		// Returns the first physics frame with a command frame of the
+		// framebulk, or PhysicsFrameCount() if there is none.
+		size_t FindFramebulk(uint32_t framebulkId) const;
+
+	private:
+		// Offsets of the physics frame objects in the uncompressed log.
+		std::vector<uint64_t> physicsFrameOffsets;
+		// Framebulk ids and their first physics frames, sorted by id.
+		std::vector<std::pair<uint32_t, uint64_t>> framebulks;
+		uint64_t physicsFrameListEnd;
+		uint8_t flags;
+
+		friend rapidjson::ParseResult ParseFileRange(FILE *file, const LogIndex &index, size_t first, size_t count, TASLog &tasLog);
+	};
+
+	// Parses the header and physics frames [first, first + count) of the JSON
+	// log that index was written for. Reads only the header and those frames,
+	// except in compressed and delta encoded logs, which have to be parsed
+	// from the start up to the last frame of the range.
+	rapidjson::ParseResult ParseFileRange(FILE *file, const LogIndex &index, size_t first, size_t count, TASLog &tasLog);
+
+	// Maps the JSON log file into memory and parses the physics frames on
+	// threadCount threads, or one per hardware thread if it is zero. Logs that
+	// are binary, compressed or not laid out the way LogWriter writes them are
+	// parsed on the calling thread instead.
+	rapidjson::ParseResult ParseFileParallel(const char *filename, TASLog &tasLog, unsigned threadCount = 0);
 }
@@ -1,13 +1,50 @@
 #pragma once
 
+#include <chrono>
 #include <deque>
 #include <string>
+#include <utility>
+#include <vector>
 #include "taslogger/common.hpp"
+#include "taslogger/manifest.hpp"
+#include "taslogger/output_stream.hpp"
 #include "rapidjson/writer.h"
-#include "rapidjson/filewritestream.h"
 
 namespace TASLogger
 {
+	enum NumberFormat : uint32_t
+	{
+		// Print every number as a double with up to 17 significant digits.
+		NUMBER_FORMAT_DOUBLE = 0,
+		// Round every number to float, which is what the reader stores, and
+		// print the shortest string that reads back as the same float.
+		NUMBER_FORMAT_FLOAT
+	};
+
+	// Durable logs are flushed at the end of a physics frame whenever either
+	// budget runs out, so that a crash loses at most about one budget of
+	// physics frames. ParseFileTolerant reads such a log back.
+	struct DurabilityOptions
+	{
+		bool enabled = false;
+		// Milliseconds since the last flush.
+		uint32_t flushInterval = 1000;
+		// Bytes written since the last flush, before compression.
+		size_t flushBytes = 1 << 20;
+		// Also have a background thread wait until the flushed data is on
+		// disk, with fdatasync.
+		bool sync = true;
+	};
+
+	// A segmented log starts a new segment at the end of the physics frame
+	// that reaches either limit. Zero means no limit.
+	struct SegmentOptions
+	{
+		uint64_t maxPhysicsFrames = 0;
+		// Before compression.
+		uint64_t maxBytes = 0;
+	};
+
 	class LogWriter
 	{
 	public:
@@ -15,6 +52,14 @@ namespace TASLogger
 		~LogWriter();
 
 		void StartLog(FILE *file, const char *toolVer, int32_t buildNumber, const char *mod);
+		// The sink must stay alive until EndLog.
+		void StartLog(OutputSink &sink, const char *toolVer, int32_t buildNumber, const char *mod);
+		// Writes the log to the segment files basePath.0000.json,
+		// basePath.0001.json and so on, each a complete log with this header,
+		// and lists the finished segments in basePath.manifest.json for
+		// ParseSegmentedLog. No index is written. Returns false if the
+		// manifest or the first segment cannot be created.
+		bool StartSegmentedLog(const char *basePath, const SegmentOptions &options, const char *toolVer, int32_t buildNumber, const char *mod);
 		void EndLog();
 
 		void StartPhysicsFrame(double frameTime, int32_t clstate, bool paused, const char *cbuf);
@@ -23,6 +68,10 @@ namespace TASLogger
 		void PushConsolePrint(const char *message);
 		void PushDamage(const Damage &damage);
 		void PushObjectMove(const ObjectMove &objectMove);
+		// State after the physics frame. Delta encoded logs only give the
+		// number of ran1 calls since the previous state, when there are few
+		// enough of them.
+		void SetRng(const RngState &rng);
 
 		void StartCmdFrame(uint32_t framebulkId, uint32_t msec, double remainder);
 		void EndCmdFrame();
@@ -39,7 +88,8 @@ namespace TASLogger
 		void SetArmor(double armor);
 
 		void PushCollision(const Collision &collision);
-		void SetCollisions(const std::deque<Collision> collisions);
+		void SetCollisions(const Collision *collisions, size_t count);
+		void SetCollisions(const std::deque<Collision> &collisions);
 
 		void StartPrePlayer();
 		void EndPrePlayer();
@@ -53,15 +103,149 @@ namespace TASLogger
 		void SetWaterLevel(uint32_t waterLevel);
 		void SetDuckState(DuckState duckState);
 
+		// Same as StartCmdFrame, the setters of every field, both player
+		// states, SetCollisions and EndCmdFrame, but the frame is formatted
+		// in one go without the per-call bookkeeping of rapidjson::Writer.
+		void WriteCommandFrame(const CommandFrameRecord &frame);
+		void WriteCommandFrames(const CommandFrameRecord *frames, size_t count);
+
 		void Clear();
 
+		void SetNumberFormat(NumberFormat format);
+
+		// Only write the command frame and player state fields that differ
+		// from the previous command frame. Readers reconstruct the full frames.
+		// Call before StartLog.
+		void SetDeltaEncoding(bool enabled);
+
+		// Compress the log on a helper thread, the reader detects compressed
+		// logs. Returns false if the compression is not supported. Call before
+		// StartLog.
+		bool SetCompression(Compression compression, int level = DEFAULT_COMPRESSION_LEVEL);
+
+		// Write an index of the physics frames and framebulks to indexFile at
+		// EndLog, for LogIndex and ParseFileRange. Pass nullptr to stop writing
+		// indexes. Call before StartLog.
+		void SetIndexFile(FILE *indexFile);
+
+		// Size of the buffer that collects the output for the sink, unless the
+		// sink provides the memory. Call before StartLog.
+		void SetBufferSize(size_t size);
+
+		// Flush the log at physics frame boundaries, see DurabilityOptions.
+		// Call before StartLog.
+		void SetDurability(const DurabilityOptions &options);
+
+		// Whether writing to the sink, or a segment or the manifest of a
+		// segmented log, failed since StartLog.
+		bool Failed() const;
+
 	private:
-		rapidjson::Writer<rapidjson::FileWriteStream> writer;
-		rapidjson::FileWriteStream *pFileWriteStream = nullptr;
+		struct DeltaCommandFrame
+		{
+			double remainder;
+			double viewangles[3];
+			double punchangles[3];
+			double FSU[3];
+			double entFriction;
+			double entGravity;
+			double health;
+			double armor;
+			uint32_t framebulkId;
+			uint32_t msec;
+			uint32_t sharedSeed;
+			uint32_t buttons;
+			uint32_t impulse;
+		};
+
+		struct DeltaPlayerState
+		{
+			float position[3];
+			float velocity[3];
+			float baseVelocity[3];
+			bool onGround;
+			bool onLadder;
+			uint32_t waterLevel;
+			uint32_t duckState;
+		};
+
+		void WriteNumber(double value);
+		void PutNumber(double value);
+		void PutVector(double x, double y, double z);
+		void PutPlayerState(const PlayerStateRecord &playerState);
+
+		void StartDeltaPlayerState(const char *key);
+		void EndDeltaPlayerState();
+		void OpenPlayerState();
+
+		void WriteCommandFrameDefaults();
+		void WritePlayerStateDefaults();
+
+		void WriteRng();
+		void WriteHeader(const char *toolVer, int32_t buildNumber, const char *mod);
+		void WriteIndex(uint64_t physicsFrameListEnd);
+		void CheckpointIfDue();
+
+		void StartSegment();
+		void FinishSegment();
+
+		FileSink fileSink;
+		OutputStream stream;
+		rapidjson::Writer<OutputStream> writer;
+		size_t bufferSize = DEFAULT_OUTPUT_BUFFER_SIZE;
+		NumberFormat numberFormat = NUMBER_FORMAT_DOUBLE;
+		Compression compression = COMPRESSION_NONE;
+		int compressionLevel = DEFAULT_COMPRESSION_LEVEL;
+
+		DurabilityOptions durability;
+		uint64_t lastCheckpointPosition = 0;
+		std::chrono::steady_clock::time_point lastCheckpointTime;
+
+		FILE *indexFile = nullptr;
+		bool writeIndex = false;
+		std::vector<uint64_t> indexPhysicsFrames;
+		// Framebulk id and physics frame of every framebulk change.
+		std::vector<std::pair<uint32_t, uint64_t>> indexFramebulks;
+
+		// Empty unless the log is segmented. The manifest holds the header and
+		// the finished segments.
+		std::string segmentBasePath;
+		std::string manifestPath;
+		SegmentOptions segmentOptions;
+		LogManifest manifest;
+		LogSegment segment;
+		FILE *segmentFile = nullptr;
+		// The next segment is opened by the next physics frame.
+		bool segmentPending = false;
+		bool segmentFailed = false;
+
+		bool deltaEncoding = false;
+		DeltaCommandFrame deltaFrame;
+		DeltaPlayerState deltaPlayer;
+		// Fields set since the start of the command frame or player state.
+		uint32_t deltaFrameFields = 0;
+		uint32_t deltaPlayerFields = 0;
+		// Player states of the current command frame that are done.
+		uint32_t deltaPlayerStates = 0;
+		// Key of the player state object, until the object is opened by its
+		// first changed field.
+		const char *deltaPlayerKey = nullptr;
+		bool deltaPlayerOpen = false;
+
+		// Staged until the end of the frame. The buffers keep their capacity,
+		// so frames stop allocating once they have grown large enough.
+		// The text of the console messages shares one arena per physics
+		// frame, with the offset and length of each message.
+		std::vector<char> consolePrintArena;
+		std::vector<std::pair<size_t, size_t>> consolePrints;
+		std::vector<Damage> damages;
+		std::vector<Collision> collisions;
+		std::vector<ObjectMove> objectMoves;
+		RngState rng;
+		bool rngSet = false;
 
-		std::deque<std::string> consolePrintQueue;
-		std::deque<Damage> damageQueue;
-		std::deque<Collision> collisionQueue;
-		std::deque<ObjectMove> objectMoveQueue;
+		// The state that the next step count refers to.
+		RngState previousRng;
+		bool previousRngSet = false;
 	};
 }
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "taslogger/output_sink.hpp"
+
+namespace TASLogger
+{
+	struct LogWriterPoolOptions
+	{
+		// Size of the buffers that the writers format into.
+		size_t chunkSize = 1 << 18;
+		// Buffers a sink may have waiting for the I/O thread before its
+		// writer blocks.
+		size_t maxQueuedChunks = 16;
+	};
+
+	struct PooledSinkStats
+	{
+		uint64_t bytesQueued;
+		uint64_t bytesWritten;
+		uint64_t writeCalls;
+		// Bytes written per second since the sink was opened.
+		double throughput;
+		size_t queueDepth;
+		size_t maxQueueDepth;
+		bool failed;
+	};
+
+	class LogWriterPool;
+
+	// An OutputSink that queues the output for the I/O thread of a
+	// LogWriterPool. Writers format directly into the queued buffers.
+	class PooledSink : public OutputSink
+	{
+	public:
+		// Waits until everything queued has been written.
+		~PooledSink();
+
+		bool Write(const char *data, size_t size) override;
+		// Waits until everything queued has been written, after which the
+		// file descriptor may be closed.
+		bool Finish() override;
+		char *Reserve(size_t minSize, size_t &size) override;
+		bool Commit(size_t size) override;
+
+		PooledSinkStats GetStats() const;
+
+	private:
+		struct Chunk
+		{
+			std::vector<char> data;
+			size_t size;
+		};
+
+		PooledSink(LogWriterPool &pool, int fd);
+		PooledSink(const PooledSink &) = delete;
+		PooledSink &operator=(const PooledSink &) = delete;
+
+		LogWriterPool &pool;
+		const int fd;
+		const std::chrono::steady_clock::time_point openTime;
+
+		// Only used by the writer.
+		Chunk current;
+
+		// Guarded by the mutex of the pool.
+		std::deque<Chunk> queue;
+		std::vector<Chunk> freeChunks;
+		bool writing;
+		bool failed;
+		uint64_t bytesQueued;
+		uint64_t bytesWritten;
+		uint64_t writeCalls;
+		size_t maxQueueDepth;
+
+		friend class LogWriterPool;
+	};
+
+	// Writes the logs of many LogWriters from one I/O thread. Each time the
+	// thread wakes up, it takes all buffers queued for a file and writes them
+	// with as few vectored writes as possible.
+	class LogWriterPool
+	{
+	public:
+		LogWriterPool();
+		explicit LogWriterPool(const LogWriterPoolOptions &options);
+		// Writes everything queued. All sinks must be destroyed before the pool.
+		~LogWriterPool();
+
+		// A sink that writes to fd, for LogWriter::StartLog. The caller keeps
+		// ownership of fd.
+		std::unique_ptr<PooledSink> OpenSink(int fd);
+
+	private:
+		LogWriterPool(const LogWriterPool &) = delete;
+		LogWriterPool &operator=(const LogWriterPool &) = delete;
+
+		struct Batch
+		{
+			PooledSink *sink;
+			std::vector<PooledSink::Chunk> chunks;
+		};
+
+		static bool WriteChunks(int fd, const std::vector<PooledSink::Chunk> &chunks, uint64_t &writeCalls);
+
+		void Run();
+		void RemoveSink(PooledSink *sink);
+
+		const LogWriterPoolOptions options;
+
+		mutable std::mutex mutex;
+		std::condition_variable workQueued;
+		std::condition_variable chunksWritten;
+		std::vector<PooledSink *> sinks;
+		bool stopping;
+		std::thread thread;
+
+		friend class PooledSink;
+	};
+}